@@ -0,0 +1,19 @@
+#pragma once
+
+#include <gst/gst.h>
+
+// Buffer pool for the AI branch: every buffer starts on a 64-byte
+// boundary, every row stride is a multiple of 64 and one spare row follows
+// the image, so the detector's preprocessing can run vector loads over
+// pool buffers in place, including past the last pixel, without a packing
+// copy. Offered to upstream by answering the appsink's allocation query.
+namespace aligned_video_pool {
+
+constexpr guint kAlignment = 64;
+
+// Pad probe for a sink pad (GST_PAD_PROBE_TYPE_QUERY_DOWNSTREAM). Answers
+// ALLOCATION with the aligned pool and video meta support; other queries
+// pass through.
+GstPadProbeReturn allocationProbe(GstPad *pad, GstPadProbeInfo *info, gpointer min_buffers);
+
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include "object_detector.hpp"
+
+// Small ring of recent detection results keyed by source-frame PTS. The
+// OSD asks for the frame it is about to draw; the matching result is
+// extrapolated to that PTS with per-object velocities estimated when the
+// result was pushed, so boxes keep up with motion despite AI latency.
+class DetectionHistory {
+public:
+    struct Config {
+        size_t capacity = 8;
+        bool extrapolate = true;
+        uint64_t maxExtrapolationNs = 300ull * 1000 * 1000;
+        uint64_t staleNs = 1000ull * 1000 * 1000;
+    };
+
+    DetectionHistory();
+    explicit DetectionHistory(const Config& cfg);
+
+    void configure(const Config& cfg);
+
+    // Inference thread. Reuses preallocated slots, no steady-state allocation.
+    void push(const DetectionFrame& frame);
+
+    // Streaming thread. Fills out with boxes for a frame at pts; returns
+    // false if the history has nothing usable (empty or stale).
+    bool lookup(uint64_t pts, std::vector<Detection>& out) const;
+
+    void clear();
+
+private:
+    struct Entry {
+        uint64_t pts = DetectionFrame::kNoPts;
+        std::vector<Detection> dets;
+        std::vector<float> vx;      // px per second, frame coordinates
+        std::vector<float> vy;
+    };
+
+    void estimateVelocities(const Entry& prev, Entry& cur) const;
+
+    Config config;
+    mutable std::mutex mutex;
+    std::vector<Entry> ring;
+    size_t head = 0;    // next slot to write
+    size_t count = 0;
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+// Keeps the software H.264 encoder inside a CPU budget. Once per window it
+// is fed the mean encode time per frame, the stream queue's drop rate and
+// the AI latency, and walks a ladder of operating points: bitrate first
+// (cheaper entropy coding and rate control), then frame rate. Steps down as
+// soon as any signal is over budget, steps back up only after a run of
+// quiet windows, so inference gets the spare cores.
+class EncoderGovernor {
+public:
+    struct Config {
+        int maxBitrateKbps = 1000;
+        int minBitrateKbps = 400;
+        int maxFps = 15;
+        int minFps = 8;
+        int aiLatencyBudgetMs = 150;
+        float maxDropRate = 0.02f;
+        float encodeBudget = 0.6f;  // encode time as a fraction of the frame interval
+        int holdWindows = 3;
+        int quietWindows = 10;
+    };
+
+    struct Sample {
+        double encodeMs = 0.0;      // mean per encoded frame
+        int framesIn = 0;           // reaching the stream queue
+        int framesDropped = 0;      // leaked by the stream queue
+        int aiLatencyMs = 0;
+    };
+
+    void configure(const Config& cfg);
+
+    int bitrateKbps() const;
+    int fps() const;
+    int level() const { return level_; }
+
+    // Feeds one window; returns true if bitrate or frame rate changed.
+    bool update(const Sample& sample);
+
+private:
+    int maxLevel() const;
+    int bitrateSteps() const;
+
+    Config cfg;
+    int level_ = 0;
+    int windows_since_switch = 0;
+    int quiet_windows = 0;
+};
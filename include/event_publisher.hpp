@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "track_events.hpp"
+
+// Ships track events to a backend, either MQTT (built-in 3.1.1 client,
+// QoS 0) or a Unix stream socket (one JSON line per batch). publish() only
+// appends to a bounded queue. A background thread batches and coalesces
+// the events and does all network I/O, so a slow or missing broker costs
+// dropped events, never a stalled detector.
+class EventPublisher {
+public:
+    // Which end of a full queue loses an event
+    enum class DropPolicy { Oldest, Newest };
+
+    struct Config {
+        // mqtt://host[:port]/topic or unix:///path/to.sock
+        std::string url = "mqtt://127.0.0.1:1883/nanostream/events";
+        std::string clientId = "nanostream";
+        size_t queueCapacity = 256;
+        size_t batchMax = 64;
+        int batchMs = 200;          // window opened by the first queued event
+        DropPolicy drop = DropPolicy::Oldest;
+        int keepAliveSec = 30;
+        int ioTimeoutMs = 2000;     // a send slower than this drops the connection
+    };
+
+    EventPublisher();
+    ~EventPublisher();
+
+    // False if the URL is not usable. The broker may be down; the sender
+    // keeps reconnecting with backoff.
+    bool start(const Config& cfg);
+    void stop();
+
+    // Non-blocking; callable from any thread.
+    void publish(const std::vector<TrackEvent>& events);
+
+    // One event, and a batch: {"seq":N,"dropped":D,"events":[...]} where
+    // dropped counts events lost to the queue bound since the last batch.
+    static std::string toJson(const TrackEvent& ev);
+    static std::string batchJson(uint64_t seq, uint64_t dropped, const std::vector<TrackEvent>& events);
+
+    // Folds a track's zone changes within a batch into its enter event or
+    // into one zone event, and drops changes that end where they started.
+    static void coalesce(std::vector<TrackEvent>& events);
+
+    // Connection to the backend; the implementations live in the .cpp.
+    class Transport;
+
+private:
+    void senderLoop();
+
+    Config config;
+    std::unique_ptr<Transport> transport;
+    std::thread sender_thread;
+    std::atomic<bool> running{false};
+
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    std::deque<TrackEvent> queue;
+    std::chrono::steady_clock::time_point oldest_queued;
+    uint64_t dropped_since_batch = 0;
+    std::atomic<uint64_t> dropped_total{0};
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gst/gst.h>
+
+// Records detection events as clips cut from the already-encoded main
+// stream. The last few seconds of H.264 access units are kept in a
+// preallocated byte arena that always starts on a keyframe (whole GOPs are
+// evicted); a trigger writes the pre-roll plus a post-roll through a muxer
+// on a background thread, with no re-encode. The capture side only copies
+// into the arena, so a slow disk truncates clips rather than stalling the
+// stream.
+class EventRecorder {
+public:
+    struct Config {
+        std::string directory = "recordings";
+        std::string format = "mp4";     // "mp4" or "mkv"
+        int preRollSec = 5;
+        int postRollSec = 5;
+        int maxClipSec = 60;            // a clip is closed here even if events continue
+        int ringBytes = 4 * 1024 * 1024;
+        int maxUnits = 2048;
+    };
+
+    EventRecorder();
+    ~EventRecorder();
+
+    bool start(const Config& cfg);
+    void stop();
+
+    // Encoded access unit from the stream branch (streaming thread). The
+    // buffer is only borrowed; its bytes are copied into the arena.
+    void pushAccessUnit(GstBuffer* buffer);
+
+    // Starts a clip, or extends the running one by the post-roll.
+    void trigger(const std::string& reason);
+
+    uint64_t droppedUnits() const { return dropped.load(); }
+
+private:
+    struct Unit {
+        uint64_t seq = 0;
+        size_t offset = 0;
+        size_t size = 0;
+        GstClockTime pts = GST_CLOCK_TIME_NONE;
+        GstClockTime dts = GST_CLOCK_TIME_NONE;
+        gint64 arrivalUs = 0;
+        bool keyframe = false;
+    };
+
+    bool reserve(size_t size, size_t& offset);
+    void evictOldest();
+    void trimPreRoll(gint64 now_us);
+    bool copyUnit(uint64_t seq, std::vector<uint8_t>& out, Unit& unit);
+
+    void writerLoop();
+    void writeClip(std::unique_lock<std::mutex>& lock);
+    std::string clipPath(const std::string& reason) const;
+
+    Config config;
+
+    // Arena and unit index, guarded by mutex
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<uint8_t> arena;
+    std::vector<Unit> units;
+    uint64_t first_seq = 0;     // oldest unit held
+    uint64_t next_seq = 0;      // next unit to be written
+    size_t write_offset = 0;
+    bool need_keyframe = true;
+    uint64_t reader_seq = UINT64_MAX;    // writer position; pre-roll trimming stops here
+    uint64_t written_seq = 0;            // first unit after the last clip; the next clip starts no earlier
+
+    // Clip state, guarded by mutex
+    bool clip_pending = false;
+    gint64 clip_start_us = 0;
+    gint64 clip_end_us = 0;
+    std::string clip_reason;
+
+    std::thread writer_thread;
+    std::atomic<bool> running{false};
+    std::atomic<uint64_t> dropped{0};
+};
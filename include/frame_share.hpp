@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include "frame_share_layout.hpp"
+#include "object_detector.hpp"
+
+// Publishes raw frames and detection results to local sidecars through a
+// sealed memfd ring, so they need neither an RTSP session nor a decoder.
+// Sidecars connect to a Unix socket and receive a read-only fd for the
+// memfd over SCM_RIGHTS (see FrameShareReader); the memfd is sealed against
+// new writable mappings, so only the pipeline can write the ring. Publishing never waits on
+// readers: a slow reader is lapped and simply misses frames.
+class FrameSharePublisher {
+public:
+    struct Config {
+        std::string socketPath = "/tmp/nanostream-share.sock";
+        int slots = 4;
+        int cameraWidth = 0;        // 0 disables the channel
+        int cameraHeight = 0;
+        int aiWidth = 0;
+        int aiHeight = 0;
+    };
+
+    FrameSharePublisher();
+    ~FrameSharePublisher();
+
+    bool start(const Config& cfg);
+    void stop();
+    bool active() const { return base != nullptr; }
+
+    // Planar/semi-planar 4:2:0 frame; planes are packed tightly into the slot.
+    void publishCamera(frame_share::Format format, const uint8_t* const planes[3], const int strides[3],
+                       int width, int height, uint64_t pts);
+
+    // Packed RGB rows of the AI input.
+    void publishAiInput(const uint8_t* rgb, int width, int height, int stride, uint64_t pts);
+
+    void publishDetections(const DetectionFrame& frame);
+
+private:
+    uint8_t* beginSlot(frame_share::Channel channel, uint64_t& seq);
+    void commitSlot(frame_share::Channel channel, uint64_t seq);
+    void acceptLoop();
+
+    Config config;
+    int mem_fd = -1;
+    int reader_fd = -1;         // O_RDONLY reopen handed to sidecars
+    int listen_fd = -1;
+    int wake_pipe[2] = {-1, -1};
+    uint8_t* base = nullptr;
+    size_t map_size = 0;
+    // Never read back from the shared header, which readers can see.
+    frame_share::SlotRing rings[frame_share::kChannelCount];
+    uint64_t next_seq[frame_share::kChannelCount] = {};
+
+    std::thread accept_thread;
+    std::atomic<bool> running{false};
+};
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Memory layout of the shared frame ring (one memfd, mapped by the
+// pipeline read-write and by sidecars read-only). Shared between the
+// publisher and the consumer library; bump kVersion on any change.
+//
+//   Header | Camera slots | AI input slots | Detection slots
+//
+// Each slot is a seqlock: the writer stores (seq << 1) | 1 before touching
+// the payload and seq << 1 after, so a reader that sees the same even value
+// before and after reading knows the payload was not overwritten under it.
+namespace frame_share {
+
+constexpr uint32_t kMagic = 0x5253534e;   // "NSSR"
+constexpr uint32_t kVersion = 1;
+constexpr int kMaxDetections = 64;
+
+enum Channel : uint32_t {
+    kCamera = 0,        // full-resolution camera frames (NV12 or I420)
+    kAiInput = 1,       // RGB frames as handed to the detector
+    kDetections = 2,    // detection results, keyed by source-frame PTS
+    kChannelCount = 3,
+};
+
+enum Format : uint32_t {
+    kFormatNone = 0,
+    kFormatNV12 = 1,
+    kFormatI420 = 2,
+    kFormatRGB = 3,
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "cross-process atomics must be lock-free");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "cross-process atomics must be lock-free");
+
+struct ChannelDesc {
+    uint32_t slotCount;
+    uint32_t slotSize;          // bytes, header included; multiple of 64
+    uint64_t offset;            // first slot, from the start of the mapping
+    uint32_t width;             // 0 when the channel is disabled
+    uint32_t height;
+    std::atomic<uint64_t> latestSeq;   // last completed frame, 0 = none yet
+    std::atomic<uint32_t> futex;       // bumped per frame; readers FUTEX_WAIT on it
+    uint32_t reserved;
+};
+
+struct alignas(64) SlotHeader {
+    std::atomic<uint64_t> seq;
+    uint64_t pts;               // GStreamer PTS (ns), UINT64_MAX if unknown
+    int64_t timestampUs;        // CLOCK_MONOTONIC when published
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;            // luma / packed row stride; chroma follows luma
+    uint32_t size;              // payload bytes
+    uint32_t count;             // detections in the payload
+};
+
+struct SharedDetection {
+    int32_t x, y, w, h;         // in frameWidth x frameHeight coordinates
+    int32_t classId;
+    float score;
+    char label[24];
+};
+
+struct DetectionPayload {
+    uint64_t seq;               // DetectionFrame::seq
+    uint32_t frameWidth;
+    uint32_t frameHeight;
+    SharedDetection detections[kMaxDetections];
+};
+
+struct alignas(64) Header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t totalSize;
+    ChannelDesc channels[kChannelCount];
+};
+
+// Where a channel's slots live. Neither side addresses slots through the
+// shared ChannelDesc: the publisher keeps its own copy, and readers copy it
+// once after checking it against the size they mapped.
+struct SlotRing {
+    uint64_t offset = 0;
+    uint32_t slotSize = 0;
+    uint32_t slotCount = 0;
+};
+
+inline uint8_t* slotAt(uint8_t* base, const SlotRing& ring, uint64_t seq) {
+    return base + ring.offset + static_cast<uint64_t>(seq % ring.slotCount) * ring.slotSize;
+}
+
+inline const uint8_t* slotAt(const uint8_t* base, const SlotRing& ring, uint64_t seq) {
+    return base + ring.offset + static_cast<uint64_t>(seq % ring.slotCount) * ring.slotSize;
+}
+
+}
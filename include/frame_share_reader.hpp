@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "frame_share_layout.hpp"
+
+// Consumer side of the shared frame ring, for sidecar processes. Has no
+// GStreamer or ncnn dependency; link against libnanostream_share.
+//
+//   FrameShareReader reader;
+//   reader.connect("/tmp/nanostream-share.sock");
+//   FrameShareReader::View view;
+//   uint64_t last = 0;
+//   while (reader.wait(frame_share::kCamera, last, 1000)) {
+//       if (!reader.latest(frame_share::kCamera, view)) continue;
+//       process(view.data, view.width, view.height);   // in place, no copy
+//       if (reader.stillValid(view)) use_results();   // else it was lapped
+//       last = view.seq;
+//   }
+//
+// Views point straight into the shared mapping. The pipeline never waits
+// for readers, so a view is only trustworthy if stillValid() holds after
+// the reader is done with it.
+class FrameShareReader {
+public:
+    struct View {
+        frame_share::Channel channel = frame_share::kCamera;
+        uint64_t seq = 0;
+        uint64_t pts = UINT64_MAX;
+        int64_t timestampUs = 0;
+        uint32_t format = frame_share::kFormatNone;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t stride = 0;
+        uint32_t size = 0;
+        const uint8_t* data = nullptr;
+        // Detection channel only
+        uint32_t count = 0;
+        const frame_share::DetectionPayload* detections = nullptr;
+    };
+
+    FrameShareReader() = default;
+    ~FrameShareReader();
+    FrameShareReader(const FrameShareReader&) = delete;
+    FrameShareReader& operator=(const FrameShareReader&) = delete;
+
+    // Receives the ring's memfd from the pipeline and maps it read-only.
+    // Fails if the header's version, size or slot layout does not fit
+    // the mapping.
+    bool connect(const std::string& socket_path);
+    void disconnect();
+    bool connected() const { return base != nullptr; }
+
+    // Channel size as configured by the pipeline; width 0 if disabled.
+    bool channelSize(frame_share::Channel channel, uint32_t& width, uint32_t& height) const;
+
+    // Blocks until the channel has a frame newer than after_seq.
+    bool wait(frame_share::Channel channel, uint64_t after_seq, int timeout_ms) const;
+
+    // Most recent complete frame on a channel.
+    bool latest(frame_share::Channel channel, View& view) const;
+
+    // A specific frame, if it is still in the ring.
+    bool at(frame_share::Channel channel, uint64_t seq, View& view) const;
+
+    // True if the frame behind a view has not been overwritten since.
+    bool stillValid(const View& view) const;
+
+private:
+    const frame_share::Header* header() const { return reinterpret_cast<const frame_share::Header*>(base); }
+
+    const uint8_t* base = nullptr;
+    size_t map_size = 0;
+    // Copied from the header once it is known to fit the mapping.
+    frame_share::SlotRing rings[frame_share::kChannelCount];
+};
@@ -0,0 +1,247 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+#include <net.h>
+#include "object_detector.hpp"
+
+// Per-frame decode parameters, filled once from DetectorConfig/RuntimeConfig
+// so decoders never touch either config directly.
+struct DecodeParams {
+    int inputWidth = 320;
+    int inputHeight = 320;
+    float scaleX = 1.0f;
+    float scaleY = 1.0f;
+    float offsetX = 0.0f;
+    float offsetY = 0.0f;
+    float frameArea = 1.0f;
+    float baseScore = 0.30f;
+    float minScoreSmallArea = 0.55f;
+    float minScoreMediumArea = 0.45f;
+    float minScoreSmallAreaThreshold = 0.02f;
+    float minScoreMediumAreaThreshold = 0.05f;
+    float personMinScore = 0.55f;
+    int minBoxArea = 400;
+    int topK = 200;
+    bool showLabels = true;
+};
+
+// Decodes the cls/reg outputs of one detection head. One instance is bound
+// to one head: layout, class count, bins and stride are fixed when the model
+// is loaded, so the per-frame path has no shape dispatch.
+class HeadDecoder {
+public:
+    virtual ~HeadDecoder() = default;
+    virtual const char* name() const = 0;
+    virtual void decode(const ncnn::Mat& out_cls,
+                        const ncnn::Mat& out_reg,
+                        const DecodeParams& params,
+                        std::vector<Detection>& raw_dets,
+                        float& max_score_all) const = 0;
+};
+
+// Picks the decoder matching the head output shapes. Known layouts get a
+// fully specialized instance; unknown class/bin counts or strides fall back
+// to the runtime-sized variant. Returns nullptr for unsupported layouts.
+std::unique_ptr<HeadDecoder> makeHeadDecoder(const ncnn::Mat& out_cls,
+                                             const ncnn::Mat& out_reg,
+                                             int stride);
+
+const char* cocoLabel(int class_id);
+
+namespace decoder_detail {
+
+template <int Bins>
+inline float distExpect(const float* p) {
+    float maxv = p[0];
+    for (int i = 1; i < Bins; ++i) maxv = std::max(maxv, p[i]);
+    float expbuf[Bins];
+    float sum = 0.f;
+    for (int i = 0; i < Bins; ++i) {
+        expbuf[i] = std::exp(p[i] - maxv);
+        sum += expbuf[i];
+    }
+    float v = 0.f;
+    for (int i = 0; i < Bins; ++i) v += expbuf[i] * i;
+    return v / sum;
+}
+
+inline float distExpect(const float* p, int bins) {
+    if (bins <= 0 || bins > 16) return 0.0f;
+    float maxv = p[0];
+    for (int i = 1; i < bins; ++i) maxv = std::max(maxv, p[i]);
+    float expbuf[16];
+    float sum = 0.f;
+    for (int i = 0; i < bins; ++i) {
+        expbuf[i] = std::exp(p[i] - maxv);
+        sum += expbuf[i];
+    }
+    float v = 0.f;
+    for (int i = 0; i < bins; ++i) v += expbuf[i] * i;
+    return v / sum;
+}
+
+inline void gridSize(const DecodeParams& params, int stride, int locations, int& feat_w, int& feat_h) {
+    feat_w = (params.inputWidth + stride - 1) / stride;
+    feat_h = (params.inputHeight + stride - 1) / stride;
+    if (feat_w * feat_h == locations) return;
+    feat_w = (int)(std::sqrt((float)locations) + 0.5f);
+    if (feat_w <= 0) feat_w = locations;
+    feat_h = locations / feat_w;
+    if (feat_w * feat_h != locations) { feat_w = locations; feat_h = 1; }
+}
+
+inline float minScoreFor(const DecodeParams& params, const Detection& d) {
+    float area_norm = (d.w * d.h) / params.frameArea;
+    float min_score = params.baseScore;
+    if (area_norm < params.minScoreSmallAreaThreshold) min_score = params.minScoreSmallArea;
+    else if (area_norm < params.minScoreMediumAreaThreshold) min_score = params.minScoreMediumArea;
+    if (d.class_id == 0 && min_score < params.personMinScore) min_score = params.personMinScore;
+    return min_score;
+}
+
+inline bool passesGate(const DecodeParams& params, const Detection& d) {
+    return d.score >= minScoreFor(params, d) && d.w * d.h >= params.minBoxArea;
+}
+
+// Maps an ltrb box (input pixels) around a grid cell to frame coordinates and
+// applies the area-dependent score gate shared by all layouts.
+inline void emitDetection(const DecodeParams& params, float cx, float cy,
+                          float l, float t, float r, float b,
+                          float score, int class_id, bool labeled,
+                          std::vector<Detection>& raw_dets) {
+    Detection d;
+    d.x = (int)((cx - l) * params.scaleX + params.offsetX);
+    d.y = (int)((cy - t) * params.scaleY + params.offsetY);
+    d.w = (int)((l + r) * params.scaleX);
+    d.h = (int)((t + b) * params.scaleY);
+    d.score = score;
+    d.class_id = class_id;
+    d.label = (labeled && params.showLabels) ? cocoLabel(class_id) : "Target";
+    if (!passesGate(params, d)) return;
+    raw_dets.push_back(d);
+}
+
+}
+
+// NanoDet-m (ncnn-assets) layout: cls [1 x locations x classes] holding
+// sigmoid scores, reg [1 x locations x 4*(RegMax+1)] holding distribution
+// logits. A zero template argument means "read from the blob at runtime".
+template <int NumClasses, int RegMax, int Stride>
+class NanoDetGflDecoder final : public HeadDecoder {
+public:
+    static constexpr int kBins = RegMax > 0 ? RegMax + 1 : 0;
+
+    explicit NanoDetGflDecoder(int stride = Stride) : stride_(Stride > 0 ? Stride : stride) {}
+
+    const char* name() const override { return "nanodet-gfl"; }
+
+    void decode(const ncnn::Mat& out_cls,
+                const ncnn::Mat& out_reg,
+                const DecodeParams& params,
+                std::vector<Detection>& raw_dets,
+                float& max_score_all) const override {
+        const int stride = Stride > 0 ? Stride : stride_;
+        const int num_cls = NumClasses > 0 ? NumClasses : out_cls.w;
+        const int bins = kBins > 0 ? kBins : out_reg.w / 4;
+        const int locations = out_cls.h;
+        int feat_w = 0, feat_h = 0;
+        decoder_detail::gridSize(params, stride, locations, feat_w, feat_h);
+
+        int kept = 0;
+        for (int loc = 0; loc < locations; ++loc) {
+            const float* cls_ptr = out_cls.row(loc);
+
+            float max_score = 0.f;
+            int max_idx = 0;
+            for (int c = 0; c < num_cls; ++c) {
+                if (cls_ptr[c] > max_score) { max_score = cls_ptr[c]; max_idx = c; }
+            }
+            if (max_score > max_score_all) max_score_all = max_score;
+            if (max_score <= params.baseScore) continue;
+            if (kept++ > params.topK) continue;
+
+            const float* reg_ptr = out_reg.row(loc);
+            float l, t, r, b;
+            if constexpr (kBins > 0) {
+                l = decoder_detail::distExpect<kBins>(reg_ptr + 0 * kBins) * stride;
+                t = decoder_detail::distExpect<kBins>(reg_ptr + 1 * kBins) * stride;
+                r = decoder_detail::distExpect<kBins>(reg_ptr + 2 * kBins) * stride;
+                b = decoder_detail::distExpect<kBins>(reg_ptr + 3 * kBins) * stride;
+            } else {
+                l = decoder_detail::distExpect(reg_ptr + 0 * bins, bins) * stride;
+                t = decoder_detail::distExpect(reg_ptr + 1 * bins, bins) * stride;
+                r = decoder_detail::distExpect(reg_ptr + 2 * bins, bins) * stride;
+                b = decoder_detail::distExpect(reg_ptr + 3 * bins, bins) * stride;
+            }
+
+            float cx = (float)((loc % feat_w) * stride);
+            float cy = (float)((loc / feat_w) * stride);
+            decoder_detail::emitDetection(params, cx, cy, l, t, r, b, max_score, max_idx,
+                                          max_idx < 80, raw_dets);
+        }
+    }
+
+private:
+    int stride_;
+};
+
+// YOLO-style planar layout: cls [classes x H x W] logits, reg [4 x H x W]
+// plain ltrb distances in stride units. With NumClasses == 0 this is the
+// legacy generic fallback, which reports boxes as unlabeled "Target".
+template <int NumClasses, int Stride>
+class PlanarLtrbDecoder final : public HeadDecoder {
+public:
+    explicit PlanarLtrbDecoder(int stride = Stride) : stride_(Stride > 0 ? Stride : stride) {}
+
+    const char* name() const override { return NumClasses > 0 ? "planar-ltrb" : "planar-ltrb-generic"; }
+
+    void decode(const ncnn::Mat& out_cls,
+                const ncnn::Mat& out_reg,
+                const DecodeParams& params,
+                std::vector<Detection>& raw_dets,
+                float& max_score_all) const override {
+        const int stride = Stride > 0 ? Stride : stride_;
+        const int num_cls = NumClasses > 0 ? NumClasses : out_cls.c;
+        const int plane = out_cls.w * out_cls.h;
+        const float* cls_base = out_cls;
+        const float* reg_base = out_reg;
+        const size_t cls_step = out_cls.cstep;
+        const size_t reg_step = out_reg.cstep;
+        // Scores are monotonic in the logit, so gate on the logit and only
+        // pay for the sigmoid on survivors.
+        // Clamped so a base score of 1 stays finite instead of log(1/0).
+        const float base = std::min(params.baseScore, 1.0f - 1e-6f);
+        const float base_logit = std::log(base / (1.0f - base));
+        float best_logit = -1e9f;
+
+        for (int i = 0; i < plane; i++) {
+            float max_logit = -1e9f;
+            int max_idx = 0;
+            for (int c = 0; c < num_cls; c++) {
+                float v = cls_base[c * cls_step + i];
+                if (v > max_logit) { max_logit = v; max_idx = c; }
+            }
+            if (max_logit > best_logit) best_logit = max_logit;
+            if (max_logit <= base_logit) continue;
+            float score = 1.0f / (1.0f + std::exp(-max_logit));
+
+            float l = reg_base[0 * reg_step + i] * stride;
+            float t = reg_base[1 * reg_step + i] * stride;
+            float r = reg_base[2 * reg_step + i] * stride;
+            float b = reg_base[3 * reg_step + i] * stride;
+            float cx = (float)((i % out_cls.w) * stride);
+            float cy = (float)((i / out_cls.w) * stride);
+            decoder_detail::emitDetection(params, cx, cy, l, t, r, b, score,
+                                          NumClasses > 0 ? max_idx : -1,
+                                          NumClasses == 80, raw_dets);
+        }
+        float best_score = 1.0f / (1.0f + std::exp(-best_logit));
+        if (best_score > max_score_all) max_score_all = best_score;
+    }
+
+private:
+    int stride_;
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Picks the detector input size per frame from a ladder of steps (e.g.
+// 256/320/416). Steps up only when the scene is busy, the SoC is not
+// throttled and the predicted cost of the next step fits the latency
+// budget; steps down on budget overrun, thermal throttling or idle scenes.
+class InputSizeGovernor {
+public:
+    struct Config {
+        std::vector<int> steps = {256, 320, 416};
+        int latencyBudgetMs = 150;
+        int holdFrames = 30;
+        int idleFrames = 90;
+    };
+
+    void configure(const Config& cfg, int initial_size);
+
+    bool enabled() const { return !cfg.steps.empty(); }
+    int current() const { return enabled() ? cfg.steps[index] : 0; }
+
+    // Feeds one frame's measurements; returns true if the size changed.
+    bool update(long long latency_ms, size_t detections, bool thermal_throttled);
+
+private:
+    Config cfg;
+    size_t index = 0;
+    float latency_ema = 0.0f;
+    int frames_since_switch = 0;
+    int idle_frames = 0;
+};
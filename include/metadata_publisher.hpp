@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "object_detector.hpp"
+
+// Publishes detection results out of band so clients draw their own boxes
+// and the encoder can stream untouched frames. Each result becomes one
+// compact JSON document keyed by the source-frame PTS, sent as a UDP
+// datagram and as a Server-Sent Events stream (GET /detections) that
+// browsers can consume with EventSource.
+class MetadataPublisher {
+public:
+    struct Config {
+        std::string udpHost = "127.0.0.1";
+        int udpPort = 5600;     // 0 disables UDP
+        int httpPort = 8081;    // 0 disables SSE
+    };
+
+    MetadataPublisher();
+    ~MetadataPublisher();
+
+    bool start(const Config& cfg);
+    void stop();
+
+    // Non-blocking: serializes and hands off to the sender thread. Only the
+    // latest result is kept, so a slow client never backs up inference.
+    void publish(const DetectionFrame& frame);
+
+    static std::string toJson(const DetectionFrame& frame);
+
+private:
+    void senderLoop();
+    void acceptClients();
+    void readRequest(size_t index);
+    void broadcast(const std::string& json);
+
+    // An accepted connection whose request line has not arrived yet.
+    // Read from the sender's poll loop, never waited on.
+    struct Handshake {
+        int fd;
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    Config config;
+    int udp_fd = -1;
+    int listen_fd = -1;
+    int wake_pipe[2] = {-1, -1};
+    std::vector<int> clients;
+    std::vector<Handshake> handshakes;
+
+    std::thread sender_thread;
+    std::mutex slot_mutex;
+    std::string pending;
+    bool has_pending = false;
+    std::atomic<bool> running{false};
+};
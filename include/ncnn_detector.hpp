@@ -6,24 +6,18 @@
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
+#include <memory>
 #include <net.h>
+#include "head_decoder.hpp"
+#include "input_size_governor.hpp"
+#include "object_detector.hpp"
 #include "runtime_config.hpp"
+#include "task_pool.hpp"
 
-struct Detection {
-    int x, y, w, h;
-    std::string label;
-    float score;
-    int class_id = -1;
-};
-
-class NCNNDetector {
+class NCNNDetector : public ObjectDetector {
 public:
     struct DetectorConfig {
-        struct Head {
-            std::string cls;
-            std::string reg;
-            int stride = 0;
-        };
+        using Head = DetectorHead;
 
         int frameWidth = 640;
         int frameHeight = 480;
@@ -42,6 +36,17 @@ public:
         float iouThreshold = 0.3f;
         float emaAlpha = 0.6f;
 
+        // Cascade mode: a cheap low-resolution full-frame pass proposes
+        // regions, then low-confidence or small candidates are re-detected
+        // on high-resolution crops of the source frame.
+        bool cascade = false;
+        int cascadeInputSize = 256;
+        int cascadeRoiInputSize = 320;
+        int cascadeMaxRois = 2;
+        float cascadeProposalScore = 0.20f;
+        float cascadeRefineAreaThreshold = 0.02f;
+        float cascadeRoiExpand = 3.0f;
+
         std::vector<Head> heads = {
             {"792", "795", 8},
             {"814", "817", 16},
@@ -49,33 +54,86 @@ public:
         };
     };
 
-    NCNNDetector();
-    ~NCNNDetector();
+    // One model and one worker serve every camera. Each camera is a
+    // channel with its own frame slot, results, smoothing state and
+    // listeners; this object's own ObjectDetector interface is channel 0.
+    explicit NCNNDetector(int channels = 1);
+    ~NCNNDetector() override;
 
-    bool loadModel(const std::string &paramPath, const std::string &binPath);
+    bool loadModel(const std::string &paramPath, const std::string &binPath) override;
     
-    // Non-blocking: just drops the frame into the processing slot
-    void pushFrame(const unsigned char *rgb_data, int width, int height);
+    // Only waits for a slot swap, never for inference; an unread frame is replaced
+    void pushFrame(VideoFrameRef frame) override { pushFrame(0, std::move(frame)); }
+    void pushFrame(size_t channel, VideoFrameRef frame);
 
     // Thread-safe access to latest results for OSD
-    std::vector<Detection> getDetections();
+    std::vector<Detection> getDetections() override;
+    void getDetections(std::vector<Detection>& out) override;
+    void getDetections(size_t channel, std::vector<Detection>& out);
+
+    // Thermal throttling controls, shared by all channels
+    void setThrottle(int sleep_ms, bool paused) override;
+
+    void addResultListener(ResultListener listener) override { addResultListener(0, std::move(listener)); }
+    void addResultListener(size_t channel, ResultListener listener);
+
+    int lastLatencyMs() const override { return last_latency_ms.load(); }
+
+    // A camera's view of the shared detector, for code that only knows
+    // ObjectDetector. Model and throttle calls act on the whole detector.
+    ObjectDetector& channel(size_t index);
+    size_t channelCount() const { return channels.size(); }
 
-    // Thermal throttling controls
-    void setThrottle(int sleep_ms, bool paused);
+    // Frame-to-tensor preprocessing (resize, mean/norm) and the blob it
+    // feeds. Public so offline tools see exactly the tensors inference sees.
+    static constexpr const char* kInputBlob = "input.1";
+    static bool prepareInput(const VideoFrameRef& frame, int target_w, int target_h, ncnn::Mat& in);
 
 private:
+    struct Channel {
+        VideoFrameRef pending;          // frame slot, guarded by frame_mutex
+        bool has_frame = false;
+        int64_t waiting_since_us = 0;   // first unserved frame, for the deadline order
+        uint64_t seq = 0;               // worker only
+        std::vector<Detection> prev;    // worker only, EMA smoothing state
+        std::mutex result_mutex;
+        std::vector<Detection> current;
+        std::mutex listener_mutex;
+        std::vector<ResultListener> listeners;
+        std::unique_ptr<ObjectDetector> view;
+    };
+
+    // Frames taken together in one scheduling round, at most one per channel.
+    struct Job {
+        size_t channel;
+        VideoFrameRef frame;
+    };
+
     void workerLoop();
-    bool waitForFrame(std::vector<unsigned char>& frame, int& w, int& h);
-    bool prepareInput(const std::vector<unsigned char>& frame, int w, int h, ncnn::Mat& in);
+    void applyThreadTopology(const RuntimeConfig& runtime);
+    bool waitForFrames(std::vector<Job>& jobs);
+    void publishResult(size_t channel, std::vector<Detection>& final_dets, uint64_t pts,
+                       int lat, float max_score_all, bool any_head_ok, bool debug);
+    void notifyListeners(Channel& ch, size_t channel, const std::vector<Detection>& dets, uint64_t pts);
+    bool runBatch(const std::vector<Job>& jobs, int in_w, int in_h, float frame_area, uint64_t frame_id,
+                  bool debug, std::vector<std::vector<Detection>>& raw_dets, float& max_score_all);
+    bool prepareRoiInput(const VideoFrameRef& frame,
+                         int roi_x, int roi_y, int roi_w, int roi_h,
+                         int target_w, int target_h, ncnn::Mat& in) const;
+    bool runPass(const ncnn::Mat& in, const DecodeParams& params, uint64_t frame_id, bool debug,
+                 std::vector<Detection>& raw_dets, float& max_score_all);
+    void runCascade(const VideoFrameRef& frame, float frame_area, uint64_t frame_id, bool debug,
+                    std::vector<Detection>& raw_dets, float& max_score_all, bool& any_head_ok);
     void clearResults();
-    void applyRuntimeOverrides(const RuntimeConfig& runtime);
+    void compileConfig(const RuntimeConfig& runtime);
     float calculateIoU(const Detection& a, const Detection& b) const;
     void applyPostFilter(const RuntimeConfig& runtime,
                          const std::vector<Detection>& raw_dets,
                          std::vector<Detection>& final_dets,
                          float frame_area) const;
-    void smoothDetections(std::vector<Detection>& final_dets);
-    float distExpect(const float* p, int bins) const;
+    void smoothDetections(const std::vector<Detection>& prev_dets, std::vector<Detection>& final_dets) const;
+    DecodeParams makeDecodeParams(float frame_area, int input_w, int input_h) const;
+    bool resolveHeadDecoders(ncnn::Extractor& ex, bool debug);
     bool extractHeadOutputs(ncnn::Extractor& ex,
                             const std::string& cls,
                             const std::string& reg,
@@ -92,16 +150,39 @@ private:
     std::condition_variable frame_cv;
     std::atomic<bool> running{true};
     
-    std::vector<unsigned char> pending_frame;
-    int img_w = 0, img_h = 0;
-    bool has_new_frame = false;
+    std::vector<std::unique_ptr<Channel>> channels;
+    size_t next_channel = 0;   // round-robin cursor, guarded by frame_mutex
+
+    // Scheduling, compiled from the runtime config. Worker-thread only.
+    bool schedule_deadline = false;
+    size_t batch_limit = 1;
+    bool batch_failed = false;
 
     std::atomic<int> throttle_ms{0};
     std::atomic<bool> paused{false};
-    bool config_logged = false;
+    std::atomic<int> last_latency_ms{0};
+    int inference_threads = 0;   // capped to the AI core set; 0 = net.opt
+
+    // Detector config compiled from a runtime snapshot; rebuilt only when
+    // runtimeConfigVersion() moves. Worker-thread only.
+    uint64_t compiled_version = 0;
+    DecodeParams decode_template;
+
+    // Head decoders, one per config.heads entry, resolved from the output
+    // shapes on the first inference after a model load. Worker-thread only.
+    std::atomic<bool> decoders_dirty{true};
+    std::vector<std::unique_ptr<HeadDecoder>> head_decoders;
+    std::vector<int> extract_stages;   // stage_profiler ids, parallel to head_decoders
+
+    // Parallel decode: heads are decoded on the pool into their own
+    // candidate buffers while the worker extracts the next head, then
+    // merged in head order. Created on the worker so it shares its cores.
+    std::unique_ptr<TaskPool> decode_pool;
+    std::vector<std::vector<Detection>> head_candidates;
+    std::vector<float> head_max_scores;
 
-    // Detection results
-    std::mutex result_mutex;
-    std::vector<Detection> current_detections;
-    std::vector<Detection> prev_detections;
+    // Load-adaptive input size. The size is chosen once per frame and both
+    // the resize and the decode scale factors derive from that one value.
+    InputSizeGovernor input_governor;
+    bool input_governor_configured = false;
 };
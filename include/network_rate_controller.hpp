@@ -0,0 +1,43 @@
+#pragma once
+
+// Steers the main-stream bitrate and keyframe cadence from viewer network
+// feedback (RTCP receiver reports, QoS). Multiplicative decrease as soon
+// as loss, jitter or QoS signal congestion; additive increase only after a
+// run of clean windows, so recovery probes slowly. While viewers see loss,
+// keyframes are forced more often so they resynchronise sooner.
+class NetworkRateController {
+public:
+    struct Config {
+        int maxBitrateKbps = 1000;
+        int minBitrateKbps = 200;
+        float lossHigh = 0.05f;         // fraction lost that counts as congestion
+        float lossLow = 0.01f;          // below this a window is clean
+        float jitterHighMs = 40.0f;
+        float decrease = 0.7f;
+        int increaseKbps = 50;
+        int probeWindows = 5;
+        int lossyKeyframeSec = 2;
+    };
+
+    struct Feedback {
+        int receivers = 0;
+        float fractionLost = 0.0f;      // worst receiver, 0..1
+        float jitterMs = 0.0f;          // worst receiver
+        int qosEvents = 0;
+    };
+
+    void configure(const Config& cfg);
+
+    int bitrateKbps() const { return bitrate; }
+    // 0 leaves keyframe placement to the encoder
+    int keyframeIntervalSec() const { return lossy ? cfg.lossyKeyframeSec : 0; }
+
+    // Feeds one window; returns true if the bitrate changed.
+    bool update(const Feedback& feedback);
+
+private:
+    Config cfg;
+    int bitrate = 1000;
+    int clean_windows = 0;
+    bool lossy = false;
+};
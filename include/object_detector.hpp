@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct Detection {
+    int x, y, w, h;
+    std::string label;
+    float score;
+    int class_id = -1;
+};
+
+// One inference result, keyed by the PTS of the frame it was computed on.
+struct DetectionFrame {
+    static constexpr uint64_t kNoPts = UINT64_MAX;
+
+    uint64_t seq = 0;
+    uint64_t pts = kNoPts;      // GStreamer PTS (ns) of the source frame
+    int64_t timestampUs = 0;    // monotonic time the result was produced
+    int frameWidth = 0;         // coordinate space of the boxes
+    int frameHeight = 0;
+    int camera = 0;             // index of the camera the frame came from
+    std::vector<Detection> detections;
+};
+
+// A packed 3-byte-per-pixel frame, possibly with padded rows. `owner`
+// keeps the pixels alive while the detector holds the frame, so pooled
+// pipeline buffers are read in place instead of copied.
+struct VideoFrameRef {
+    const unsigned char *data = nullptr;
+    int width = 0;
+    int height = 0;
+    int stride = 0;
+    uint64_t pts = DetectionFrame::kNoPts;
+    std::shared_ptr<const void> owner;
+};
+
+// Backend-agnostic detector interface. The pipeline only pushes frames and
+// reads results; model format, inference engine and head decoding stay
+// behind this boundary so new model families can be added as subclasses.
+class ObjectDetector {
+public:
+    virtual ~ObjectDetector() = default;
+
+    virtual bool loadModel(const std::string &paramPath, const std::string &binPath) = 0;
+
+    // Non-blocking: just drops the frame into the processing slot,
+    // releasing whichever frame was still waiting there
+    virtual void pushFrame(VideoFrameRef frame) = 0;
+
+    // Thread-safe access to latest results for OSD
+    virtual std::vector<Detection> getDetections() = 0;
+
+    // Same, but reuses the caller's buffer so per-frame readers don't allocate
+    virtual void getDetections(std::vector<Detection>& out) { out = getDetections(); }
+
+    // Thermal throttling controls
+    virtual void setThrottle(int sleep_ms, bool paused) = 0;
+
+    // Wall time of the last completed inference, for load governors; 0 if unknown
+    virtual int lastLatencyMs() const { return 0; }
+
+    // Called on the inference thread after every processed frame. Listeners
+    // must not block; register them before frames start flowing.
+    using ResultListener = std::function<void(const DetectionFrame&)>;
+    virtual void addResultListener(ResultListener listener) = 0;
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "object_detector.hpp"
+
+struct OsdRect {
+    int x, y, w, h;
+};
+
+// Planar 4:2:0 frame (I420, or NV12 when chroma is interleaved).
+struct OsdYuvTarget {
+    uint8_t* y = nullptr;
+    uint8_t* u = nullptr;
+    uint8_t* v = nullptr;
+    int yStride = 0;
+    int uvStride = 0;
+    bool interleaved = false;
+    int width = 0;
+    int height = 0;
+};
+
+// Draws detection boxes and labels straight into a mapped video frame.
+// Label text is rasterized with Cairo once per (label, score bucket) and
+// cached as a premultiplied BGRx tile; per-frame work is row fills and
+// row copies, with no font lookup or heap allocation in steady state.
+class OsdRenderer {
+public:
+    struct Style {
+        int lineWidth = 3;
+        int labelMinWidth = 100;
+        int labelHeight = 25;
+        double fontSize = 20.0;
+        int scoreBuckets = 10;
+        bool showScore = true;
+        uint32_t boxColor = 0xff00ff00;   // xRGB, stored as BGRx in memory
+        uint32_t textColor = 0xffffffff;
+    };
+
+    OsdRenderer();
+    explicit OsdRenderer(const Style& style);
+
+    // Draws into a 32-bit BGRx/BGRA frame. Returns the rectangles written,
+    // valid until the next draw call.
+    const std::vector<OsdRect>& drawBgrx(uint8_t* data, int width, int height, int stride,
+                                         const std::vector<Detection>& dets);
+
+    // Draws into the luma and chroma planes of an I420/NV12 frame in place,
+    // so the encoder branch needs no RGB round trip. Labels are placed on
+    // even coordinates to stay aligned with the 2x2 chroma grid.
+    const std::vector<OsdRect>& drawYuv(const OsdYuvTarget& frame, const std::vector<Detection>& dets);
+
+    struct Sprite {
+        int w = 0;
+        int h = 0;
+        std::vector<uint32_t> pixels;
+        // BT.601 limited-range planes, chroma at half resolution
+        std::vector<uint8_t> yPlane;
+        std::vector<uint8_t> uPlane;
+        std::vector<uint8_t> vPlane;
+    };
+
+    // Cached label tile for a detection (rasterized on first use).
+    const Sprite& labelSprite(const Detection& det);
+
+    const Style& style() const { return style_; }
+
+private:
+    Sprite rasterize(const std::string& text) const;
+    void boxRects(int x, int y, int w, int h, int width, int height);
+
+    Style style_;
+    std::unordered_map<std::string, Sprite> sprites;
+    std::string key_scratch;
+    std::vector<OsdRect> dirty;
+};
+
+namespace osd_detail {
+
+// Fills n 32-bit pixels with v (NEON on ARM, auto-vectorized elsewhere).
+void fillPixels(uint32_t* dst, int n, uint32_t v);
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <initializer_list>
+#include <string>
+#include <gst/gst.h>
+
+// Builds GStreamer graphs element by element instead of through launch
+// strings. Every element, caps filter and link is created explicitly; the
+// first failure is kept and later calls become no-ops, so a whole branch
+// is checked once at the end.
+class GraphBuilder {
+public:
+    explicit GraphBuilder(GstBin *bin) : bin(bin) {}
+
+    // Creates an element and adds it to the bin; nullptr after a failure.
+    GstElement* make(const char *factory, const char *name = nullptr);
+
+    // capsfilter with fixed caps.
+    GstElement* caps(const std::string& caps);
+
+    // Sets a property from its string form, so enums, flags and structures
+    // use the same nicks as gst-launch. Unknown properties are an error.
+    void set(GstElement *element, const char *property, const std::string& value);
+    void set(GstElement *element, const char *property, int value);
+
+    // Links elements in order; a tee gets a new request pad per link.
+    bool chain(std::initializer_list<GstElement*> elements);
+
+    bool ok() const { return error_.empty(); }
+    const std::string& error() const { return error_; }
+
+private:
+    void fail(const std::string& what);
+
+    GstBin *bin;
+    std::string error_;
+};
+
+// Exposes the first element's sink pad on its bin, so a branch can be
+// linked to and unlinked from a tee as one unit.
+bool addGhostSink(GstElement *bin, GstElement *first);
+
+// What the platform offers, probed once per process: element factories
+// from the registry, dmabuf-import from the v4l2 drivers themselves. The
+// stream branch still fails over at runtime if a probe was too hopeful.
+struct HardwareCaps {
+    bool v4l2Convert = false;
+    bool v4l2Encoder = false;
+    bool convertDmabufImport = false;   // v4l2convert's device accepts DMABUF on its OUTPUT queue
+    bool encoderDmabufImport = false;   // v4l2h264enc's device accepts DMABUF on its OUTPUT queue
+};
+
+const HardwareCaps& probeHardwareCaps();
@@ -1,9 +1,18 @@
 #pragma once
 
+#include <atomic>
+#include <functional>
+#include <mutex>
 #include <string>
 #include <gst/gst.h>
-#include <cairo.h>
-#include "ncnn_detector.hpp"
+#include <gst/video/video.h>
+#include "detection_history.hpp"
+#include "encoder_governor.hpp"
+#include "frame_share.hpp"
+#include "network_rate_controller.hpp"
+#include "object_detector.hpp"
+#include "osd_renderer.hpp"
+#include "roi_encode.hpp"
 
 class PipelineManager {
 public:
@@ -14,14 +23,29 @@ public:
         int framerate_den = 1;
         int ai_width = 320;
         int ai_height = 320;
-        int stream_port = 5004;
         int stream_queue_max = 10;
         int ai_queue_max = 2;
-        bool useDmabuf = false;
-        bool useDirect = false;
+        int stream_delay_ms = 0;
+        int stream_bitrate_kbps = 1000;
+        int encoder_threads = 4;
+        bool encoder_governor = false;
+        bool roi_encode = false;
+        int roi_crf = 26;
+        bool sub_enabled = false;
+        int sub_width = 320;
+        int sub_height = 240;
+        int sub_bitrate_kbps = 300;
+        bool sub_share_ai = true;
     };
 
-    PipelineManager();
+    // Main-stream encode paths, best first. Failover only moves down.
+    enum class StreamMode { DmabufConvert = 0, DmabufDirect = 1, Software = 2 };
+
+    // One camera's capture, encode and AI branches. `detector` is this
+    // camera's view of the shared detector; it must be stopped before the
+    // pipeline is destroyed, since its listeners call back into it.
+    // An empty camera_name takes libcamera's first camera.
+    PipelineManager(ObjectDetector& detector, int camera_index, const std::string& camera_name);
     ~PipelineManager();
 
     // Initialize and build the GStreamer pipeline
@@ -33,40 +57,143 @@ public:
     // Stop the pipeline and release resources
     void stop();
 
-    // OSD Drawing logic
-    void draw_overlay(cairo_t *cr);
+    // OSD Drawing logic: draws in place into NV12/I420 stream-branch buffers
+    GstPadProbeReturn draw_overlay(GstPad *pad, GstPadProbeInfo *info);
 
     // Thermal throttling hook
     void setAIThrottle(int sleep_ms, bool paused);
 
+    // Per-frame detection results, keyed by source-frame PTS
+    void addDetectionListener(ObjectDetector::ResultListener listener);
+
+    // Encoded outputs: the full-resolution main stream and the optional
+    // low-resolution sub-stream, each with its own encoder
+    enum class StreamProfile { Main = 0, Sub = 1 };
+
+    // Encoded H.264 access units from a profile (streaming thread).
+    // Set before start(); the buffer is only borrowed for the call.
+    using EncodedListener = std::function<void(GstBuffer*)>;
+    void setEncodedListener(StreamProfile profile, EncodedListener listener);
+
+    // Asks a profile's encoder for an IDR, e.g. when a new RTSP media starts
+    void requestKeyframe(StreamProfile profile);
+
+    // Viewer conditions for the main stream (RTCP receiver reports), fed
+    // once a second from the main loop; steers bitrate and keyframes.
+    void reportNetworkFeedback(int receivers, float fraction_lost, float jitter_ms);
+
 private:
-    bool buildPipelineInternal(bool use_dmabuf, bool use_direct);
-    void rebuildSoftwarePipeline();
-    void rebuildDmabufDirectPipeline();
+    bool constructPipeline(StreamMode mode);
+    bool insertStreamBranch(StreamMode mode);
+    bool streamModeUsable(StreamMode mode) const;
+    void failStreamBranch(const std::string& reason);
+    GstFlowReturn containStreamFlow(GstFlowReturn ret);
+    void swapStreamBranch();
+    void checkStreamStall();
     void resetPipeline();
-    bool applyPipeline(const std::string& pipeline_desc);
 
     GstElement *pipeline = nullptr;
     GstElement *app_sink = nullptr;
     GstBus *bus = nullptr;
-    NCNNDetector detector;
+    ObjectDetector& detector;
+    int camera_index = 0;
+    std::string camera_name;
+    FrameSharePublisher frame_share;
+    GstCaps *share_caps = nullptr;
+    GstVideoInfo share_info;
+    frame_share::Format share_format = frame_share::kFormatNone;
     PipelineConfig config;
+    OsdRenderer osd;
+    DetectionHistory osd_history;
+    std::vector<Detection> osd_dets;
+    GstCaps *osd_caps = nullptr;
+    GstVideoInfo osd_info;
+    bool osd_format_ok = false;
+    bool osd_copy_allowed = true;
+    bool osd_draw_enabled = true;
+    RoiEncodeFilter roi_filter;
+    bool roi_meta_enabled = false;
+    bool roi_hold_enabled = false;
+    int roi_delta_qp = -8;
+    uint64_t roi_frames = 0;
 
-    bool use_dmabuf_config = false;
-    bool dmabuf_active = false;
-    bool dmabuf_disabled = false;
-    bool dmabuf_direct_tried = false;
-    bool caps_logged = false;
-    int overlay_width = 640;
-    int overlay_height = 480;
-    std::atomic<long long> last_sample_us{0};
+    // Software encoder CPU governor, ticked once a second on the main loop
+    EncoderGovernor encoder_governor;
+    guint encoder_tick_id = 0;
+    std::atomic<int> enc_frames_in{0};
+    std::atomic<int> enc_dropped{0};
+    std::atomic<int> enc_frames{0};
+    std::atomic<long long> enc_time_us{0};
+    std::mutex enc_pending_mutex;
+    GstClockTime enc_pending_pts[8] = {};
+    gint64 enc_pending_at[8] = {};
+    int enc_pending_next = 0;
+    bool encoder_is_x264 = true;
+
+    // Network-adaptive bitrate (main loop only)
+    NetworkRateController net_rate;
+    bool net_adaptive = false;
+    int qos_events = 0;
+    gint64 last_forced_keyframe_us = 0;
+    EncodedListener encoded_listeners[2];
+
+    // Swappable main-stream branch: one bin behind a tee request pad.
+    // Failed modes are remembered for the life of the process only.
+    // Stall limit on top of the OSD delay queue's hold time, plus a grace
+    // for a fresh encoder's first access unit.
+    static constexpr gint64 kStreamStallUs = G_USEC_PER_SEC;
+    static constexpr gint64 kStreamStartGraceUs = 3 * G_USEC_PER_SEC;
+    GstElement *stream_tee = nullptr;
+    GstPad *stream_tee_pad = nullptr;
+    std::atomic<GstElement*> stream_branch{nullptr};
+    std::atomic<bool> stream_branch_failed{false};
+    GstFlowReturn stream_flow_error = GST_FLOW_OK;
+    StreamMode stream_mode = StreamMode::Software;
+    bool stream_mode_failed[3] = {};
+    bool swap_pending = false;
+    gint64 swap_started_us = 0;
+    gint64 branch_started_us = 0;
+    std::atomic<gint64> last_fed_us{0};
+    std::atomic<gint64> last_encoded_us{0};
+    guint stream_watch_id = 0;
+
+    // AI appsink input, described by the negotiated caps (streaming thread)
+    static constexpr guint kAiPoolMinBuffers = 4;
+    GstCaps *ai_caps = nullptr;
+    GstVideoInfo ai_info;
+    bool ai_format_ok = false;
 
     // Static callback wrapper for GStreamer C API
     static GstFlowReturn on_new_sample_wrapper(GstElement *sink, gpointer user_data);
+    static GstFlowReturn on_stream_sample_wrapper(GstElement *sink, gpointer user_data);
+    static GstFlowReturn on_sub_sample_wrapper(GstElement *sink, gpointer user_data);
+    static GstPadProbeReturn on_osd_probe_wrapper(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+    static GstPadProbeReturn on_share_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+    void shareCameraFrame(GstPad *pad, GstBuffer *buffer);
+
+    static GstPadProbeReturn on_stream_in_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+    static GstPadProbeReturn on_encoder_in_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+    static GstPadProbeReturn on_encoder_out_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+    static void on_stream_overrun(GstElement *queue, gpointer user_data);
+    static gboolean on_encoder_tick(gpointer user_data);
+    void attachEncoderGovernor();
+    void tickEncoderGovernor();
+    void applyEncoderBitrate();
+
+    static GstPadProbeReturn on_stream_gate(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+    static GstFlowReturn on_stream_branch_chain(GstPad *pad, GstObject *parent, GstBuffer *buffer);
+    static GstFlowReturn on_stream_branch_chain_list(GstPad *pad, GstObject *parent, GstBufferList *list);
+    static gboolean on_stream_flow_error(gpointer user_data);
+    static GstPadProbeReturn on_stream_pad_idle(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+    static gboolean on_swap_stream_branch(gpointer user_data);
+    static gboolean on_stream_watch(gpointer user_data);
 
-    // Bus message handler
+    // Bus message handlers
     static gboolean on_bus_message(GstBus *bus, GstMessage *message, gpointer user_data);
+    static GstBusSyncReply on_bus_sync(GstBus *bus, GstMessage *message, gpointer user_data);
+    static void placeStreamingThread(GstElement *owner);
     
     // Actual member function to handle the sample
     GstFlowReturn on_new_sample(GstElement *sink);
+    GstFlowReturn on_stream_sample(GstElement *sink, StreamProfile profile);
 };
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "object_detector.hpp"
+#include "osd_renderer.hpp"
+
+// Detection-driven bit allocation ahead of the encoder. Macroblocks inside
+// (expanded) detections always pass through. Outside them, a block whose
+// luma and chroma both barely differ from the held background is replaced
+// by it, so sensor noise on static scenery encodes as skip blocks.
+//
+// This changes the picture, not just the bit allocation: outside
+// detections, small changes are shown late, by up to maxHoldFrames frames.
+// One block row per frame is refreshed unconditionally, and no block is
+// held more than maxHoldFrames frames in a row, so slow changes still land.
+class RoiEncodeFilter {
+public:
+    struct Config {
+        int staticThreshold = 4;    // mean abs diff per pixel, luma and chroma alike
+        float margin = 0.2f;        // ROI expansion, fraction of box size
+        int maxHoldFrames = 15;     // consecutive frames a block may be held
+    };
+
+    static constexpr int kBlock = 16;
+
+    RoiEncodeFilter();
+    explicit RoiEncodeFilter(const Config& cfg);
+
+    void configure(const Config& cfg);
+
+    // Filters an I420/NV12 frame in place. Returns the ROI rectangles in
+    // frame coordinates, block-aligned, valid until the next call.
+    const std::vector<OsdRect>& process(const OsdYuvTarget& frame, const std::vector<Detection>& dets);
+
+    // Background blocks replaced in the last processed frame
+    int heldBlocks() const { return held_blocks; }
+    int totalBlocks() const { return mb_cols * mb_rows; }
+
+private:
+    void reset(const OsdYuvTarget& frame);
+    void markRois(const std::vector<Detection>& dets, int width, int height);
+
+    Config config;
+    int width = 0;
+    int height = 0;
+    bool interleaved = false;
+    int mb_cols = 0;
+    int mb_rows = 0;
+    uint32_t frame_count = 0;
+    int held_blocks = 0;
+
+    std::vector<uint8_t> roi_mask;      // one byte per macroblock
+    std::vector<uint16_t> hold_run;     // consecutive held frames per macroblock
+    std::vector<uint8_t> ref_y;         // held background, tightly packed
+    std::vector<uint8_t> ref_uv;        // U then V (or interleaved UV) at half res
+    std::vector<OsdRect> rois;
+    bool have_ref = false;
+};
@@ -1,6 +1,11 @@
 #pragma once
 
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 #include <gst/gst.h>
 #include <gst/rtsp-server/rtsp-server.h>
 
@@ -9,13 +14,65 @@ public:
     RTSPServer();
     ~RTSPServer();
 
+    // Registers a mount point (e.g., "/live", "/sub") before start().
+    // Returns the id to pass to pushBuffer()/setKeyframeRequest().
+    int addMount(const std::string &mount_point);
+
     // Start RTSP Server
     // rtsp_port: Port for RTSP (e.g., 8554)
-    // mount_point: URL suffix (e.g., "/live")
-    // udp_port: Source UDP port to forward (e.g., 5004)
-    void start(int rtsp_port, const std::string &mount_point, int udp_port, const std::string &host_label);
+    // Every mount is fed in-process through pushBuffer(), no loopback socket.
+    void start(int rtsp_port, const std::string &host_label);
+
+    // Hands an encoded H.264 access unit (byte-stream) to a mount's media.
+    // Takes a new reference only; the payload is never copied. Safe to call
+    // from any streaming thread, a no-op while no client is connected.
+    void pushBuffer(int mount, GstBuffer *buffer);
+
+    // Called when a mount's media starts so its encoder can emit an IDR and
+    // clients don't wait a full GOP for the first picture.
+    void setKeyframeRequest(int mount, std::function<void()> request);
+
+    // Access units dropped because the mount's media pipeline fell behind
+    guint64 droppedUnits(int mount) const;
+
+    // Worst-case viewer conditions from RTCP receiver reports on a mount
+    struct ReceiverStats {
+        int receivers = 0;
+        float fractionLost = 0.0f;
+        float jitterMs = 0.0f;
+    };
+    ReceiverStats receiverStats(int mount) const;
+
+    // Polls receiverStats() once a second on the main loop.
+    void setReceiverStatsListener(int mount, std::function<void(const ReceiverStats&)> listener);
+
+    // Test stand-in for a lossy link: drops this fraction of outgoing RTP
+    // packets on every mount. Set before clients connect.
+    void setTestPacketLoss(double fraction) { test_loss = fraction; }
 
 private:
+    struct Mount {
+        RTSPServer *server = nullptr;
+        std::string path;
+        std::mutex src_mutex;
+        GstElement *app_src = nullptr;
+        GstRTSPMedia *media = nullptr;
+        std::function<void(const ReceiverStats&)> stats_listener;
+        std::function<void()> keyframe_request;
+        std::atomic<guint64> dropped{0};
+        // Set once an access unit is dropped; delta units are then dropped
+        // too until a keyframe, so viewers never decode a broken GOP.
+        std::atomic<bool> resync{false};
+    };
+
+    static void on_media_configure(GstRTSPMediaFactory *factory, GstRTSPMedia *media, gpointer user_data);
+    static void on_media_unprepared(GstRTSPMedia *media, gpointer user_data);
+    static GstPadProbeReturn on_test_drop_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+    static gboolean on_stats_tick(gpointer user_data);
+
     GstRTSPServer *server = nullptr;
     guint source_id = 0; // Source ID for the main loop attachment
+    std::vector<std::unique_ptr<Mount>> mounts;
+    double test_loss = 0.0;
+    guint stats_tick_id = 0;
 };
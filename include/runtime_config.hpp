@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 struct RuntimeConfig {
     bool thermalEnabled = false;
@@ -15,6 +16,30 @@ struct RuntimeConfig {
     std::string int8Bin = "models/nanodet_m-int8.bin";
 
     bool showLabels = true;
+    bool osdEnabled = true;
+    bool osdExtrapolate = true;
+    int osdMaxExtrapolationMs = 300;
+    int osdDelayMs = 0;
+
+    // Software encoder and its CPU-budget governor
+    int encBitrateKbps = 1000;
+    int encThreads = 4;
+    bool encGovernor = false;
+    int encMinBitrateKbps = 400;
+    int encMinFps = 8;
+
+    // Network-adaptive bitrate from RTCP receiver reports
+    bool netAdaptive = false;
+    int netMinBitrateKbps = 200;
+    float netTestLoss = 0.0f;   // in-process RTP dropper for testing
+
+    // Detection-driven ROI encoding on the main stream
+    bool roiEncode = false;
+    int roiCrf = 26;
+    int roiStaticThreshold = 4;
+    float roiMargin = 0.2f;
+    int roiMaxHold = 15;
+    int roiDeltaQp = -8;
     float personMinScore = 0.55f;
     int personMax = 2;
     float personMinAreaRatio = 0.6f;
@@ -23,6 +48,69 @@ struct RuntimeConfig {
 
     std::string rtspHost;
 
+    // Cameras by libcamera name (`cam -l`), one pipeline and mount set
+    // each; empty = the first camera only. Read at startup.
+    std::vector<std::string> cameras;
+
+    // Low-resolution sub-stream at rtsp://<host>:8554/sub
+    bool subEnabled = false;
+    int subWidth = 320;
+    int subHeight = 240;
+    int subBitrateKbps = 300;
+    bool subShareAi = true;
+
+    // Out-of-band detection metadata (UDP datagrams + SSE)
+    bool metaEnabled = false;
+    std::string metaUdpHost = "127.0.0.1";
+    int metaUdpPort = 5600;
+    int metaHttpPort = 8081;
+
+    // In-process WebRTC output with built-in HTTP signaling
+    bool webrtcEnabled = false;
+    int webrtcPort = 8889;
+    std::string webrtcBind = "0.0.0.0";   // a specific address also limits ICE candidates
+    int webrtcMaxSessions = 4;
+    std::string webrtcStun;                // stun://host:port; empty = host candidates only
+
+    // Raw frames and detections shared with local sidecars (memfd ring)
+    bool shareEnabled = false;
+    std::string shareSocket = "/tmp/nanostream-share.sock";
+    bool shareCamera = true;
+    bool shareAiInput = true;
+    int shareSlots = 4;
+
+    // Track lifecycle events (enter/exit/zone/class) to MQTT or a Unix socket
+    bool eventsEnabled = false;
+    std::string eventsUrl = "mqtt://127.0.0.1:1883/nanostream/events";
+    std::string eventsZones;    // name:x0,y0,x1,y1;... in normalized coordinates
+    int eventsMinHits = 3;
+    int eventsExitMs = 1500;
+    int eventsQueue = 256;
+    int eventsBatchMs = 200;
+    std::string eventsDrop = "oldest";
+
+    // Event clips cut from the encoded main stream
+    bool recEnabled = false;
+    std::string recDir = "recordings";
+    std::string recFormat = "mp4";
+    std::string recLabels;      // comma-separated; empty = any detection
+    float recMinScore = 0.5f;
+    int recPreRollSec = 5;
+    int recPostRollSec = 5;
+    int recMaxClipSec = 60;
+    int recRingKb = 4096;
+
+    // Thread placement, applied at startup; taskset-style core lists
+    std::string cpuStream;      // main loop, RTSP, capture/encode threads
+    std::string cpuAi;          // AI worker, its ncnn/OpenMP team, AI branch
+    int streamRtPriority = 0;   // SCHED_FIFO for capture/encode threads; 0 = off
+    int aiNice = 0;
+
+    // Per-stage hardware counter profiling, report rewritten periodically
+    bool perfProfile = false;
+    std::string perfReport = "perf_stages.md";
+    int perfIntervalSec = 10;
+
     // Detector overrides (optional)
     int detInputWidth = 0;
     int detInputHeight = 0;
@@ -39,9 +127,61 @@ struct RuntimeConfig {
     float detEmaAlpha = 0.0f;
     int detMinBoxArea = 0;
     std::string detHeads;
+    bool detCascade = false;
+    int detCascadeInput = 0;
+    int detCascadeRoiInput = 0;
+    int detCascadeMaxRois = 0;
+    float detCascadeProposalScore = 0.0f;
+    float detCascadeRefineArea = 0.0f;
+
+    // Load-adaptive input size: steps parsed from NANOSTREAM_DET_INPUT_STEPS
+    bool detAdaptiveInput = false;
+    std::vector<int> detInputSteps = {256, 320, 416};
+    int detLatencyBudgetMs = 150;
+
+    // Head decodes handed to a pool while later heads are extracted; 0 = inline
+    int detDecodeThreads = 0;
+
+    // Shared detector across cameras: frames tiled into one forward, and
+    // the order waiting cameras are served in ("rr" or "deadline")
+    int detBatch = 1;
+    std::string detSchedule = "rr";
 };
 
+struct DetectorHead {
+    std::string cls;
+    std::string reg;
+    int stride = 0;
+};
+
+// Named rectangle in normalized frame coordinates.
+struct EventZone {
+    std::string name;
+    float x0 = 0.0f, y0 = 0.0f, x1 = 1.0f, y1 = 1.0f;
+};
+
+// Environment only, unvalidated.
 RuntimeConfig loadRuntimeConfig();
+
+// Environment overlaid with the KEY=VALUE file named by NANOSTREAM_CONFIG,
+// then validated. Leaves out untouched on failure.
+bool loadRuntimeConfig(RuntimeConfig& out, std::string& error);
+bool validateRuntimeConfig(const RuntimeConfig& cfg, std::string& error);
+std::vector<DetectorHead> parseDetectorHeads(const std::string& spec);
+// "name:x0,y0,x1,y1;name:..." with coordinates in [0, 1]. Returns false on
+// any malformed entry.
+bool parseEventZones(const std::string& spec, std::vector<EventZone>& out);
+
+// Current immutable snapshot: a single atomic pointer load. References stay
+// valid after a reload but keep showing the snapshot they came from, so
+// long-running loops should call this again each iteration.
 const RuntimeConfig& getRuntimeConfig();
+
+// Bumped on every published snapshot; cheap to poll for changes.
+uint64_t runtimeConfigVersion();
+
+// Re-reads environment and config file and swaps the snapshot if it
+// validates. Settings that shape the pipeline take effect on restart.
+bool reloadRuntimeConfig(std::string& error);
 std::string formatRuntimeConfig(const RuntimeConfig& cfg);
 std::string resolveRtspHost(const RuntimeConfig& cfg);
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Opt-in per-stage hardware counters (NANOSTREAM_PERF=1). Each Scope reads
+// a perf_event_open group on the calling thread: cycles, instructions, L1D
+// read accesses and misses, last-level cache misses, branches and branch
+// misses. Stages aggregate IPC and miss rates across calls and threads.
+// Where the kernel refuses counters (containers, perf_event_paranoid, no
+// PMU) stages still record wall time and the report marks counters n/a.
+namespace stage_profiler {
+
+enum Counter {
+    kCycles,
+    kInstructions,
+    kL1dAccesses,
+    kL1dMisses,
+    kLlcMisses,
+    kBranches,
+    kBranchMisses,
+    kCounterCount
+};
+
+// Off until enabled; a disabled Scope costs one relaxed load.
+void enable();
+bool enabled();
+
+// Stable id for a stage name; registers it on first use.
+int stage(const std::string& name);
+
+struct Snapshot {
+    int64_t ns = 0;
+    bool counters = false;
+    uint64_t enabledNs = 0;
+    uint64_t runningNs = 0;
+    uint64_t values[kCounterCount] = {};
+};
+
+class Scope {
+public:
+    explicit Scope(int stage);
+    ~Scope();
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    int stage_;
+    bool active_;
+    Snapshot start_;
+};
+
+// Markdown table of every stage so far; counters are scaled for
+// multiplexing and only averaged over calls where they were running.
+std::string formatReport();
+bool writeReport(const std::string& path);
+
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running submitted tasks in FIFO order. The
+// threads are started by the constructor, so they inherit the creating
+// thread's CPU affinity and nice value.
+class TaskPool {
+public:
+    explicit TaskPool(int threads);
+    ~TaskPool();
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    int size() const { return static_cast<int>(workers.size()); }
+
+    void submit(std::function<void()> task);
+
+    // Blocks until every task submitted so far has finished.
+    void wait();
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable task_cv;
+    std::condition_variable idle_cv;
+    std::deque<std::function<void()>> tasks;
+    int unfinished = 0;
+    bool stopping = false;
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Per-thread CPU placement and scheduling. Core lists use the taskset
+// syntax ("2-3", "0,2"). Linux applies affinity, policy and nice per
+// thread, and new threads inherit them from their creator.
+namespace thread_topology {
+
+// Sorted, de-duplicated core ids; empty on a syntax error.
+std::vector<int> parseCpuList(const std::string& spec);
+std::string formatCpuList(const std::vector<int>& cpus);
+
+// Each returns false (and logs once per kind) when the kernel refuses,
+// e.g. SCHED_FIFO without CAP_SYS_NICE or an RLIMIT_RTPRIO.
+bool pinCurrentThread(const std::vector<int>& cpus);
+bool setCurrentThreadFifo(int priority);
+bool setCurrentThreadNice(int nice);
+
+// The calling thread's placement as the kernel reports it, e.g.
+// "tid=812 cpus=0-1 SCHED_FIFO/10".
+std::string describeCurrentThread();
+
+}
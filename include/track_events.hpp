@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "object_detector.hpp"
+#include "runtime_config.hpp"
+
+// A change in an object's life on one camera, rather than a per-frame box.
+struct TrackEvent {
+    enum Type { Enter, Exit, Zone, Class };
+
+    Type type = Enter;
+    int camera = 0;
+    uint64_t track = 0;
+    int classId = -1;
+    std::string label;
+    std::string zone;       // zone holding the box centre; empty = none
+    std::string fromZone;   // Zone events only
+    int fromClassId = -1;   // Class events only
+    std::string fromLabel;
+    float score = 0.0f;
+    int x = 0, y = 0, w = 0, h = 0;
+    uint64_t pts = DetectionFrame::kNoPts;
+    int64_t timestampUs = 0;
+
+    static const char* typeName(Type type);
+};
+
+// Turns one camera's detection results into track lifecycle events. Boxes
+// are associated to tracks by IoU, preferring the same class; a match
+// across classes needs classIouThreshold and reports a Class event. A
+// track is announced after minHits consecutive results and retired once
+// it has been unseen for exitMs. Call update() from one thread per
+// instance.
+class TrackEventTracker {
+public:
+    struct Config {
+        std::vector<EventZone> zones;
+        int minHits = 3;
+        int exitMs = 1500;
+        float iouThreshold = 0.3f;
+        float classIouThreshold = 0.5f;
+    };
+
+    void configure(const Config& cfg);
+
+    // Appends the events caused by this result to `events`.
+    void update(const DetectionFrame& frame, std::vector<TrackEvent>& events);
+
+private:
+    struct Track {
+        uint64_t id = 0;
+        Detection box;
+        int hits = 0;
+        bool confirmed = false;
+        int64_t lastSeenUs = 0;
+        std::string zone;
+    };
+
+    std::string zoneOf(const Detection& d, int frame_w, int frame_h) const;
+    TrackEvent makeEvent(TrackEvent::Type type, const Track& track, const DetectionFrame& frame) const;
+
+    Config config;
+    std::vector<Track> tracks;
+    uint64_t next_id = 1;
+};
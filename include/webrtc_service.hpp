@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gst/gst.h>
+
+// In-process WebRTC output: each viewer gets a small appsrc ! h264parse !
+// rtph264pay ! webrtcbin pipeline fed with the same encoded access units
+// as the RTSP mounts, so there is no RTSP pull, depayload or extra hop.
+// Signaling is plain HTTP, answered once ICE gathering is complete (no
+// trickle). It speaks both of the endpoints deploy/mediamtx/webrtc-simple.html
+// tries first:
+//   POST /<path>/webrtc       JSON {"type":"offer","sdp":...} -> JSON answer
+//   POST /<path>/whep         application/sdp offer -> 201 + SDP answer
+//   DELETE /<path>/whep/<id>  ends a WHEP session
+// GET / serves the page itself when it is found next to the binary's cwd.
+class WebRTCServer {
+public:
+    struct Config {
+        int port = 8889;
+        // Signaling bind address. A specific address also limits ICE
+        // candidates to it, e.g. 127.0.0.1 for a loopback-only test.
+        std::string bind = "0.0.0.0";
+        int maxSessions = 4;
+        std::string stunServer;     // stun://host:port; empty = host candidates only
+    };
+
+    WebRTCServer();
+    ~WebRTCServer();
+
+    // Registers a path (e.g. "live", "sub") before start().
+    int addPath(const std::string& path);
+
+    // False if webrtcbin or its DTLS/SRTP/ICE plugins are missing, or the
+    // port cannot be bound.
+    bool start(const Config& cfg);
+    void stop();
+
+    // Same contract as RTSPServer::pushBuffer(): a new reference per
+    // connected viewer, never a payload copy. Any streaming thread.
+    void pushBuffer(int path, GstBuffer* buffer);
+
+    // Called when a viewer connects or its browser asks for a keyframe
+    // (PLI/FIR), so pictures start without waiting a GOP.
+    void setKeyframeRequest(int path, std::function<void()> request);
+
+private:
+    struct Path {
+        std::string name;
+        std::function<void()> keyframe_request;
+    };
+    struct Session;
+
+    void serveLoop();
+    void handleClient(int fd);
+    std::string negotiate(int path, const std::string& offer_sdp, std::string& session_id, int& status);
+    void closeSession(const std::string& id);
+    static void teardown(Session& session);
+
+    static gboolean on_reap_tick(gpointer user_data);
+    static void on_connection_state(GstElement* webrtc, GParamSpec* pspec, gpointer user_data);
+    static GstPadProbeReturn on_upstream_event(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+
+    Config config;
+    std::vector<Path> paths;
+    std::string page;
+
+    int listen_fd = -1;
+    int wake_pipe[2] = {-1, -1};
+    std::thread serve_thread;
+    std::atomic<bool> running{false};
+    guint reap_tick_id = 0;
+
+    std::mutex sessions_mutex;
+    std::vector<std::shared_ptr<Session>> sessions;
+};
@@ -0,0 +1,67 @@
+#include "aligned_video_pool.hpp"
+
+#include <iostream>
+#include <gst/video/video.h>
+
+namespace aligned_video_pool {
+
+namespace {
+
+GstBufferPool* makePool(GstCaps *caps, guint min_buffers, guint& size) {
+    GstVideoInfo info;
+    if (!gst_video_info_from_caps(&info, caps)) return nullptr;
+
+    GstVideoAlignment align;
+    gst_video_alignment_reset(&align);
+    align.padding_bottom = 1;
+    for (int i = 0; i < GST_VIDEO_MAX_PLANES; ++i) align.stride_align[i] = kAlignment - 1;
+
+    GstAllocationParams params;
+    gst_allocation_params_init(&params);
+    params.align = kAlignment - 1;
+
+    GstBufferPool *pool = gst_video_buffer_pool_new();
+    GstStructure *config = gst_buffer_pool_get_config(pool);
+    // No upper bound: a detector holding frames must never stall upstream.
+    gst_buffer_pool_config_set_params(config, caps, static_cast<guint>(info.size), min_buffers, 0);
+    gst_buffer_pool_config_set_allocator(config, nullptr, &params);
+    gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_VIDEO_META);
+    gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_VIDEO_ALIGNMENT);
+    gst_buffer_pool_config_set_video_alignment(config, &align);
+    if (!gst_buffer_pool_set_config(pool, config)) {
+        gst_object_unref(pool);
+        return nullptr;
+    }
+
+    // The pool grows the size to cover padded strides and the spare row.
+    config = gst_buffer_pool_get_config(pool);
+    gst_buffer_pool_config_get_params(config, nullptr, &size, nullptr, nullptr);
+    gst_structure_free(config);
+    return pool;
+}
+
+}
+
+GstPadProbeReturn allocationProbe(GstPad *pad, GstPadProbeInfo *info, gpointer min_buffers) {
+    GstQuery *query = GST_PAD_PROBE_INFO_QUERY(info);
+    if (GST_QUERY_TYPE(query) != GST_QUERY_ALLOCATION) return GST_PAD_PROBE_OK;
+
+    GstCaps *caps = nullptr;
+    gboolean need_pool = FALSE;
+    gst_query_parse_allocation(query, &caps, &need_pool);
+    guint size = 0;
+    GstBufferPool *pool = caps ? makePool(caps, GPOINTER_TO_UINT(min_buffers), size) : nullptr;
+    if (!pool) return GST_PAD_PROBE_OK;
+
+    GstAllocationParams params;
+    gst_allocation_params_init(&params);
+    params.align = kAlignment - 1;
+    gst_query_add_allocation_param(query, nullptr, &params);
+    gst_query_add_allocation_pool(query, pool, size, GPOINTER_TO_UINT(min_buffers), 0);
+    gst_query_add_allocation_meta(query, GST_VIDEO_META_API_TYPE, nullptr);
+    gst_object_unref(pool);
+    std::cout << "[NanoStream] AI branch: " << kAlignment << "-byte aligned pool, " << size << " bytes/buffer" << std::endl;
+    return GST_PAD_PROBE_HANDLED;
+}
+
+}
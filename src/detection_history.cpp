@@ -0,0 +1,123 @@
+#include <algorithm>
+#include <cmath>
+
+#include "detection_history.hpp"
+
+namespace {
+
+float iou(const Detection& a, const Detection& b) {
+    int x1 = std::max(a.x, b.x);
+    int y1 = std::max(a.y, b.y);
+    int x2 = std::min(a.x + a.w, b.x + b.w);
+    int y2 = std::min(a.y + a.h, b.y + b.h);
+    int inter = std::max(0, x2 - x1) * std::max(0, y2 - y1);
+    int uni = a.w * a.h + b.w * b.h - inter;
+    return uni > 0 ? (float)inter / (float)uni : 0.0f;
+}
+
+}
+
+DetectionHistory::DetectionHistory() : DetectionHistory(Config()) {}
+
+DetectionHistory::DetectionHistory(const Config& cfg) {
+    configure(cfg);
+}
+
+void DetectionHistory::configure(const Config& cfg) {
+    std::lock_guard<std::mutex> lock(mutex);
+    config = cfg;
+    if (config.capacity < 2) config.capacity = 2;
+    ring.assign(config.capacity, Entry());
+    for (auto& e : ring) {
+        e.dets.reserve(16);
+        e.vx.reserve(16);
+        e.vy.reserve(16);
+    }
+    head = 0;
+    count = 0;
+}
+
+void DetectionHistory::estimateVelocities(const Entry& prev, Entry& cur) const {
+    cur.vx.assign(cur.dets.size(), 0.0f);
+    cur.vy.assign(cur.dets.size(), 0.0f);
+    if (prev.pts == DetectionFrame::kNoPts || cur.pts == DetectionFrame::kNoPts) return;
+    if (cur.pts <= prev.pts || cur.pts - prev.pts > config.staleNs) return;
+    const float dt = (cur.pts - prev.pts) / 1e9f;
+
+    for (size_t i = 0; i < cur.dets.size(); ++i) {
+        const Detection& d = cur.dets[i];
+        int best = -1;
+        float best_iou = 0.1f;
+        for (size_t j = 0; j < prev.dets.size(); ++j) {
+            const Detection& p = prev.dets[j];
+            if (d.class_id >= 0 && p.class_id >= 0 && d.class_id != p.class_id) continue;
+            float v = iou(d, p);
+            if (v > best_iou) { best_iou = v; best = static_cast<int>(j); }
+        }
+        if (best < 0) continue;
+        const Detection& p = prev.dets[best];
+        float vx = ((d.x + d.w * 0.5f) - (p.x + p.w * 0.5f)) / dt;
+        float vy = ((d.y + d.h * 0.5f) - (p.y + p.h * 0.5f)) / dt;
+        // Blend with the matched object's previous estimate to damp jitter.
+        cur.vx[i] = 0.5f * vx + 0.5f * prev.vx[best];
+        cur.vy[i] = 0.5f * vy + 0.5f * prev.vy[best];
+    }
+}
+
+void DetectionHistory::push(const DetectionFrame& frame) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry& cur = ring[head];
+    cur.pts = frame.pts;
+    cur.dets = frame.detections;
+    if (count > 0) {
+        const Entry& prev = ring[(head + ring.size() - 1) % ring.size()];
+        estimateVelocities(prev, cur);
+    } else {
+        cur.vx.assign(cur.dets.size(), 0.0f);
+        cur.vy.assign(cur.dets.size(), 0.0f);
+    }
+    head = (head + 1) % ring.size();
+    if (count < ring.size()) ++count;
+}
+
+bool DetectionHistory::lookup(uint64_t pts, std::vector<Detection>& out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    out.clear();
+    if (count == 0) return false;
+
+    const size_t newest = (head + ring.size() - 1) % ring.size();
+    if (pts == DetectionFrame::kNoPts || ring[newest].pts == DetectionFrame::kNoPts) {
+        out = ring[newest].dets;
+        return true;
+    }
+
+    // Newest result computed on a frame at or before pts; if pts predates
+    // everything we hold, extrapolate the oldest one backwards instead.
+    const Entry* match = nullptr;
+    for (size_t i = 0; i < count; ++i) {
+        const Entry& e = ring[(head + ring.size() - 1 - i) % ring.size()];
+        if (e.pts == DetectionFrame::kNoPts) continue;
+        match = &e;
+        if (e.pts <= pts) break;
+    }
+    if (!match) return false;
+
+    const double dt_ns = static_cast<double>(pts) - static_cast<double>(match->pts);
+    if (std::fabs(dt_ns) > static_cast<double>(config.staleNs)) return false;
+
+    out = match->dets;
+    if (!config.extrapolate || dt_ns == 0.0) return true;
+    const double max_ns = static_cast<double>(config.maxExtrapolationNs);
+    const float dt = static_cast<float>(std::max(-max_ns, std::min(max_ns, dt_ns)) / 1e9);
+    for (size_t i = 0; i < out.size(); ++i) {
+        out[i].x += static_cast<int>(match->vx[i] * dt);
+        out[i].y += static_cast<int>(match->vy[i] * dt);
+    }
+    return true;
+}
+
+void DetectionHistory::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    head = 0;
+    count = 0;
+}
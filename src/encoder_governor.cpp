@@ -0,0 +1,69 @@
+#include <algorithm>
+
+#include "encoder_governor.hpp"
+
+namespace {
+
+constexpr float kBitrateStep = 0.8f;
+constexpr int kFpsStep = 2;
+
+}
+
+void EncoderGovernor::configure(const Config& config) {
+    cfg = config;
+    cfg.minBitrateKbps = std::max(1, std::min(cfg.minBitrateKbps, cfg.maxBitrateKbps));
+    cfg.minFps = std::max(1, std::min(cfg.minFps, cfg.maxFps));
+    level_ = 0;
+    windows_since_switch = 0;
+    quiet_windows = 0;
+}
+
+int EncoderGovernor::bitrateSteps() const {
+    int steps = 0;
+    float b = static_cast<float>(cfg.maxBitrateKbps);
+    while (b * kBitrateStep >= cfg.minBitrateKbps) {
+        b *= kBitrateStep;
+        steps++;
+    }
+    return steps + (static_cast<int>(b) > cfg.minBitrateKbps ? 1 : 0);
+}
+
+int EncoderGovernor::maxLevel() const {
+    return bitrateSteps() + (cfg.maxFps - cfg.minFps + kFpsStep - 1) / kFpsStep;
+}
+
+int EncoderGovernor::bitrateKbps() const {
+    float b = static_cast<float>(cfg.maxBitrateKbps);
+    for (int i = 0; i < std::min(level_, bitrateSteps()); ++i) b *= kBitrateStep;
+    return std::max(cfg.minBitrateKbps, static_cast<int>(b));
+}
+
+int EncoderGovernor::fps() const {
+    int fps_level = std::max(0, level_ - bitrateSteps());
+    return std::max(cfg.minFps, cfg.maxFps - fps_level * kFpsStep);
+}
+
+bool EncoderGovernor::update(const Sample& s) {
+    const float interval_ms = 1000.0f / std::max(1, fps());
+    const float drop_rate = s.framesIn > 0 ? static_cast<float>(s.framesDropped) / s.framesIn : 0.0f;
+    const bool over = drop_rate > cfg.maxDropRate ||
+                      s.encodeMs > cfg.encodeBudget * interval_ms ||
+                      s.aiLatencyMs > cfg.aiLatencyBudgetMs;
+    const bool quiet = s.framesDropped == 0 &&
+                       s.encodeMs < 0.5f * cfg.encodeBudget * interval_ms &&
+                       s.aiLatencyMs < cfg.aiLatencyBudgetMs * 0.7f;
+    quiet_windows = quiet ? quiet_windows + 1 : 0;
+    if (++windows_since_switch < cfg.holdWindows) return false;
+
+    int next = level_;
+    if (over && level_ < maxLevel()) {
+        next = level_ + 1;
+    } else if (quiet_windows >= cfg.quietWindows && level_ > 0) {
+        next = level_ - 1;
+        quiet_windows = 0;
+    }
+    if (next == level_) return false;
+    level_ = next;
+    windows_since_switch = 0;
+    return true;
+}
@@ -0,0 +1,492 @@
+#include "event_publisher.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <utility>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+void appendEscaped(std::ostringstream& out, const std::string& s) {
+    for (char c : s) {
+        if (c == '"' || c == '\\') out << '\\';
+        if (static_cast<unsigned char>(c) < 0x20) continue;
+        out << c;
+    }
+}
+
+void appendZone(std::ostringstream& out, const std::string& zone) {
+    if (zone.empty()) {
+        out << "null";
+        return;
+    }
+    out << '"';
+    appendEscaped(out, zone);
+    out << '"';
+}
+
+// Non-blocking socket; every write waits at most timeout_ms for room.
+bool sendAll(int fd, const char* data, size_t len, int timeout_ms) {
+    const auto deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n > 0) {
+            data += n;
+            len -= static_cast<size_t>(n);
+            continue;
+        }
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) return false;
+        const int left = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - Clock::now()).count());
+        if (left <= 0) return false;
+        pollfd p{fd, POLLOUT, 0};
+        if (poll(&p, 1, left) < 0 && errno != EINTR) return false;
+    }
+    return true;
+}
+
+bool recvAll(int fd, uint8_t* data, size_t len, int timeout_ms) {
+    const auto deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (len > 0) {
+        ssize_t n = recv(fd, data, len, MSG_DONTWAIT);
+        if (n > 0) {
+            data += n;
+            len -= static_cast<size_t>(n);
+            continue;
+        }
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) return false;
+        const int left = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - Clock::now()).count());
+        if (left <= 0) return false;
+        pollfd p{fd, POLLIN, 0};
+        if (poll(&p, 1, left) < 0 && errno != EINTR) return false;
+    }
+    return true;
+}
+
+// Reads whatever the peer sent without blocking; false once it has hung up.
+bool drainInput(int fd) {
+    uint8_t buf[256];
+    while (true) {
+        ssize_t n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (n > 0) continue;
+        return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+    }
+}
+
+int connectTcp(const std::string& host, const std::string& port, int timeout_ms) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* res = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &res) != 0) return -1;
+    int fd = -1;
+    for (addrinfo* ai = res; ai && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) continue;
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+        int err = errno;
+        if (err == EINPROGRESS) {
+            pollfd p{fd, POLLOUT, 0};
+            socklen_t len = sizeof(err);
+            if (poll(&p, 1, timeout_ms) == 1 && getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) == 0 && err == 0) {
+                break;
+            }
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+// MQTT 3.1.1 framing: fixed header byte, variable-length remaining length.
+void appendRemainingLength(std::string& out, size_t len) {
+    do {
+        uint8_t byte = len % 128;
+        len /= 128;
+        if (len > 0) byte |= 0x80;
+        out.push_back(static_cast<char>(byte));
+    } while (len > 0);
+}
+
+void appendMqttString(std::string& out, const std::string& s) {
+    out.push_back(static_cast<char>((s.size() >> 8) & 0xff));
+    out.push_back(static_cast<char>(s.size() & 0xff));
+    out += s;
+}
+
+std::string mqttPacket(uint8_t header, const std::string& body) {
+    std::string packet(1, static_cast<char>(header));
+    appendRemainingLength(packet, body.size());
+    return packet + body;
+}
+
+struct ParsedUrl {
+    bool mqtt = false;
+    std::string host;
+    std::string port = "1883";
+    std::string topic;
+    std::string path;
+};
+
+bool parseUrl(const std::string& url, ParsedUrl& out) {
+    if (url.compare(0, 7, "unix://") == 0) {
+        out.path = url.substr(7);
+        return !out.path.empty() && out.path.size() < sizeof(sockaddr_un::sun_path);
+    }
+    if (url.compare(0, 7, "mqtt://") != 0) return false;
+    out.mqtt = true;
+    std::string rest = url.substr(7);
+    size_t slash = rest.find('/');
+    std::string authority = rest.substr(0, slash);
+    out.topic = slash == std::string::npos ? "" : rest.substr(slash + 1);
+    size_t colon = authority.rfind(':');
+    if (colon != std::string::npos && authority.find(']') == std::string::npos) {
+        out.port = authority.substr(colon + 1);
+        authority.erase(colon);
+    }
+    if (authority.size() > 2 && authority.front() == '[' && authority.back() == ']') {
+        authority = authority.substr(1, authority.size() - 2);
+    }
+    out.host = authority;
+    return !out.host.empty() && !out.topic.empty() && !out.port.empty() &&
+           out.port.find_first_not_of("0123456789") == std::string::npos &&
+           out.topic.find_first_of("+#") == std::string::npos;
+}
+
+}
+
+class EventPublisher::Transport {
+public:
+    virtual ~Transport() { disconnect(); }
+    virtual std::string describe() const = 0;
+    virtual bool connect(const EventPublisher::Config& cfg) = 0;
+    virtual bool send(const std::string& payload, const EventPublisher::Config& cfg) = 0;
+    // Called while there is nothing to send: keep-alives, hang-up detection.
+    virtual void idle(const EventPublisher::Config&) {
+        if (fd >= 0 && !drainInput(fd)) disconnect();
+    }
+    bool connected() const { return fd >= 0; }
+    void disconnect() {
+        if (fd >= 0) close(fd);
+        fd = -1;
+    }
+
+protected:
+    int fd = -1;
+};
+
+namespace {
+
+// One JSON line per batch on a Unix stream socket.
+class UnixTransport final : public EventPublisher::Transport {
+public:
+    explicit UnixTransport(std::string path) : path(std::move(path)) {}
+
+    std::string describe() const override { return "unix://" + path; }
+
+    bool connect(const EventPublisher::Config&) override {
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) return false;
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            disconnect();
+            return false;
+        }
+        return true;
+    }
+
+    bool send(const std::string& payload, const EventPublisher::Config& cfg) override {
+        const std::string line = payload + "\n";
+        return sendAll(fd, line.data(), line.size(), cfg.ioTimeoutMs);
+    }
+
+private:
+    std::string path;
+};
+
+// Just enough MQTT 3.1.1 for a publisher: CONNECT/CONNACK with a clean
+// session, QoS 0 PUBLISH and PINGREQ keep-alives. Nothing is subscribed.
+class MqttTransport final : public EventPublisher::Transport {
+public:
+    explicit MqttTransport(ParsedUrl url) : url(std::move(url)) {}
+
+    std::string describe() const override {
+        return "mqtt://" + url.host + ":" + url.port + "/" + url.topic;
+    }
+
+    bool connect(const EventPublisher::Config& cfg) override {
+        fd = connectTcp(url.host, url.port, cfg.ioTimeoutMs);
+        if (fd < 0) return false;
+        std::string body;
+        appendMqttString(body, "MQTT");
+        body.push_back(4);      // protocol level 3.1.1
+        body.push_back(0x02);   // clean session
+        body.push_back(static_cast<char>((cfg.keepAliveSec >> 8) & 0xff));
+        body.push_back(static_cast<char>(cfg.keepAliveSec & 0xff));
+        appendMqttString(body, cfg.clientId);
+        const std::string packet = mqttPacket(0x10, body);
+        uint8_t connack[4];
+        if (!sendAll(fd, packet.data(), packet.size(), cfg.ioTimeoutMs) ||
+            !recvAll(fd, connack, sizeof(connack), cfg.ioTimeoutMs) ||
+            connack[0] != 0x20 || connack[1] != 0x02 || connack[3] != 0) {
+            disconnect();
+            return false;
+        }
+        last_sent = Clock::now();
+        return true;
+    }
+
+    bool send(const std::string& payload, const EventPublisher::Config& cfg) override {
+        std::string body;
+        appendMqttString(body, url.topic);
+        body += payload;
+        const std::string packet = mqttPacket(0x30, body);
+        if (!sendAll(fd, packet.data(), packet.size(), cfg.ioTimeoutMs)) return false;
+        last_sent = Clock::now();
+        return true;
+    }
+
+    void idle(const EventPublisher::Config& cfg) override {
+        if (fd < 0) return;
+        if (!drainInput(fd)) {
+            disconnect();
+            return;
+        }
+        if (Clock::now() - last_sent < std::chrono::seconds(std::max(1, cfg.keepAliveSec / 2))) return;
+        const char ping[2] = {static_cast<char>(0xc0), 0};
+        if (!sendAll(fd, ping, sizeof(ping), cfg.ioTimeoutMs)) {
+            disconnect();
+            return;
+        }
+        last_sent = Clock::now();
+    }
+
+private:
+    ParsedUrl url;
+    Clock::time_point last_sent;
+};
+
+}
+
+EventPublisher::EventPublisher() {}
+
+EventPublisher::~EventPublisher() {
+    stop();
+}
+
+bool EventPublisher::start(const Config& cfg) {
+    if (running) return true;
+    ParsedUrl url;
+    if (!parseUrl(cfg.url, url)) {
+        std::cerr << "[Events] Unusable URL " << cfg.url << std::endl;
+        return false;
+    }
+    config = cfg;
+    config.queueCapacity = std::max<size_t>(1, config.queueCapacity);
+    config.batchMax = std::max<size_t>(1, config.batchMax);
+    if (url.mqtt) {
+        transport.reset(new MqttTransport(url));
+    } else {
+        transport.reset(new UnixTransport(url.path));
+    }
+    running = true;
+    sender_thread = std::thread(&EventPublisher::senderLoop, this);
+    std::cout << "[Events] Track events -> " << transport->describe() << " (queue " << config.queueCapacity
+              << ", batch " << config.batchMs << "ms, drop "
+              << (config.drop == DropPolicy::Oldest ? "oldest" : "newest") << ")" << std::endl;
+    return true;
+}
+
+void EventPublisher::stop() {
+    if (!running.exchange(false)) return;
+    queue_cv.notify_all();
+    if (sender_thread.joinable()) sender_thread.join();
+    transport.reset();
+}
+
+void EventPublisher::publish(const std::vector<TrackEvent>& events) {
+    if (events.empty() || !running) return;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        for (const auto& ev : events) {
+            if (queue.size() >= config.queueCapacity) {
+                dropped_since_batch++;
+                dropped_total.fetch_add(1, std::memory_order_relaxed);
+                if (config.drop == DropPolicy::Newest) continue;
+                queue.pop_front();
+            }
+            if (queue.empty()) oldest_queued = Clock::now();
+            queue.push_back(ev);
+        }
+    }
+    queue_cv.notify_one();
+}
+
+std::string EventPublisher::toJson(const TrackEvent& ev) {
+    std::ostringstream out;
+    out << "{\"ev\":\"" << TrackEvent::typeName(ev.type) << "\""
+        << ",\"cam\":" << ev.camera
+        << ",\"id\":" << ev.track
+        << ",\"cls\":" << ev.classId
+        << ",\"label\":\"";
+    appendEscaped(out, ev.label);
+    out << "\",\"zone\":";
+    appendZone(out, ev.zone);
+    if (ev.type == TrackEvent::Zone) {
+        out << ",\"from\":";
+        appendZone(out, ev.fromZone);
+    } else if (ev.type == TrackEvent::Class) {
+        out << ",\"from_cls\":" << ev.fromClassId << ",\"from_label\":\"";
+        appendEscaped(out, ev.fromLabel);
+        out << "\"";
+    }
+    out << ",\"score\":" << static_cast<int>(ev.score * 1000.0f + 0.5f)
+        << ",\"box\":[" << ev.x << "," << ev.y << "," << ev.w << "," << ev.h << "]"
+        << ",\"pts\":";
+    if (ev.pts == DetectionFrame::kNoPts) out << "null";
+    else out << ev.pts;
+    out << ",\"ts_us\":" << ev.timestampUs << "}";
+    return out.str();
+}
+
+std::string EventPublisher::batchJson(uint64_t seq, uint64_t dropped, const std::vector<TrackEvent>& events) {
+    std::string json = "{\"seq\":" + std::to_string(seq) + ",\"dropped\":" + std::to_string(dropped) + ",\"events\":[";
+    for (size_t i = 0; i < events.size(); ++i) {
+        if (i > 0) json += ",";
+        json += toJson(events[i]);
+    }
+    return json + "]}";
+}
+
+void EventPublisher::coalesce(std::vector<TrackEvent>& events) {
+    std::vector<TrackEvent> out;
+    out.reserve(events.size());
+    // Latest enter/zone event kept for each live (camera, track) pair
+    std::map<std::pair<int, uint64_t>, size_t> open;
+    for (auto& ev : events) {
+        const auto key = std::make_pair(ev.camera, ev.track);
+        auto it = open.find(key);
+        if (ev.type == TrackEvent::Zone && it != open.end()) {
+            TrackEvent& prev = out[it->second];
+            prev.zone = ev.zone;
+            if (prev.type == TrackEvent::Zone) {
+                prev.x = ev.x;
+                prev.y = ev.y;
+                prev.w = ev.w;
+                prev.h = ev.h;
+                prev.score = ev.score;
+                prev.pts = ev.pts;
+                prev.timestampUs = ev.timestampUs;
+            }
+            continue;
+        }
+        out.push_back(std::move(ev));
+        if (out.back().type == TrackEvent::Exit || out.back().type == TrackEvent::Class) {
+            if (it != open.end()) open.erase(it);
+        } else {
+            open[key] = out.size() - 1;
+        }
+    }
+    out.erase(std::remove_if(out.begin(), out.end(), [](const TrackEvent& ev) {
+        return ev.type == TrackEvent::Zone && ev.zone == ev.fromZone;
+    }), out.end());
+    events.swap(out);
+}
+
+// A batch that could not be delivered is held and retried; meanwhile new
+// events wait in the queue, which is where the drop policy applies.
+void EventPublisher::senderLoop() {
+    std::vector<TrackEvent> batch;
+    std::string payload;
+    size_t payload_events = 0;
+    uint64_t seq = 0;
+    int backoff_ms = 1000;
+    Clock::time_point retry_at = Clock::now();
+    bool was_connected = false;
+    uint64_t dropped_logged = 0;
+    Clock::time_point drop_log_at = Clock::now();
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            if (payload.empty()) {
+                queue_cv.wait_for(lock, std::chrono::seconds(1), [this]() { return !queue.empty() || !running; });
+                if (!queue.empty() && running) {
+                    // Batch window: until batchMs after the oldest event, or a full batch.
+                    queue_cv.wait_until(lock, oldest_queued + std::chrono::milliseconds(config.batchMs), [this]() {
+                        return queue.size() >= config.batchMax || !running;
+                    });
+                }
+                const size_t n = std::min(queue.size(), config.batchMax);
+                batch.assign(std::make_move_iterator(queue.begin()), std::make_move_iterator(queue.begin() + n));
+                queue.erase(queue.begin(), queue.begin() + n);
+                if (!queue.empty()) oldest_queued = Clock::now();
+                if (!batch.empty()) {
+                    coalesce(batch);
+                    payload = batchJson(++seq, dropped_since_batch, batch);
+                    payload_events = batch.size();
+                    dropped_since_batch = 0;
+                    batch.clear();
+                }
+            } else {
+                queue_cv.wait_until(lock, retry_at, [this]() { return !running.load(); });
+            }
+        }
+        const bool stopping = !running;
+
+        const uint64_t dropped = dropped_total.load(std::memory_order_relaxed);
+        if (dropped != dropped_logged && Clock::now() - drop_log_at >= std::chrono::seconds(10)) {
+            std::cerr << "\n[Events] Queue full, " << (dropped - dropped_logged) << " events dropped" << std::endl;
+            dropped_logged = dropped;
+            drop_log_at = Clock::now();
+        }
+
+        if (!transport->connected() && (!payload.empty() || stopping) && Clock::now() >= retry_at) {
+            if (transport->connect(config)) {
+                backoff_ms = 1000;
+                was_connected = true;
+                std::cout << "\n[Events] Connected to " << transport->describe() << std::endl;
+            } else {
+                if (was_connected || backoff_ms == 1000) {
+                    std::cerr << "\n[Events] Cannot reach " << transport->describe() << ", retrying" << std::endl;
+                }
+                was_connected = false;
+                retry_at = Clock::now() + std::chrono::milliseconds(backoff_ms);
+                backoff_ms = std::min(backoff_ms * 2, 30000);
+            }
+        }
+        if (transport->connected()) {
+            if (!payload.empty()) {
+                if (transport->send(payload, config)) {
+                    payload.clear();
+                    payload_events = 0;
+                } else {
+                    std::cerr << "\n[Events] Send to " << transport->describe() << " failed, reconnecting" << std::endl;
+                    transport->disconnect();
+                    retry_at = Clock::now() + std::chrono::milliseconds(backoff_ms);
+                }
+            } else {
+                transport->idle(config);
+            }
+        }
+        if (stopping) break;
+    }
+    if (!payload.empty()) {
+        std::cerr << "[Events] " << payload_events << " events undelivered at shutdown" << std::endl;
+    }
+}
@@ -0,0 +1,286 @@
+#include "event_recorder.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <gst/app/gstappsrc.h>
+
+namespace {
+
+constexpr uint64_t kNoReader = UINT64_MAX;
+
+std::string sanitize(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        out += (std::isalnum(static_cast<unsigned char>(c)) || c == '-') ? c : '_';
+    }
+    return out.empty() ? "event" : out;
+}
+
+}
+
+EventRecorder::EventRecorder() {}
+
+EventRecorder::~EventRecorder() {
+    stop();
+}
+
+bool EventRecorder::start(const Config& cfg) {
+    if (running) return true;
+    config = cfg;
+    config.maxUnits = std::max(config.maxUnits, 64);
+    if (g_mkdir_with_parents(config.directory.c_str(), 0755) != 0) {
+        std::cerr << "[Rec] Cannot create " << config.directory << std::endl;
+        return false;
+    }
+
+    // Everything the capture path touches is allocated here, once.
+    arena.assign(static_cast<size_t>(std::max(config.ringBytes, 64 * 1024)), 0);
+    units.assign(static_cast<size_t>(config.maxUnits), Unit{});
+    first_seq = next_seq = 0;
+    written_seq = 0;
+    write_offset = 0;
+    need_keyframe = true;
+    reader_seq = kNoReader;
+
+    running = true;
+    writer_thread = std::thread(&EventRecorder::writerLoop, this);
+    std::cout << "[Rec] Event clips -> " << config.directory << " (" << config.preRollSec << "s pre, "
+              << config.postRollSec << "s post, " << arena.size() / 1024 << " KiB ring)" << std::endl;
+    return true;
+}
+
+void EventRecorder::stop() {
+    if (!running.exchange(false)) return;
+    cv.notify_all();
+    if (writer_thread.joinable()) writer_thread.join();
+}
+
+void EventRecorder::evictOldest() {
+    // Whole GOPs only, so the ring always starts on a keyframe.
+    do {
+        ++first_seq;
+    } while (first_seq < next_seq && !units[first_seq % units.size()].keyframe);
+    if (first_seq == next_seq) write_offset = 0;
+}
+
+bool EventRecorder::reserve(size_t size, size_t& offset) {
+    if (size > arena.size()) return false;
+    while (true) {
+        if (first_seq == next_seq) {
+            offset = 0;
+            break;
+        }
+        const size_t oldest = units[first_seq % units.size()].offset;
+        if (write_offset > oldest) {
+            if (arena.size() - write_offset >= size) { offset = write_offset; break; }
+            if (oldest >= size) { offset = 0; break; }
+        } else if (write_offset < oldest && oldest - write_offset >= size) {
+            offset = write_offset;
+            break;
+        }
+        evictOldest();
+    }
+    write_offset = offset + size;
+    return true;
+}
+
+void EventRecorder::trimPreRoll(gint64 now_us) {
+    const gint64 horizon = now_us - static_cast<gint64>(config.preRollSec) * G_USEC_PER_SEC;
+    while (first_seq < next_seq) {
+        // Drop the oldest GOP only if the next one still covers the window.
+        uint64_t next_key = first_seq + 1;
+        while (next_key < next_seq && !units[next_key % units.size()].keyframe) ++next_key;
+        if (next_key >= next_seq || next_key > reader_seq) return;
+        if (units[next_key % units.size()].arrivalUs > horizon) return;
+        evictOldest();
+    }
+}
+
+void EventRecorder::pushAccessUnit(GstBuffer* buffer) {
+    if (!running) return;
+    GstMapInfo map;
+    if (!gst_buffer_map(buffer, &map, GST_MAP_READ)) return;
+    const bool keyframe = !GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+    const gint64 now = g_get_monotonic_time();
+
+    bool notify = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t offset = 0;
+        if (map.size == 0 || (need_keyframe && !keyframe)) {
+            dropped++;
+        } else {
+            if (next_seq - first_seq >= units.size()) evictOldest();
+            if (!reserve(map.size, offset) || (first_seq == next_seq && !keyframe)) {
+                // Oversized unit, or its GOP was just evicted to make room:
+                // nothing decodable until the next keyframe.
+                need_keyframe = true;
+                dropped++;
+            } else {
+                std::memcpy(arena.data() + offset, map.data, map.size);
+                Unit& unit = units[next_seq % units.size()];
+                unit.seq = next_seq;
+                unit.offset = offset;
+                unit.size = map.size;
+                unit.pts = GST_BUFFER_PTS(buffer);
+                unit.dts = GST_BUFFER_DTS(buffer);
+                unit.arrivalUs = now;
+                unit.keyframe = keyframe;
+                ++next_seq;
+                need_keyframe = false;
+                if (keyframe) trimPreRoll(now);
+            }
+        }
+        notify = clip_pending;
+    }
+    gst_buffer_unmap(buffer, &map);
+    if (notify) cv.notify_one();
+}
+
+void EventRecorder::trigger(const std::string& reason) {
+    if (!running) return;
+    const gint64 now = g_get_monotonic_time();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!clip_pending) {
+            clip_pending = true;
+            clip_start_us = now;
+            clip_reason = reason;
+        }
+        clip_end_us = std::min(now + static_cast<gint64>(config.postRollSec) * G_USEC_PER_SEC,
+                               clip_start_us + static_cast<gint64>(config.maxClipSec) * G_USEC_PER_SEC);
+    }
+    cv.notify_one();
+}
+
+bool EventRecorder::copyUnit(uint64_t seq, std::vector<uint8_t>& out, Unit& unit) {
+    if (seq < first_seq || seq >= next_seq) return false;
+    unit = units[seq % units.size()];
+    out.assign(arena.begin() + unit.offset, arena.begin() + unit.offset + unit.size);
+    return true;
+}
+
+std::string EventRecorder::clipPath(const std::string& reason) const {
+    char stamp[32];
+    std::time_t t = std::time(nullptr);
+    std::tm tm_local{};
+    localtime_r(&t, &tm_local);
+    std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm_local);
+    return config.directory + "/event-" + stamp + "-" + sanitize(reason) +
+           (config.format == "mkv" ? ".mkv" : ".mp4");
+}
+
+void EventRecorder::writerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (running) {
+        cv.wait(lock, [this]() { return !running || clip_pending; });
+        if (!running) break;
+        writeClip(lock);
+    }
+}
+
+void EventRecorder::writeClip(std::unique_lock<std::mutex>& lock) {
+    const std::string reason = clip_reason;
+    // A trigger that lands while the previous clip is being finalized
+    // starts after that clip's last unit instead of replaying its
+    // pre-roll. first_seq is always a keyframe; a later start waits for one.
+    uint64_t cursor = std::max(first_seq, written_seq);
+    bool want_keyframe = cursor != first_seq;
+    reader_seq = cursor;
+    lock.unlock();
+
+    // Fragmented MP4 stays playable if the process dies mid-clip.
+    const std::string path = clipPath(reason);
+    const std::string mux = config.format == "mkv" ? "matroskamux" : "mp4mux fragment-duration=1000";
+    const std::string desc =
+        "appsrc name=src format=time block=true max-bytes=4194304 "
+        "caps=\"video/x-h264,stream-format=byte-stream,alignment=au\" ! "
+        "h264parse ! " + mux + " ! filesink name=file";
+    GError *error = nullptr;
+    GstElement *clip = gst_parse_launch(desc.c_str(), &error);
+    // Set for recoverable problems too, when a pipeline still comes back.
+    const std::string parse_error = error ? error->message : "";
+    if (error) g_error_free(error);
+    GstElement *src = clip ? gst_bin_get_by_name(GST_BIN(clip), "src") : nullptr;
+    GstElement *file = clip ? gst_bin_get_by_name(GST_BIN(clip), "file") : nullptr;
+    if (file) {
+        g_object_set(file, "location", path.c_str(), NULL);
+        gst_object_unref(file);
+    }
+    if (!clip || !src || !file || gst_element_set_state(clip, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+        std::cerr << "[Rec] Cannot start muxer: " << (parse_error.empty() ? "state change failed" : parse_error)
+                  << std::endl;
+        if (src) gst_object_unref(src);
+        if (clip) gst_object_unref(clip);
+        lock.lock();
+        reader_seq = kNoReader;
+        clip_pending = false;
+        return;
+    }
+    std::vector<uint8_t> scratch;
+    Unit unit;
+    GstClockTime base = GST_CLOCK_TIME_NONE;
+    uint64_t written = 0;
+    bool gap = false;
+    bool failed = false;
+
+    lock.lock();
+    while (running) {
+        if (cursor < first_seq) {
+            // The writer fell a whole GOP behind the ring; resume on the
+            // oldest keyframe still held.
+            cursor = first_seq;
+            want_keyframe = false;
+            gap = true;
+        }
+        if (cursor >= next_seq) {
+            if (g_get_monotonic_time() > clip_end_us) break;
+            cv.wait_for(lock, std::chrono::milliseconds(100));
+            continue;
+        }
+        copyUnit(cursor, scratch, unit);
+        if (unit.arrivalUs > clip_end_us) break;
+        reader_seq = ++cursor;
+        if (want_keyframe && !unit.keyframe) continue;
+        want_keyframe = false;
+        lock.unlock();
+
+        GstClockTime ts = GST_CLOCK_TIME_IS_VALID(unit.pts) ? unit.pts
+                                                            : static_cast<GstClockTime>(unit.arrivalUs) * 1000;
+        if (!GST_CLOCK_TIME_IS_VALID(base)) base = ts;
+        GstBuffer *out = gst_buffer_new_allocate(NULL, scratch.size(), NULL);
+        gst_buffer_fill(out, 0, scratch.data(), scratch.size());
+        GST_BUFFER_PTS(out) = ts >= base ? ts - base : 0;
+        GST_BUFFER_DTS(out) = (GST_CLOCK_TIME_IS_VALID(unit.dts) && unit.dts >= base) ? unit.dts - base
+                                                                                      : GST_CLOCK_TIME_NONE;
+        if (!unit.keyframe) GST_BUFFER_FLAG_SET(out, GST_BUFFER_FLAG_DELTA_UNIT);
+        failed = gst_app_src_push_buffer(GST_APP_SRC(src), out) != GST_FLOW_OK;
+        written++;
+
+        lock.lock();
+        if (failed) break;
+    }
+    reader_seq = kNoReader;
+    written_seq = cursor;
+    clip_pending = false;
+    lock.unlock();
+
+    gst_app_src_end_of_stream(GST_APP_SRC(src));
+    GstBus *bus = gst_element_get_bus(clip);
+    GstMessage *msg = gst_bus_timed_pop_filtered(bus, 5 * GST_SECOND,
+        static_cast<GstMessageType>(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+    failed = failed || !msg || GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR;
+    if (msg) gst_message_unref(msg);
+    gst_object_unref(bus);
+    gst_element_set_state(clip, GST_STATE_NULL);
+    gst_object_unref(src);
+    gst_object_unref(clip);
+
+    std::cout << "[Rec] " << (failed ? "Incomplete clip " : "Saved ") << path << " (" << written << " units"
+              << (gap ? ", gap: writer fell behind" : "") << ")" << std::endl;
+    lock.lock();
+}
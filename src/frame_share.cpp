@@ -0,0 +1,286 @@
+#include "frame_share.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+using namespace frame_share;
+
+size_t alignUp(size_t v, size_t a) {
+    return (v + a - 1) / a * a;
+}
+
+#ifndef F_SEAL_FUTURE_WRITE
+#define F_SEAL_FUTURE_WRITE 0x0010
+#endif
+
+int64_t monotonicUs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+void wakeReaders(std::atomic<uint32_t>& word) {
+    word.fetch_add(1, std::memory_order_release);
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+}
+
+bool sendFd(int sock, int fd) {
+    char byte = 'F';
+    iovec iov{&byte, 1};
+    char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    return sendmsg(sock, &msg, MSG_NOSIGNAL) == 1;
+}
+
+}
+
+FrameSharePublisher::FrameSharePublisher() {}
+
+FrameSharePublisher::~FrameSharePublisher() {
+    stop();
+}
+
+bool FrameSharePublisher::start(const Config& cfg) {
+    if (running) return true;
+    config = cfg;
+    const uint32_t slots = static_cast<uint32_t>(std::max(2, config.slots));
+
+    // Slot payloads: NV12/I420 camera, packed RGB AI input, detections.
+    size_t payload[kChannelCount] = {
+        static_cast<size_t>(config.cameraWidth) * config.cameraHeight * 3 / 2,
+        static_cast<size_t>(config.aiWidth) * config.aiHeight * 3,
+        sizeof(DetectionPayload),
+    };
+    size_t offset = alignUp(sizeof(Header), 4096);
+    size_t offsets[kChannelCount];
+    size_t slot_sizes[kChannelCount];
+    for (int c = 0; c < static_cast<int>(kChannelCount); ++c) {
+        slot_sizes[c] = payload[c] ? alignUp(sizeof(SlotHeader) + payload[c], 64) : 0;
+        offsets[c] = offset;
+        offset = alignUp(offset + slot_sizes[c] * (slot_sizes[c] ? slots : 0), 4096);
+    }
+    map_size = offset;
+
+    mem_fd = memfd_create("nanostream-share", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (mem_fd < 0 || ftruncate(mem_fd, static_cast<off_t>(map_size)) != 0) {
+        std::cerr << "[Share] memfd setup failed: " << std::strerror(errno) << std::endl;
+        stop();
+        return false;
+    }
+    void* mapped = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, mem_fd, 0);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "[Share] mmap failed: " << std::strerror(errno) << std::endl;
+        stop();
+        return false;
+    }
+    // Readers can trust the size they map for the lifetime of the fd, and
+    // after this no one can map it writable again; our mapping keeps working.
+    if (fcntl(mem_fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_FUTURE_WRITE | F_SEAL_SEAL) != 0) {
+        std::cerr << "[Share] Cannot seal memfd (" << std::strerror(errno)
+                  << "); sidecars get a read-only fd only" << std::endl;
+        fcntl(mem_fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW);
+    }
+    reader_fd = open(("/proc/self/fd/" + std::to_string(mem_fd)).c_str(), O_RDONLY | O_CLOEXEC);
+    if (reader_fd < 0) {
+        std::cerr << "[Share] Cannot reopen memfd read-only: " << std::strerror(errno) << std::endl;
+        munmap(mapped, map_size);
+        stop();
+        return false;
+    }
+    base = static_cast<uint8_t*>(mapped);
+
+    // ftruncate zero-fills, so every atomic starts at 0.
+    Header* header = reinterpret_cast<Header*>(base);
+    header->version = kVersion;
+    header->totalSize = map_size;
+    const int widths[kChannelCount] = {config.cameraWidth, config.aiWidth, 0};
+    const int heights[kChannelCount] = {config.cameraHeight, config.aiHeight, 0};
+    for (int c = 0; c < static_cast<int>(kChannelCount); ++c) {
+        ChannelDesc& ch = header->channels[c];
+        rings[c].slotCount = slot_sizes[c] ? slots : 0;
+        rings[c].slotSize = static_cast<uint32_t>(slot_sizes[c]);
+        rings[c].offset = offsets[c];
+        ch.slotCount = rings[c].slotCount;
+        ch.slotSize = rings[c].slotSize;
+        ch.offset = rings[c].offset;
+        ch.width = static_cast<uint32_t>(widths[c]);
+        ch.height = static_cast<uint32_t>(heights[c]);
+        next_seq[c] = 1;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = kMagic;
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, config.socketPath.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(config.socketPath.c_str());
+    if (listen_fd < 0 || bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        listen(listen_fd, 8) != 0 || pipe(wake_pipe) != 0) {
+        std::cerr << "[Share] Cannot listen on " << config.socketPath << ": " << std::strerror(errno) << std::endl;
+        stop();
+        return false;
+    }
+
+    running = true;
+    accept_thread = std::thread(&FrameSharePublisher::acceptLoop, this);
+    std::cout << "[Share] Frames -> " << config.socketPath << " (" << map_size / 1024 << " KiB, "
+              << slots << " slots/channel)" << std::endl;
+    return true;
+}
+
+void FrameSharePublisher::stop() {
+    if (running.exchange(false)) {
+        char c = 0;
+        if (write(wake_pipe[1], &c, 1) < 0) {}
+        if (accept_thread.joinable()) accept_thread.join();
+        unlink(config.socketPath.c_str());
+    }
+    // Readers keep their own mapping; unmapping here never invalidates them.
+    if (base) munmap(base, map_size);
+    base = nullptr;
+    for (int* fd : {&mem_fd, &reader_fd, &listen_fd, &wake_pipe[0], &wake_pipe[1]}) {
+        if (*fd >= 0) close(*fd);
+        *fd = -1;
+    }
+}
+
+void FrameSharePublisher::acceptLoop() {
+    while (running) {
+        pollfd fds[2] = {{wake_pipe[0], POLLIN, 0}, {listen_fd, POLLIN, 0}};
+        if (poll(fds, 2, 1000) < 0 && errno != EINTR) break;
+        if (!(fds[1].revents & POLLIN)) continue;
+        int client = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0) continue;
+        if (!sendFd(client, reader_fd)) {
+            std::cerr << "[Share] Failed to hand memfd to a reader" << std::endl;
+        }
+        close(client);
+    }
+}
+
+uint8_t* FrameSharePublisher::beginSlot(Channel channel, uint64_t& seq) {
+    if (!base) return nullptr;
+    const SlotRing& ring = rings[channel];
+    if (ring.slotCount == 0) return nullptr;
+    seq = next_seq[channel]++;
+    SlotHeader* slot = reinterpret_cast<SlotHeader*>(slotAt(base, ring, seq));
+    slot->seq.store((seq << 1) | 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return reinterpret_cast<uint8_t*>(slot);
+}
+
+void FrameSharePublisher::commitSlot(Channel channel, uint64_t seq) {
+    ChannelDesc& ch = reinterpret_cast<Header*>(base)->channels[channel];
+    SlotHeader* slot = reinterpret_cast<SlotHeader*>(slotAt(base, rings[channel], seq));
+    slot->timestampUs = monotonicUs();
+    slot->seq.store(seq << 1, std::memory_order_release);
+    ch.latestSeq.store(seq, std::memory_order_release);
+    wakeReaders(ch.futex);
+}
+
+void FrameSharePublisher::publishCamera(Format format, const uint8_t* const planes[3], const int strides[3],
+                                        int width, int height, uint64_t pts) {
+    if (width != config.cameraWidth || height != config.cameraHeight) return;
+    uint64_t seq = 0;
+    uint8_t* slot_mem = beginSlot(kCamera, seq);
+    if (!slot_mem) return;
+    SlotHeader* slot = reinterpret_cast<SlotHeader*>(slot_mem);
+    uint8_t* dst = slot_mem + sizeof(SlotHeader);
+
+    const int chroma_w = format == kFormatNV12 ? width : width / 2;
+    const int chroma_planes = format == kFormatNV12 ? 1 : 2;
+    for (int y = 0; y < height; ++y, dst += width) {
+        std::memcpy(dst, planes[0] + static_cast<size_t>(y) * strides[0], width);
+    }
+    for (int p = 1; p <= chroma_planes; ++p) {
+        for (int y = 0; y < height / 2; ++y, dst += chroma_w) {
+            std::memcpy(dst, planes[p] + static_cast<size_t>(y) * strides[p], chroma_w);
+        }
+    }
+    slot->pts = pts;
+    slot->format = format;
+    slot->width = static_cast<uint32_t>(width);
+    slot->height = static_cast<uint32_t>(height);
+    slot->stride = static_cast<uint32_t>(width);
+    slot->size = static_cast<uint32_t>(width * height * 3 / 2);
+    slot->count = 0;
+    commitSlot(kCamera, seq);
+}
+
+void FrameSharePublisher::publishAiInput(const uint8_t* rgb, int width, int height, int stride, uint64_t pts) {
+    if (width != config.aiWidth || height != config.aiHeight) return;
+    uint64_t seq = 0;
+    uint8_t* slot_mem = beginSlot(kAiInput, seq);
+    if (!slot_mem) return;
+    SlotHeader* slot = reinterpret_cast<SlotHeader*>(slot_mem);
+    uint8_t* dst = slot_mem + sizeof(SlotHeader);
+    const int row = width * 3;
+    if (stride == row) {
+        std::memcpy(dst, rgb, static_cast<size_t>(row) * height);
+    } else {
+        for (int y = 0; y < height; ++y) std::memcpy(dst + y * row, rgb + static_cast<size_t>(y) * stride, row);
+    }
+    slot->pts = pts;
+    slot->format = kFormatRGB;
+    slot->width = static_cast<uint32_t>(width);
+    slot->height = static_cast<uint32_t>(height);
+    slot->stride = static_cast<uint32_t>(row);
+    slot->size = static_cast<uint32_t>(row * height);
+    slot->count = 0;
+    commitSlot(kAiInput, seq);
+}
+
+void FrameSharePublisher::publishDetections(const DetectionFrame& frame) {
+    uint64_t seq = 0;
+    uint8_t* slot_mem = beginSlot(kDetections, seq);
+    if (!slot_mem) return;
+    SlotHeader* slot = reinterpret_cast<SlotHeader*>(slot_mem);
+    DetectionPayload* payload = reinterpret_cast<DetectionPayload*>(slot_mem + sizeof(SlotHeader));
+    const size_t count = std::min(frame.detections.size(), static_cast<size_t>(kMaxDetections));
+    payload->seq = frame.seq;
+    payload->frameWidth = static_cast<uint32_t>(frame.frameWidth);
+    payload->frameHeight = static_cast<uint32_t>(frame.frameHeight);
+    for (size_t i = 0; i < count; ++i) {
+        const Detection& d = frame.detections[i];
+        SharedDetection& out = payload->detections[i];
+        out.x = d.x;
+        out.y = d.y;
+        out.w = d.w;
+        out.h = d.h;
+        out.classId = d.class_id;
+        out.score = d.score;
+        std::strncpy(out.label, d.label.c_str(), sizeof(out.label) - 1);
+        out.label[sizeof(out.label) - 1] = '\0';
+    }
+    slot->pts = frame.pts;
+    slot->format = kFormatNone;
+    slot->width = payload->frameWidth;
+    slot->height = payload->frameHeight;
+    slot->stride = 0;
+    slot->size = static_cast<uint32_t>(sizeof(DetectionPayload));
+    slot->count = static_cast<uint32_t>(count);
+    commitSlot(kDetections, seq);
+}
@@ -0,0 +1,171 @@
+#include "frame_share_reader.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace frame_share;
+
+namespace {
+
+int receiveFd(int sock) {
+    char byte = 0;
+    iovec iov{&byte, 1};
+    char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) != 1) return -1;
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) return -1;
+    int fd = -1;
+    std::memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+    return fd;
+}
+
+bool ringFits(const ChannelDesc& ch, size_t map_size) {
+    if (ch.slotCount == 0) return true;
+    if (ch.slotSize < sizeof(SlotHeader) || ch.slotSize % alignof(SlotHeader) != 0) return false;
+    if (ch.offset < sizeof(Header) || ch.offset % alignof(SlotHeader) != 0 || ch.offset > map_size) return false;
+    return static_cast<uint64_t>(ch.slotCount) * ch.slotSize <= map_size - ch.offset;
+}
+
+}
+
+FrameShareReader::~FrameShareReader() {
+    disconnect();
+}
+
+bool FrameShareReader::connect(const std::string& socket_path) {
+    disconnect();
+    int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sock < 0) return false;
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+    int fd = -1;
+    if (::connect(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) fd = receiveFd(sock);
+    close(sock);
+    if (fd < 0) return false;
+
+    struct stat st;
+    void* mapped = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(Header)) {
+        mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    }
+    // The mapping keeps the memory alive; the fd is no longer needed.
+    close(fd);
+    if (mapped == MAP_FAILED) return false;
+
+    base = static_cast<const uint8_t*>(mapped);
+    map_size = static_cast<size_t>(st.st_size);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (header()->magic != kMagic || header()->version != kVersion || header()->totalSize != map_size) {
+        disconnect();
+        return false;
+    }
+    for (uint32_t c = 0; c < kChannelCount; ++c) {
+        const ChannelDesc& ch = header()->channels[c];
+        if (!ringFits(ch, map_size) ||
+            (c == kDetections && ch.slotCount > 0 && ch.slotSize < sizeof(SlotHeader) + sizeof(DetectionPayload))) {
+            disconnect();
+            return false;
+        }
+        rings[c].offset = ch.offset;
+        rings[c].slotSize = ch.slotSize;
+        rings[c].slotCount = ch.slotCount;
+    }
+    return true;
+}
+
+void FrameShareReader::disconnect() {
+    if (base) munmap(const_cast<uint8_t*>(base), map_size);
+    base = nullptr;
+    map_size = 0;
+    for (SlotRing& ring : rings) ring = SlotRing();
+}
+
+bool FrameShareReader::channelSize(Channel channel, uint32_t& width, uint32_t& height) const {
+    if (!base || channel >= kChannelCount) return false;
+    const ChannelDesc& ch = header()->channels[channel];
+    width = ch.width;
+    height = ch.height;
+    return rings[channel].slotCount > 0;
+}
+
+bool FrameShareReader::wait(Channel channel, uint64_t after_seq, int timeout_ms) const {
+    if (!base || channel >= kChannelCount) return false;
+    const ChannelDesc& ch = header()->channels[channel];
+    timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += static_cast<long>(timeout_ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    while (true) {
+        // Read the futex word first so a publish between the check and the
+        // wait changes it and the wait returns immediately.
+        const uint32_t word = ch.futex.load(std::memory_order_acquire);
+        if (ch.latestSeq.load(std::memory_order_acquire) > after_seq) return true;
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        timespec left{deadline.tv_sec - now.tv_sec, deadline.tv_nsec - now.tv_nsec};
+        if (left.tv_nsec < 0) {
+            left.tv_sec--;
+            left.tv_nsec += 1000000000;
+        }
+        if (left.tv_sec < 0) return false;
+        syscall(SYS_futex, const_cast<uint32_t*>(reinterpret_cast<const uint32_t*>(&ch.futex)),
+                FUTEX_WAIT, word, &left, nullptr, 0);
+    }
+}
+
+bool FrameShareReader::latest(Channel channel, View& view) const {
+    if (!base || channel >= kChannelCount) return false;
+    const uint64_t seq = header()->channels[channel].latestSeq.load(std::memory_order_acquire);
+    return seq > 0 && at(channel, seq, view);
+}
+
+bool FrameShareReader::at(Channel channel, uint64_t seq, View& view) const {
+    if (!base || channel >= kChannelCount || seq == 0) return false;
+    const SlotRing& ring = rings[channel];
+    if (ring.slotCount == 0) return false;
+    const SlotHeader* slot = reinterpret_cast<const SlotHeader*>(slotAt(base, ring, seq));
+    if (slot->seq.load(std::memory_order_acquire) != (seq << 1)) return false;
+    if (slot->size > ring.slotSize - sizeof(SlotHeader) || slot->count > static_cast<uint32_t>(kMaxDetections)) {
+        return false;
+    }
+
+    view.channel = channel;
+    view.seq = seq;
+    view.pts = slot->pts;
+    view.timestampUs = slot->timestampUs;
+    view.format = slot->format;
+    view.width = slot->width;
+    view.height = slot->height;
+    view.stride = slot->stride;
+    view.size = slot->size;
+    view.count = slot->count;
+    view.data = reinterpret_cast<const uint8_t*>(slot) + sizeof(SlotHeader);
+    view.detections = channel == kDetections ? reinterpret_cast<const DetectionPayload*>(view.data) : nullptr;
+    // The header fields above must come from this frame too.
+    return stillValid(view);
+}
+
+bool FrameShareReader::stillValid(const View& view) const {
+    if (!base || view.seq == 0 || view.channel >= kChannelCount || rings[view.channel].slotCount == 0) return false;
+    const SlotHeader* slot = reinterpret_cast<const SlotHeader*>(slotAt(base, rings[view.channel], view.seq));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot->seq.load(std::memory_order_relaxed) == (view.seq << 1);
+}
@@ -0,0 +1,57 @@
+#include <memory>
+
+#include "head_decoder.hpp"
+
+namespace {
+
+const char* kCoco80[] = {
+    "person","bicycle","car","motorcycle","airplane","bus","train","truck","boat","traffic light",
+    "fire hydrant","stop sign","parking meter","bench","bird","cat","dog","horse","sheep","cow",
+    "elephant","bear","zebra","giraffe","backpack","umbrella","handbag","tie","suitcase","frisbee",
+    "skis","snowboard","sports ball","kite","baseball bat","baseball glove","skateboard","surfboard","tennis racket","bottle",
+    "wine glass","cup","fork","knife","spoon","bowl","banana","apple","sandwich","orange",
+    "broccoli","carrot","hot dog","pizza","donut","cake","chair","couch","potted plant","bed",
+    "dining table","toilet","tv","laptop","mouse","remote","keyboard","cell phone","microwave","oven",
+    "toaster","sink","refrigerator","book","clock","vase","scissors","teddy bear","hair drier","toothbrush"
+};
+
+template <template <int> class Decoder>
+std::unique_ptr<HeadDecoder> byStride(int stride) {
+    switch (stride) {
+        case 8: return std::unique_ptr<HeadDecoder>(new Decoder<8>());
+        case 16: return std::unique_ptr<HeadDecoder>(new Decoder<16>());
+        case 32: return std::unique_ptr<HeadDecoder>(new Decoder<32>());
+        default: return std::unique_ptr<HeadDecoder>(new Decoder<0>(stride));
+    }
+}
+
+template <int Stride> using NanoDetM = NanoDetGflDecoder<80, 7, Stride>;
+template <int Stride> using NanoDetAny = NanoDetGflDecoder<0, 0, Stride>;
+template <int Stride> using YoloCoco = PlanarLtrbDecoder<80, Stride>;
+template <int Stride> using PlanarAny = PlanarLtrbDecoder<0, Stride>;
+
+}
+
+const char* cocoLabel(int class_id) {
+    if (class_id < 0 || class_id >= 80) return "Target";
+    return kCoco80[class_id];
+}
+
+std::unique_ptr<HeadDecoder> makeHeadDecoder(const ncnn::Mat& out_cls,
+                                             const ncnn::Mat& out_reg,
+                                             int stride) {
+    if (out_cls.empty() || out_reg.empty() || stride <= 0) return nullptr;
+
+    // NanoDet-m (ncnn-assets): distribution regression, cls folded into w.
+    if (out_cls.c == 1 && out_reg.c == 1 && out_reg.w % 4 == 0 && out_reg.h == out_cls.h) {
+        if (out_cls.w == 80 && out_reg.w == 4 * 8) return byStride<NanoDetM>(stride);
+        if (out_reg.w / 4 > 16) return nullptr;
+        return byStride<NanoDetAny>(stride);
+    }
+
+    // Planar layout: one channel per class, four ltrb channels.
+    if (out_cls.w <= 0 || out_cls.h <= 0 || out_cls.c <= 0) return nullptr;
+    if (out_reg.c < 4 || out_reg.w != out_cls.w || out_reg.h != out_cls.h) return nullptr;
+    if (out_cls.c == 80) return byStride<YoloCoco>(stride);
+    return byStride<PlanarAny>(stride);
+}
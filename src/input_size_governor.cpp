@@ -0,0 +1,44 @@
+#include <algorithm>
+#include <cstdlib>
+
+#include "input_size_governor.hpp"
+
+void InputSizeGovernor::configure(const Config& config, int initial_size) {
+    cfg = config;
+    std::sort(cfg.steps.begin(), cfg.steps.end());
+    cfg.steps.erase(std::unique(cfg.steps.begin(), cfg.steps.end()), cfg.steps.end());
+    index = 0;
+    for (size_t i = 0; i < cfg.steps.size(); ++i) {
+        if (std::abs(cfg.steps[i] - initial_size) < std::abs(cfg.steps[index] - initial_size)) index = i;
+    }
+    latency_ema = 0.0f;
+    frames_since_switch = 0;
+    idle_frames = 0;
+}
+
+bool InputSizeGovernor::update(long long latency_ms, size_t detections, bool thermal_throttled) {
+    if (cfg.steps.size() < 2) return false;
+
+    latency_ema = latency_ema <= 0.0f ? static_cast<float>(latency_ms)
+                                      : 0.8f * latency_ema + 0.2f * static_cast<float>(latency_ms);
+    idle_frames = detections > 0 ? 0 : idle_frames + 1;
+    if (++frames_since_switch < cfg.holdFrames) return false;
+
+    const float budget = static_cast<float>(cfg.latencyBudgetMs);
+    size_t next = index;
+    if (index > 0 && (thermal_throttled || latency_ema > budget || idle_frames >= cfg.idleFrames)) {
+        next = index - 1;
+    } else if (index + 1 < cfg.steps.size() && !thermal_throttled && idle_frames == 0) {
+        // Inference cost scales with input area.
+        float ratio = static_cast<float>(cfg.steps[index + 1]) / cfg.steps[index];
+        if (latency_ema * ratio * ratio < budget * 0.9f) next = index + 1;
+    }
+    if (next == index) return false;
+
+    // Rescale the estimate so the next decision is not made on stale cost.
+    float ratio = static_cast<float>(cfg.steps[next]) / cfg.steps[index];
+    latency_ema *= ratio * ratio;
+    index = next;
+    frames_since_switch = 0;
+    return true;
+}
@@ -1,13 +1,114 @@
+#include <algorithm>
 #include <iostream>
+#include <memory>
 #include <thread>
+#include <vector>
 #include <chrono>
 #include <fstream>
 #include <cstdlib>
+#include <csignal>
+#include <glib-unix.h>
 #include <gst/gst.h>
+#include <sys/inotify.h>
+#include <unistd.h>
 
+#include "event_publisher.hpp"
+#include "event_recorder.hpp"
+#include "metadata_publisher.hpp"
+#include "ncnn_detector.hpp"
 #include "pipeline_manager.hpp"
 #include "rtsp_service.hpp"
 #include "runtime_config.hpp"
+#include "stage_profiler.hpp"
+#include "thread_topology.hpp"
+#ifdef NANOSTREAM_HAVE_WEBRTC
+#include "webrtc_service.hpp"
+#endif
+
+namespace {
+
+void reloadConfig(const char *why) {
+    std::string error;
+    if (!reloadRuntimeConfig(error)) {
+        std::cerr << "\n[Config] Reload rejected (" << error << "), keeping current settings" << std::endl;
+        return;
+    }
+    std::cout << "\n[Config] Reloaded on " << why << std::endl;
+    if (getRuntimeConfig().debug) std::cout << formatRuntimeConfig(getRuntimeConfig()) << std::endl;
+}
+
+// Loaded once for every camera; stream-branch failover never touches the AI branch.
+void loadDetectorModel(NCNNDetector& detector, const RuntimeConfig& runtime) {
+    if (runtime.useInt8) {
+        std::ifstream p(runtime.int8Param);
+        std::ifstream b(runtime.int8Bin);
+        if (!p.good() || !b.good()) {
+            std::cout << "[NanoStream] INT8 model files missing, falling back to FP32." << std::endl;
+            detector.loadModel("models/nanodet_m.param", "models/nanodet_m.bin");
+        } else if (!detector.loadModel(runtime.int8Param, runtime.int8Bin)) {
+            std::cout << "[NanoStream] INT8 model load failed, falling back to FP32." << std::endl;
+            detector.loadModel("models/nanodet_m.param", "models/nanodet_m.bin");
+        } else {
+            std::cout << "[NanoStream] INT8 model active." << std::endl;
+        }
+    } else {
+        detector.loadModel("models/nanodet_m.param", "models/nanodet_m.bin");
+    }
+}
+
+// Camera 0 keeps the plain mount names; further cameras are numbered.
+std::string mountPath(const std::string& base, size_t camera) {
+    return camera == 0 ? base : base + std::to_string(camera);
+}
+
+gboolean onPerfReport(gpointer user_data) {
+    const std::string &path = *static_cast<std::string*>(user_data);
+    if (!stage_profiler::writeReport(path)) {
+        std::cerr << "\n[Perf] Cannot write " << path << std::endl;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+gboolean onReloadSignal(gpointer) {
+    reloadConfig("SIGHUP");
+    return G_SOURCE_CONTINUE;
+}
+
+// The directory is watched rather than the file, so editors that save by
+// renaming a temp file over it are picked up too.
+gboolean onConfigDirEvent(gint fd, GIOCondition, gpointer user_data) {
+    const std::string &name = *static_cast<std::string*>(user_data);
+    alignas(inotify_event) char buf[4096];
+    bool changed = false;
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        for (char *p = buf; p < buf + n;) {
+            auto *ev = reinterpret_cast<inotify_event*>(p);
+            if (ev->len > 0 && name == ev->name) changed = true;
+            p += sizeof(inotify_event) + ev->len;
+        }
+    }
+    if (changed) reloadConfig("config file change");
+    return G_SOURCE_CONTINUE;
+}
+
+void watchConfigFile() {
+    const char *path = std::getenv("NANOSTREAM_CONFIG");
+    if (!path || !*path) return;
+    std::string file = path;
+    size_t slash = file.rfind('/');
+    std::string dir = slash == std::string::npos ? "." : (slash == 0 ? "/" : file.substr(0, slash));
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0 || inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        std::cerr << "[Config] Cannot watch " << dir << ", reload with SIGHUP only" << std::endl;
+        if (fd >= 0) close(fd);
+        return;
+    }
+    g_unix_fd_add(fd, G_IO_IN, onConfigDirEvent, new std::string(file.substr(slash + 1)));
+    std::cout << "[Config] Watching " << file << " for changes" << std::endl;
+}
+
+}
 
 int main(int argc, char *argv[]) {
     // 1. Initialize GStreamer
@@ -15,33 +116,205 @@ int main(int argc, char *argv[]) {
     std::cout << "[NanoStream] System starting..." << std::endl;
 
     // 2. Start RTSP Server (runs in background via GMainLoop context)
-    // It listens on 127.0.0.1:5004 for UDP packets from our pipeline
+    // It is fed encoded buffers in-process by the camera pipeline
     // Clients connect to rtsp://<PI_IP>:8554/live
     const RuntimeConfig& runtime = getRuntimeConfig();
     if (runtime.debug) {
         std::cout << "[NanoStream] Runtime config:\n" << formatRuntimeConfig(runtime) << std::endl;
     }
+    // Threads inherit placement from their creator, so pinning the main
+    // thread first puts the RTSP server, publishers and GStreamer's
+    // streaming threads on the stream cores; the AI worker re-pins itself.
+    thread_topology::pinCurrentThread(thread_topology::parseCpuList(runtime.cpuStream));
+    std::cout << "[Topology] main: " << thread_topology::describeCurrentThread() << std::endl;
+    // Before the pipeline exists, so every stage's first call is counted.
+    if (runtime.perfProfile) stage_profiler::enable();
+
+    const size_t camera_count = std::max<size_t>(1, runtime.cameras.size());
     RTSPServer rtspServer;
     std::string rtsp_host = resolveRtspHost(runtime);
-    rtspServer.start(8554, "/live", 5004, rtsp_host);
+    std::vector<int> live_mounts;
+    std::vector<int> sub_mounts;
+    for (size_t c = 0; c < camera_count; ++c) {
+        live_mounts.push_back(rtspServer.addMount(mountPath("/live", c)));
+        sub_mounts.push_back(runtime.subEnabled ? rtspServer.addMount(mountPath("/sub", c)) : -1);
+    }
+    if (runtime.netTestLoss > 0.0f) rtspServer.setTestPacketLoss(runtime.netTestLoss);
+    rtspServer.start(8554, rtsp_host);
+
+#ifdef NANOSTREAM_HAVE_WEBRTC
+    // WebRTC paths mirror the RTSP mounts and take the same access units.
+    WebRTCServer webrtc;
+    std::vector<int> webrtc_live(camera_count, -1);
+    std::vector<int> webrtc_sub(camera_count, -1);
+    if (runtime.webrtcEnabled) {
+        for (size_t c = 0; c < camera_count; ++c) {
+            webrtc_live[c] = webrtc.addPath(mountPath("live", c));
+            if (runtime.subEnabled) webrtc_sub[c] = webrtc.addPath(mountPath("sub", c));
+        }
+    }
+#else
+    if (runtime.webrtcEnabled) {
+        std::cerr << "[WebRTC] Not built in (gstreamer-webrtc-1.0 was not found at configure time)" << std::endl;
+    }
+#endif
     
-    // 3. Initialize and Start Pipeline
-    PipelineManager pipeline;
-    if (!pipeline.buildPipeline()) {
-        std::cerr << "[Fatal] Pipeline build failed. Exiting." << std::endl;
-        return -1;
+    // 3. Initialize and Start Pipelines
+    // Clips are cut from each camera's main stream. Recorders and the
+    // metadata and event publishers are declared before the pipelines and
+    // detector so they outlive the listeners that feed them.
+    std::vector<std::unique_ptr<EventRecorder>> recorders;
+    for (size_t c = 0; c < camera_count; ++c) {
+        recorders.emplace_back(new EventRecorder);
+        if (!runtime.recEnabled) continue;
+        EventRecorder::Config rec_cfg;
+        rec_cfg.directory = camera_count > 1 ? runtime.recDir + "/cam" + std::to_string(c) : runtime.recDir;
+        rec_cfg.format = runtime.recFormat;
+        rec_cfg.preRollSec = runtime.recPreRollSec;
+        rec_cfg.postRollSec = runtime.recPostRollSec;
+        rec_cfg.maxClipSec = runtime.recMaxClipSec;
+        rec_cfg.ringBytes = runtime.recRingKb * 1024;
+        recorders.back()->start(rec_cfg);
     }
 
-    pipeline.start();
-    std::cout << "[NanoStream] Pipeline is RUNNING." << std::endl;
+    MetadataPublisher metadata;
+    bool metadata_active = false;
+    if (runtime.metaEnabled) {
+        MetadataPublisher::Config meta_cfg;
+        meta_cfg.udpHost = runtime.metaUdpHost;
+        meta_cfg.udpPort = runtime.metaUdpPort;
+        meta_cfg.httpPort = runtime.metaHttpPort;
+        metadata_active = metadata.start(meta_cfg);
+    }
+
+    // Track events: one tracker per camera, one shared publisher queue.
+    EventPublisher events;
+    std::vector<std::unique_ptr<TrackEventTracker>> trackers;
+    bool events_active = false;
+    if (runtime.eventsEnabled) {
+        EventPublisher::Config ev_cfg;
+        char host[64] = "";
+        gethostname(host, sizeof(host) - 1);
+        ev_cfg.url = runtime.eventsUrl;
+        ev_cfg.clientId = std::string("nanostream-") + host;
+        ev_cfg.queueCapacity = static_cast<size_t>(runtime.eventsQueue);
+        ev_cfg.batchMs = runtime.eventsBatchMs;
+        ev_cfg.drop = runtime.eventsDrop == "newest" ? EventPublisher::DropPolicy::Newest
+                                                     : EventPublisher::DropPolicy::Oldest;
+        events_active = events.start(ev_cfg);
+        TrackEventTracker::Config track_cfg;
+        parseEventZones(runtime.eventsZones, track_cfg.zones);
+        track_cfg.minHits = runtime.eventsMinHits;
+        track_cfg.exitMs = runtime.eventsExitMs;
+        for (size_t c = 0; c < camera_count; ++c) {
+            trackers.emplace_back(new TrackEventTracker);
+            trackers.back()->configure(track_cfg);
+        }
+    }
+
+    // One detector serves every camera. Declared after the pipelines so
+    // it is destroyed first: its worker calls into their listeners.
+    std::vector<std::unique_ptr<PipelineManager>> pipelines;
+    NCNNDetector detector(static_cast<int>(camera_count));
+    loadDetectorModel(detector, runtime);
+
+    using Profile = PipelineManager::StreamProfile;
+    for (size_t c = 0; c < camera_count; ++c) {
+        const std::string camera_name = c < runtime.cameras.size() ? runtime.cameras[c] : "";
+        pipelines.emplace_back(new PipelineManager(detector.channel(c), static_cast<int>(c), camera_name));
+        PipelineManager& pipeline = *pipelines.back();
+        EventRecorder& recorder = *recorders[c];
+        const int live_mount = live_mounts[c];
+        const int sub_mount = sub_mounts[c];
+#ifdef NANOSTREAM_HAVE_WEBRTC
+        const int live_path = webrtc_live[c];
+        const int sub_path = webrtc_sub[c];
+
+        pipeline.setEncodedListener(Profile::Main, [&rtspServer, &webrtc, &recorder, live_mount, live_path](GstBuffer *buffer) {
+            rtspServer.pushBuffer(live_mount, buffer);
+            webrtc.pushBuffer(live_path, buffer);
+            recorder.pushAccessUnit(buffer);
+        });
+        webrtc.setKeyframeRequest(live_path, [&pipeline]() { pipeline.requestKeyframe(Profile::Main); });
+#else
+        pipeline.setEncodedListener(Profile::Main, [&rtspServer, &recorder, live_mount](GstBuffer *buffer) {
+            rtspServer.pushBuffer(live_mount, buffer);
+            recorder.pushAccessUnit(buffer);
+        });
+#endif
+        rtspServer.setKeyframeRequest(live_mount, [&pipeline]() { pipeline.requestKeyframe(Profile::Main); });
+        if (runtime.netAdaptive) {
+            rtspServer.setReceiverStatsListener(live_mount, [&pipeline](const RTSPServer::ReceiverStats& stats) {
+                pipeline.reportNetworkFeedback(stats.receivers, stats.fractionLost, stats.jitterMs);
+            });
+        }
+        if (sub_mount >= 0) {
+#ifdef NANOSTREAM_HAVE_WEBRTC
+            pipeline.setEncodedListener(Profile::Sub, [&rtspServer, &webrtc, sub_mount, sub_path](GstBuffer *buffer) {
+                rtspServer.pushBuffer(sub_mount, buffer);
+                webrtc.pushBuffer(sub_path, buffer);
+            });
+            webrtc.setKeyframeRequest(sub_path, [&pipeline]() { pipeline.requestKeyframe(Profile::Sub); });
+#else
+            pipeline.setEncodedListener(Profile::Sub, [&rtspServer, sub_mount](GstBuffer *buffer) {
+                rtspServer.pushBuffer(sub_mount, buffer);
+            });
+#endif
+            rtspServer.setKeyframeRequest(sub_mount, [&pipeline]() { pipeline.requestKeyframe(Profile::Sub); });
+        }
+
+        if (metadata_active) {
+            pipeline.addDetectionListener([&metadata](const DetectionFrame& frame) {
+                metadata.publish(frame);
+            });
+        }
+        if (events_active) {
+            TrackEventTracker& tracker = *trackers[c];
+            pipeline.addDetectionListener([&events, &tracker, batch = std::vector<TrackEvent>()](
+                                              const DetectionFrame& frame) mutable {
+                batch.clear();
+                tracker.update(frame, batch);
+                events.publish(batch);
+            });
+        }
+        if (runtime.recEnabled) {
+            const std::string labels = "," + runtime.recLabels + ",";
+            pipeline.addDetectionListener([&recorder, &runtime, labels](const DetectionFrame& frame) {
+                for (const auto& det : frame.detections) {
+                    if (det.score < runtime.recMinScore) continue;
+                    if (!runtime.recLabels.empty() && labels.find("," + det.label + ",") == std::string::npos) continue;
+                    recorder.trigger(det.label);
+                    return;
+                }
+            });
+        }
+        if (!pipeline.buildPipeline()) {
+            std::cerr << "[Fatal] Pipeline build failed for camera " << c << ". Exiting." << std::endl;
+            return -1;
+        }
+    }
+
+    bool webrtc_active = false;
+#ifdef NANOSTREAM_HAVE_WEBRTC
+    if (runtime.webrtcEnabled) {
+        WebRTCServer::Config webrtc_cfg;
+        webrtc_cfg.port = runtime.webrtcPort;
+        webrtc_cfg.bind = runtime.webrtcBind;
+        webrtc_cfg.maxSessions = runtime.webrtcMaxSessions;
+        webrtc_cfg.stunServer = runtime.webrtcStun;
+        webrtc_active = webrtc.start(webrtc_cfg);
+    }
+#endif
+    for (auto& pipeline : pipelines) pipeline->start();
+    std::cout << "[NanoStream] " << camera_count << (camera_count > 1 ? " pipelines are" : " pipeline is")
+              << " RUNNING." << std::endl;
     std::cout << "--------------------------------------------------------" << std::endl;
 
     if (runtime.thermalEnabled) {
-        std::thread([&pipeline]() {
-            const RuntimeConfig& cfg = getRuntimeConfig();
-
+        std::thread([&pipelines]() {
             int last_mode = -1;
             while (true) {
+                const RuntimeConfig& cfg = getRuntimeConfig();
                 std::ifstream temp_file("/sys/class/thermal/thermal_zone0/temp");
                 int temp_milli = 0;
                 if (temp_file.good()) {
@@ -63,23 +336,48 @@ int main(int argc, char *argv[]) {
                     last_mode = mode;
                 }
 
-                pipeline.setAIThrottle(sleep_ms, paused);
+                for (auto& pipeline : pipelines) pipeline->setAIThrottle(sleep_ms, paused);
                 std::this_thread::sleep_for(std::chrono::seconds(5));
             }
         }).detach();
     }
-    std::cout << ">> RTSP URL: rtsp://" << rtsp_host << ":8554/live" << std::endl;
+    for (size_t c = 0; c < camera_count; ++c) {
+        const std::string label = camera_count > 1 ? " (camera " + std::to_string(c) + ")" : "";
+        std::cout << ">> RTSP URL: rtsp://" << rtsp_host << ":8554" << mountPath("/live", c) << label << std::endl;
+        if (sub_mounts[c] >= 0) {
+            std::cout << ">> RTSP Sub: rtsp://" << rtsp_host << ":8554" << mountPath("/sub", c) << label << std::endl;
+        }
+        if (webrtc_active) {
+            const std::string host = runtime.webrtcBind == "0.0.0.0" ? rtsp_host : runtime.webrtcBind;
+            std::cout << ">> WebRTC:   http://" << host << ":" << runtime.webrtcPort << mountPath("/live", c)
+                      << "/whep" << label << std::endl;
+        }
+    }
     std::cout << ">> IMPORTANT: Ensure Pi's firewall is disabled (sudo ufw disable)" << std::endl;
     std::cout << ">> AI Inference: Running asynchronously on NCNN" << std::endl;
     std::cout << "--------------------------------------------------------" << std::endl;
 
     // 4. Main Event Loop
     // GStreamer relies on a GMainLoop to handle bus messages and RTSP server events
+    // Detector thresholds and filters can be retuned without a restart:
+    // edit the NANOSTREAM_CONFIG file or send SIGHUP.
+    g_unix_signal_add(SIGHUP, onReloadSignal, nullptr);
+    watchConfigFile();
+    if (runtime.perfProfile) {
+        g_timeout_add_seconds(static_cast<guint>(runtime.perfIntervalSec), onPerfReport,
+                              new std::string(runtime.perfReport));
+        std::cout << "[Perf] Stage counters -> " << runtime.perfReport
+                  << " every " << runtime.perfIntervalSec << "s" << std::endl;
+    }
+
     GMainLoop *loop = g_main_loop_new(NULL, FALSE);
     g_main_loop_run(loop);
 
     // Cleanup (This part is rarely reached in embedded loops unless signal handling is added)
-    pipeline.stop();
+#ifdef NANOSTREAM_HAVE_WEBRTC
+    webrtc.stop();
+#endif
+    for (auto& pipeline : pipelines) pipeline->stop();
     g_main_loop_unref(loop);
 
     return 0;
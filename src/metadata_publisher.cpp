@@ -0,0 +1,245 @@
+#include <iostream>
+#include <sstream>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "metadata_publisher.hpp"
+
+namespace {
+
+void setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags >= 0) fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+void appendEscaped(std::ostringstream& out, const std::string& s) {
+    for (char c : s) {
+        if (c == '"' || c == '\\') out << '\\';
+        if (static_cast<unsigned char>(c) < 0x20) continue;
+        out << c;
+    }
+}
+
+bool sendAll(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+const char kSseHeader[] =
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Type: text/event-stream\r\n"
+    "Cache-Control: no-cache\r\n"
+    "Connection: keep-alive\r\n"
+    "Access-Control-Allow-Origin: *\r\n\r\n";
+
+const char kNotFound[] =
+    "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+
+// A connection that has not sent its request by then is dropped.
+constexpr std::chrono::milliseconds kHandshakeTimeout(2000);
+
+}
+
+MetadataPublisher::MetadataPublisher() {}
+
+MetadataPublisher::~MetadataPublisher() {
+    stop();
+}
+
+std::string MetadataPublisher::toJson(const DetectionFrame& frame) {
+    std::ostringstream out;
+    out << "{\"seq\":" << frame.seq
+        << ",\"cam\":" << frame.camera
+        << ",\"pts\":";
+    if (frame.pts == DetectionFrame::kNoPts) out << "null";
+    else out << frame.pts;
+    out << ",\"ts_us\":" << frame.timestampUs
+        << ",\"w\":" << frame.frameWidth
+        << ",\"h\":" << frame.frameHeight
+        << ",\"dets\":[";
+    for (size_t i = 0; i < frame.detections.size(); ++i) {
+        const auto& d = frame.detections[i];
+        if (i > 0) out << ",";
+        out << "[" << d.x << "," << d.y << "," << d.w << "," << d.h << ","
+            << d.class_id << "," << static_cast<int>(d.score * 1000.0f + 0.5f) << ",\"";
+        appendEscaped(out, d.label);
+        out << "\"]";
+    }
+    out << "]}";
+    return out.str();
+}
+
+bool MetadataPublisher::start(const Config& cfg) {
+    if (running) return true;
+    config = cfg;
+
+    if (config.udpPort > 0) {
+        udp_fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (udp_fd >= 0) {
+            setNonBlocking(udp_fd);
+            sockaddr_in dst{};
+            dst.sin_family = AF_INET;
+            dst.sin_port = htons(static_cast<uint16_t>(config.udpPort));
+            if (inet_pton(AF_INET, config.udpHost.c_str(), &dst.sin_addr) != 1 ||
+                connect(udp_fd, reinterpret_cast<sockaddr*>(&dst), sizeof(dst)) != 0) {
+                std::cerr << "[Meta] Invalid UDP target " << config.udpHost << ":" << config.udpPort << std::endl;
+                close(udp_fd);
+                udp_fd = -1;
+            }
+        }
+    }
+
+    if (config.httpPort > 0) {
+        listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(static_cast<uint16_t>(config.httpPort));
+        if (listen_fd < 0 || bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            listen(listen_fd, 8) != 0) {
+            std::cerr << "[Meta] Cannot listen on port " << config.httpPort << ": " << std::strerror(errno) << std::endl;
+            if (listen_fd >= 0) close(listen_fd);
+            listen_fd = -1;
+        } else {
+            setNonBlocking(listen_fd);
+        }
+    }
+
+    if (udp_fd < 0 && listen_fd < 0) return false;
+    if (pipe(wake_pipe) != 0) return false;
+    setNonBlocking(wake_pipe[0]);
+    setNonBlocking(wake_pipe[1]);
+
+    running = true;
+    sender_thread = std::thread(&MetadataPublisher::senderLoop, this);
+    if (udp_fd >= 0) {
+        std::cout << "[Meta] Detections -> udp://" << config.udpHost << ":" << config.udpPort << std::endl;
+    }
+    if (listen_fd >= 0) {
+        std::cout << "[Meta] Detections -> http://<device-ip>:" << config.httpPort << "/detections (SSE)" << std::endl;
+    }
+    return true;
+}
+
+void MetadataPublisher::stop() {
+    if (!running.exchange(false)) return;
+    char c = 0;
+    if (write(wake_pipe[1], &c, 1) < 0) {}
+    if (sender_thread.joinable()) sender_thread.join();
+    for (int fd : clients) close(fd);
+    clients.clear();
+    for (const auto& h : handshakes) close(h.fd);
+    handshakes.clear();
+    for (int* fd : {&udp_fd, &listen_fd, &wake_pipe[0], &wake_pipe[1]}) {
+        if (*fd >= 0) close(*fd);
+        *fd = -1;
+    }
+}
+
+void MetadataPublisher::publish(const DetectionFrame& frame) {
+    if (!running) return;
+    std::string json = toJson(frame);
+    {
+        std::lock_guard<std::mutex> lock(slot_mutex);
+        pending.swap(json);
+        has_pending = true;
+    }
+    char c = 0;
+    if (write(wake_pipe[1], &c, 1) < 0) {}
+}
+
+void MetadataPublisher::acceptClients() {
+    while (true) {
+        int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) return;
+        setNonBlocking(fd);
+        handshakes.push_back({fd, std::chrono::steady_clock::now() + kHandshakeTimeout});
+    }
+}
+
+void MetadataPublisher::readRequest(size_t index) {
+    int fd = handshakes[index].fd;
+    handshakes[index] = handshakes.back();
+    handshakes.pop_back();
+    // Requests are tiny; read what is there and route on the path only.
+    char req[1024];
+    ssize_t n = recv(fd, req, sizeof(req) - 1, 0);
+    if (n <= 0) { close(fd); return; }
+    req[n] = '\0';
+    if (std::strncmp(req, "GET /detections", 15) != 0) {
+        sendAll(fd, kNotFound, sizeof(kNotFound) - 1);
+        close(fd);
+        return;
+    }
+    if (!sendAll(fd, kSseHeader, sizeof(kSseHeader) - 1)) { close(fd); return; }
+    clients.push_back(fd);
+}
+
+void MetadataPublisher::broadcast(const std::string& json) {
+    if (udp_fd >= 0) {
+        send(udp_fd, json.data(), json.size(), MSG_DONTWAIT);
+    }
+    if (clients.empty()) return;
+    std::string event = "data: " + json + "\n\n";
+    for (size_t i = 0; i < clients.size();) {
+        ssize_t n = send(clients[i], event.data(), event.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+        // A client that can't take a whole event is too slow; drop it rather
+        // than buffer unboundedly or tear a message.
+        if (n != static_cast<ssize_t>(event.size())) {
+            close(clients[i]);
+            clients[i] = clients.back();
+            clients.pop_back();
+            continue;
+        }
+        ++i;
+    }
+}
+
+void MetadataPublisher::senderLoop() {
+    std::string json;
+    while (running) {
+        std::vector<pollfd> fds;
+        fds.push_back({wake_pipe[0], POLLIN, 0});
+        if (listen_fd >= 0) fds.push_back({listen_fd, POLLIN, 0});
+        const size_t first_handshake = fds.size();
+        for (const auto& h : handshakes) fds.push_back({h.fd, POLLIN, 0});
+        int timeout_ms = handshakes.empty() ? 1000 : 200;
+        if (poll(fds.data(), fds.size(), timeout_ms) < 0 && errno != EINTR) break;
+
+        char drain[64];
+        while (read(wake_pipe[0], drain, sizeof(drain)) > 0) {}
+        // Walk backwards: readRequest moves the last handshake into the slot.
+        const auto now = std::chrono::steady_clock::now();
+        for (size_t i = handshakes.size(); i-- > 0;) {
+            if (fds[first_handshake + i].revents) {
+                readRequest(i);
+            } else if (now >= handshakes[i].deadline) {
+                close(handshakes[i].fd);
+                handshakes[i] = handshakes.back();
+                handshakes.pop_back();
+            }
+        }
+        if (listen_fd >= 0 && (fds[1].revents & POLLIN)) acceptClients();
+
+        {
+            std::lock_guard<std::mutex> lock(slot_mutex);
+            if (!has_pending) continue;
+            json.swap(pending);
+            has_pending = false;
+        }
+        broadcast(json);
+    }
+}
@@ -6,12 +6,58 @@
 #include <cmath>
 #include <sstream>
 
+#include <cpu.h>
+
 #include "ncnn_detector.hpp"
 #include "runtime_config.hpp"
+#include "stage_profiler.hpp"
+#include "thread_topology.hpp"
+
+namespace {
+
+const int kStagePreprocess = stage_profiler::stage("preprocess");
+const int kStageDecode = stage_profiler::stage("decode");
+const int kStageNms = stage_profiler::stage("nms");
+const int kStageSmooth = stage_profiler::stage("smooth");
 
-NCNNDetector::NCNNDetector() {
+// A channel of a shared detector behind the plain ObjectDetector interface.
+class ChannelView final : public ObjectDetector {
+public:
+    ChannelView(NCNNDetector& owner, size_t index) : owner(owner), index(index) {}
+
+    bool loadModel(const std::string &paramPath, const std::string &binPath) override {
+        return owner.loadModel(paramPath, binPath);
+    }
+    void pushFrame(VideoFrameRef frame) override { owner.pushFrame(index, std::move(frame)); }
+    std::vector<Detection> getDetections() override {
+        std::vector<Detection> out;
+        owner.getDetections(index, out);
+        return out;
+    }
+    void getDetections(std::vector<Detection>& out) override { owner.getDetections(index, out); }
+    void setThrottle(int sleep_ms, bool paused) override { owner.setThrottle(sleep_ms, paused); }
+    void addResultListener(ResultListener listener) override { owner.addResultListener(index, std::move(listener)); }
+    int lastLatencyMs() const override { return owner.lastLatencyMs(); }
+
+private:
+    NCNNDetector& owner;
+    size_t index;
+};
+
+int64_t nowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+NCNNDetector::NCNNDetector(int channel_count) {
     net.opt.num_threads = 4;
     net.opt.use_packing_layout = false; // safer for these heads
+    for (int i = 0; i < std::max(1, channel_count); ++i) {
+        channels.emplace_back(new Channel);
+        if (i > 0) channels.back()->view.reset(new ChannelView(*this, i));
+    }
     worker_thread = std::thread(&NCNNDetector::workerLoop, this);
 }
 
@@ -24,32 +70,52 @@ NCNNDetector::~NCNNDetector() {
 
 bool NCNNDetector::loadModel(const std::string &paramPath, const std::string &binPath) {
     if (net.load_param(paramPath.c_str()) == 0 && net.load_model(binPath.c_str()) == 0) {
+        decoders_dirty.store(true);
         std::cout << "[AI] Precision Engine Ready." << std::endl;
         return true;
     }
     return false;
 }
 
-void NCNNDetector::pushFrame(const unsigned char *rgb_data, int width, int height) {
-    std::unique_lock<std::mutex> lock(frame_mutex, std::try_to_lock);
-    if (!lock.owns_lock()) return;
-
-    if (!rgb_data || width <= 0 || height <= 0) return;
+ObjectDetector& NCNNDetector::channel(size_t index) {
+    if (index == 0) return *this;
+    return *channels.at(index)->view;
+}
 
-    size_t size = static_cast<size_t>(width) * static_cast<size_t>(height) * 3;
-    if (size == 0) return;
-    if (pending_frame.size() != size) pending_frame.resize(size);
-    memcpy(pending_frame.data(), rgb_data, size);
-    
-    img_w = width;
-    img_h = height;
-    has_new_frame = true;
+void NCNNDetector::pushFrame(size_t channel, VideoFrameRef frame) {
+    if (channel >= channels.size()) return;
+    if (!frame.data || frame.width <= 0 || frame.height <= 0 || frame.stride < frame.width * 3) return;
+
+    // No copy: the frame's owner keeps the pixels alive until the worker
+    // is done, and a frame never picked up is released here, outside the
+    // lock. frame_mutex only ever guards slot swaps, so blocking on it is
+    // short and a camera never loses a frame to another one's push.
+    VideoFrameRef replaced;
+    {
+        std::lock_guard<std::mutex> lock(frame_mutex);
+        Channel& ch = *channels[channel];
+        if (!ch.has_frame) ch.waiting_since_us = nowUs();
+        replaced = std::move(ch.pending);
+        ch.pending = std::move(frame);
+        ch.has_frame = true;
+    }
     frame_cv.notify_one();
 }
 
 std::vector<Detection> NCNNDetector::getDetections() {
-    std::lock_guard<std::mutex> lock(result_mutex);
-    return current_detections;
+    std::vector<Detection> out;
+    getDetections(0, out);
+    return out;
+}
+
+void NCNNDetector::getDetections(std::vector<Detection>& out) {
+    getDetections(0, out);
+}
+
+void NCNNDetector::getDetections(size_t channel, std::vector<Detection>& out) {
+    Channel& ch = *channels.at(channel);
+    std::lock_guard<std::mutex> lock(ch.result_mutex);
+    out = ch.current;
 }
 
 void NCNNDetector::setThrottle(int sleep_ms, bool is_paused) {
@@ -57,23 +123,84 @@ void NCNNDetector::setThrottle(int sleep_ms, bool is_paused) {
     paused.store(is_paused);
 }
 
-bool NCNNDetector::waitForFrame(std::vector<unsigned char>& frame, int& w, int& h) {
+void NCNNDetector::addResultListener(size_t channel, ResultListener listener) {
+    Channel& ch = *channels.at(channel);
+    std::lock_guard<std::mutex> lock(ch.listener_mutex);
+    ch.listeners.push_back(std::move(listener));
+}
+
+void NCNNDetector::notifyListeners(Channel& ch, size_t channel, const std::vector<Detection>& dets, uint64_t pts) {
+    // Listeners run unlocked so one that publishes or blocks cannot stall
+    // addResultListener; the list only grows, so a copy is enough.
+    std::vector<ResultListener> listeners;
+    {
+        std::lock_guard<std::mutex> lock(ch.listener_mutex);
+        if (ch.listeners.empty()) return;
+        listeners = ch.listeners;
+    }
+    DetectionFrame frame;
+    frame.seq = ch.seq;
+    frame.pts = pts;
+    frame.timestampUs = nowUs();
+    frame.frameWidth = config.frameWidth;
+    frame.frameHeight = config.frameHeight;
+    frame.camera = static_cast<int>(channel);
+    frame.detections = dets;
+    for (const auto& listener : listeners) listener(frame);
+}
+
+// Takes up to batch_limit waiting frames, one per channel. Round-robin
+// starts after the channel served last; the deadline order serves the
+// channel that has been waiting longest first, which is earliest-deadline
+// when every camera runs at the same frame rate.
+bool NCNNDetector::waitForFrames(std::vector<Job>& jobs) {
     std::unique_lock<std::mutex> lock(frame_mutex);
-    frame_cv.wait(lock, [this]{ return has_new_frame || !running; });
+    auto any_waiting = [this]() {
+        for (const auto& ch : channels) {
+            if (ch->has_frame) return true;
+        }
+        return false;
+    };
+    frame_cv.wait(lock, [&]{ return any_waiting() || !running; });
     if (!running) return false;
-    frame = std::move(pending_frame);
-    w = img_w;
-    h = img_h;
-    has_new_frame = false;
+
+    const size_t n = channels.size();
+    std::vector<size_t> order;
+    for (size_t i = 0; i < n; ++i) {
+        size_t c = (next_channel + i) % n;
+        if (channels[c]->has_frame) order.push_back(c);
+    }
+    if (schedule_deadline) {
+        std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+            return channels[a]->waiting_since_us < channels[b]->waiting_since_us;
+        });
+    }
+    if (order.size() > batch_limit) order.resize(batch_limit);
+
+    jobs.clear();
+    for (size_t c : order) {
+        Channel& ch = *channels[c];
+        jobs.push_back({c, std::move(ch.pending)});
+        ch.pending = VideoFrameRef();
+        ch.has_frame = false;
+    }
+    next_channel = (order.back() + 1) % n;
     return true;
 }
 
-bool NCNNDetector::prepareInput(const std::vector<unsigned char>& frame, int w, int h, ncnn::Mat& in) {
-    if (w <= 0 || h <= 0) return false;
-    const size_t expected_size = static_cast<size_t>(w) * static_cast<size_t>(h) * 3;
-    if (frame.size() < expected_size) return false;
-
-    in = ncnn::Mat::from_pixels(frame.data(), ncnn::Mat::PIXEL_BGR, w, h);
+bool NCNNDetector::prepareInput(const VideoFrameRef& frame, int target_w, int target_h, ncnn::Mat& in) {
+    stage_profiler::Scope scope(kStagePreprocess);
+    const int w = frame.width;
+    const int h = frame.height;
+    if (!frame.data || w <= 0 || h <= 0) return false;
+
+    // Rows are read in place at the frame's own stride; padded rows never
+    // need repacking first.
+    if (w == target_w && h == target_h) {
+        in = ncnn::Mat::from_pixels(frame.data, ncnn::Mat::PIXEL_BGR, w, h, frame.stride);
+    } else {
+        in = ncnn::Mat::from_pixels_resize(frame.data, ncnn::Mat::PIXEL_BGR, w, h, frame.stride, target_w, target_h);
+    }
     const float mean_vals[3] = {103.53f, 116.28f, 123.675f};
     const float norm_vals[3] = {0.017429f, 0.017507f, 0.017125f};
     in.substract_mean_normalize(mean_vals, norm_vals);
@@ -81,9 +208,11 @@ bool NCNNDetector::prepareInput(const std::vector<unsigned char>& frame, int w,
 }
 
 void NCNNDetector::clearResults() {
-    std::lock_guard<std::mutex> lock(result_mutex);
-    current_detections.clear();
-    prev_detections.clear();
+    for (auto& ch : channels) {
+        std::lock_guard<std::mutex> lock(ch->result_mutex);
+        ch->current.clear();
+        ch->prev.clear();
+    }
 }
 
 std::string NCNNDetector::formatDetectorConfig() const {
@@ -103,7 +232,16 @@ std::string NCNNDetector::formatDetectorConfig() const {
         << " det_max_det=" << config.maxDetections
         << " det_topk=" << config.topK
         << " det_iou=" << config.iouThreshold
-        << " det_ema=" << config.emaAlpha;
+        << " det_ema=" << config.emaAlpha
+        << " det_cascade=" << (config.cascade ? "1" : "0")
+        << " det_cascade_input=" << config.cascadeInputSize
+        << " det_cascade_roi_input=" << config.cascadeRoiInputSize
+        << " det_cascade_max_rois=" << config.cascadeMaxRois
+        << " det_cascade_proposal_score=" << config.cascadeProposalScore
+        << " det_cascade_refine_area=" << config.cascadeRefineAreaThreshold
+        << " det_channels=" << channels.size()
+        << " det_batch=" << batch_limit
+        << " det_schedule=" << (schedule_deadline ? "deadline" : "rr");
 
     out << " det_heads=";
     for (size_t i = 0; i < config.heads.size(); ++i) {
@@ -114,77 +252,259 @@ std::string NCNNDetector::formatDetectorConfig() const {
     return out.str();
 }
 
-void NCNNDetector::applyRuntimeOverrides(const RuntimeConfig& runtime) {
-    if (runtime.detInputWidth > 0) config.inputWidth = runtime.detInputWidth;
-    if (runtime.detInputHeight > 0) config.inputHeight = runtime.detInputHeight;
-    if (runtime.detTopK > 0) config.topK = runtime.detTopK;
-    if (runtime.detMaxDetections > 0) config.maxDetections = runtime.detMaxDetections;
-    if (runtime.detMinBoxArea > 0) config.minBoxArea = runtime.detMinBoxArea;
-    if (runtime.detBaseScore > 0.0f) config.baseScore = runtime.detBaseScore;
-    if (runtime.detMinScoreSmallArea > 0.0f) config.minScoreSmallArea = runtime.detMinScoreSmallArea;
-    if (runtime.detMinScoreMediumArea > 0.0f) config.minScoreMediumArea = runtime.detMinScoreMediumArea;
+// Folds a runtime snapshot over the built-in defaults, so a reload that
+// clears an override really reverts it. Runs once per snapshot.
+void NCNNDetector::compileConfig(const RuntimeConfig& runtime) {
+    DetectorConfig next;
+    next.frameWidth = config.frameWidth;
+    next.frameHeight = config.frameHeight;
+    if (runtime.detInputWidth > 0) next.inputWidth = runtime.detInputWidth;
+    if (runtime.detInputHeight > 0) next.inputHeight = runtime.detInputHeight;
+    if (runtime.detTopK > 0) next.topK = runtime.detTopK;
+    if (runtime.detMaxDetections > 0) next.maxDetections = runtime.detMaxDetections;
+    if (runtime.detMinBoxArea > 0) next.minBoxArea = runtime.detMinBoxArea;
+    if (runtime.detBaseScore > 0.0f) next.baseScore = runtime.detBaseScore;
+    if (runtime.detMinScoreSmallArea > 0.0f) next.minScoreSmallArea = runtime.detMinScoreSmallArea;
+    if (runtime.detMinScoreMediumArea > 0.0f) next.minScoreMediumArea = runtime.detMinScoreMediumArea;
     if (runtime.detMinScoreSmallAreaThreshold > 0.0f) {
-        config.minScoreSmallAreaThreshold = runtime.detMinScoreSmallAreaThreshold;
+        next.minScoreSmallAreaThreshold = runtime.detMinScoreSmallAreaThreshold;
     }
     if (runtime.detMinScoreMediumAreaThreshold > 0.0f) {
-        config.minScoreMediumAreaThreshold = runtime.detMinScoreMediumAreaThreshold;
+        next.minScoreMediumAreaThreshold = runtime.detMinScoreMediumAreaThreshold;
     }
     if (runtime.detCapSmallAreaThreshold > 0.0f) {
-        config.capSmallAreaThreshold = runtime.detCapSmallAreaThreshold;
+        next.capSmallAreaThreshold = runtime.detCapSmallAreaThreshold;
     }
     if (runtime.detCapMediumAreaThreshold > 0.0f) {
-        config.capMediumAreaThreshold = runtime.detCapMediumAreaThreshold;
+        next.capMediumAreaThreshold = runtime.detCapMediumAreaThreshold;
     }
-    if (runtime.detIouThreshold > 0.0f) config.iouThreshold = runtime.detIouThreshold;
-    if (runtime.detEmaAlpha > 0.0f) config.emaAlpha = runtime.detEmaAlpha;
+    if (runtime.detIouThreshold > 0.0f) next.iouThreshold = runtime.detIouThreshold;
+    if (runtime.detEmaAlpha > 0.0f) next.emaAlpha = runtime.detEmaAlpha;
+    if (runtime.detCascade) next.cascade = true;
+    if (runtime.detCascadeInput > 0) next.cascadeInputSize = runtime.detCascadeInput;
+    if (runtime.detCascadeRoiInput > 0) next.cascadeRoiInputSize = runtime.detCascadeRoiInput;
+    if (runtime.detCascadeMaxRois > 0) next.cascadeMaxRois = runtime.detCascadeMaxRois;
+    if (runtime.detCascadeProposalScore > 0.0f) next.cascadeProposalScore = runtime.detCascadeProposalScore;
+    if (runtime.detCascadeRefineArea > 0.0f) next.cascadeRefineAreaThreshold = runtime.detCascadeRefineArea;
 
     if (!runtime.detHeads.empty()) {
-        std::vector<DetectorConfig::Head> parsed;
-        size_t start = 0;
-        while (start < runtime.detHeads.size()) {
-            size_t end = runtime.detHeads.find(',', start);
-            std::string token = runtime.detHeads.substr(start, end - start);
-            size_t p1 = token.find(':');
-            size_t p2 = token.find(':', p1 == std::string::npos ? p1 : p1 + 1);
-            if (p1 != std::string::npos && p2 != std::string::npos) {
-                DetectorConfig::Head h;
-                h.cls = token.substr(0, p1);
-                h.reg = token.substr(p1 + 1, p2 - p1 - 1);
-                h.stride = std::atoi(token.substr(p2 + 1).c_str());
-                if (!h.cls.empty() && !h.reg.empty() && h.stride > 0) {
-                    parsed.push_back(h);
-                }
-            }
-            if (end == std::string::npos) break;
-            start = end + 1;
+        std::vector<DetectorConfig::Head> parsed = parseDetectorHeads(runtime.detHeads);
+        if (!parsed.empty()) next.heads = parsed;
+    }
+    bool heads_changed = next.heads.size() != config.heads.size();
+    for (size_t i = 0; !heads_changed && i < next.heads.size(); ++i) {
+        heads_changed = next.heads[i].cls != config.heads[i].cls || next.heads[i].reg != config.heads[i].reg ||
+                        next.heads[i].stride != config.heads[i].stride;
+    }
+    if (heads_changed) decoders_dirty.store(true);
+    config = std::move(next);
+
+    // Everything in the decode parameters except the per-frame input size.
+    decode_template = DecodeParams();
+    decode_template.baseScore = config.baseScore;
+    decode_template.minScoreSmallArea = config.minScoreSmallArea;
+    decode_template.minScoreMediumArea = config.minScoreMediumArea;
+    decode_template.minScoreSmallAreaThreshold = config.minScoreSmallAreaThreshold;
+    decode_template.minScoreMediumAreaThreshold = config.minScoreMediumAreaThreshold;
+    decode_template.personMinScore = runtime.personMinScore;
+    decode_template.minBoxArea = config.minBoxArea;
+    decode_template.topK = config.topK;
+    decode_template.showLabels = runtime.showLabels;
+
+    const int decode_threads = runtime.detDecodeThreads;
+    if (decode_threads != (decode_pool ? decode_pool->size() : 0)) {
+        decode_pool.reset(decode_threads > 0 ? new TaskPool(decode_threads) : nullptr);
+        std::cout << "[AI] Head decode: " << (decode_threads > 0 ? "parallel, " + std::to_string(decode_threads) + " threads" : "inline") << std::endl;
+    }
+
+    schedule_deadline = runtime.detSchedule == "deadline";
+    // Batching tiles whole frames into one input, so the cascade's per-frame
+    // crops keep it at one frame per forward.
+    const size_t batch = (config.cascade || batch_failed) ? 1 : static_cast<size_t>(runtime.detBatch);
+    if (batch != batch_limit) {
+        batch_limit = batch;
+        std::cout << "[AI] Batch: up to " << batch_limit << " frames per forward" << std::endl;
+    }
+
+    if (runtime.debug) {
+        std::cout << "\n[NanoStream] Detector config: " << formatDetectorConfig() << std::endl;
+    }
+}
+
+bool NCNNDetector::runPass(const ncnn::Mat& in, const DecodeParams& params, uint64_t frame_id, bool debug,
+                           std::vector<Detection>& raw_dets, float& max_score_all) {
+    ncnn::Extractor ex = net.create_extractor();
+    ex.set_light_mode(true);
+    if (inference_threads > 0) ex.set_num_threads(inference_threads);
+    ex.input(kInputBlob, in);
+
+    if (decoders_dirty.exchange(false) || head_decoders.size() != config.heads.size()) {
+        // A head whose blobs are not there yet is retried on the next pass.
+        if (!resolveHeadDecoders(ex, debug)) decoders_dirty.store(true);
+    }
+
+    const size_t heads = config.heads.size();
+    if (decode_pool) {
+        head_candidates.resize(heads);
+        head_max_scores.assign(heads, max_score_all);
+        for (auto& c : head_candidates) c.clear();
+    }
+
+    bool any_head_ok = false;
+    for (size_t i = 0; i < heads; ++i) {
+        const HeadDecoder* decoder = head_decoders[i].get();
+        if (!decoder) continue;
+        const auto& h = config.heads[i];
+        ncnn::Mat out_cls, out_reg;
+        bool extracted;
+        {
+            // The first head's extract also runs the shared backbone.
+            stage_profiler::Scope scope(extract_stages[i]);
+            extracted = extractHeadOutputs(ex, h.cls, h.reg, frame_id, debug, out_cls, out_reg);
         }
-        if (!parsed.empty()) {
-            config.heads = parsed;
+        if (!extracted) continue;
+        any_head_ok = true;
+        if (!decode_pool) {
+            stage_profiler::Scope scope(kStageDecode);
+            decoder->decode(out_cls, out_reg, params, raw_dets, max_score_all);
+            continue;
+        }
+        std::vector<Detection>* candidates = &head_candidates[i];
+        float* max_score = &head_max_scores[i];
+        auto task = [decoder, out_cls, out_reg, &params, candidates, max_score]() {
+            stage_profiler::Scope scope(kStageDecode);
+            decoder->decode(out_cls, out_reg, params, *candidates, *max_score);
+        };
+        // Nothing is left to overlap with the last head, so the worker
+        // decodes it itself instead of idling in wait().
+        if (i + 1 < heads) {
+            decode_pool->submit(task);
+        } else {
+            task();
         }
     }
+
+    if (decode_pool) {
+        decode_pool->wait();
+        for (size_t i = 0; i < heads; ++i) {
+            raw_dets.insert(raw_dets.end(), head_candidates[i].begin(), head_candidates[i].end());
+            max_score_all = std::max(max_score_all, head_max_scores[i]);
+        }
+    }
+    return any_head_ok;
+}
+
+// Runs on the worker before its first inference. The OpenMP team is
+// created from this thread, so it inherits the nice value, and ncnn pins
+// each team thread to the same cores.
+void NCNNDetector::applyThreadTopology(const RuntimeConfig& runtime) {
+    const std::vector<int> cpus = thread_topology::parseCpuList(runtime.cpuAi);
+    if (!cpus.empty() && thread_topology::pinCurrentThread(cpus)) {
+        ncnn::CpuSet mask;
+        for (int c : cpus) mask.enable(c);
+        ncnn::set_cpu_thread_affinity(mask);
+        inference_threads = std::min(static_cast<int>(cpus.size()), net.opt.num_threads);
+    }
+    if (runtime.aiNice != 0) thread_topology::setCurrentThreadNice(runtime.aiNice);
+    std::cout << "[Topology] ai worker: " << thread_topology::describeCurrentThread()
+              << " ncnn_threads=" << (inference_threads > 0 ? inference_threads : net.opt.num_threads) << std::endl;
 }
 
+// Frames from several cameras side by side in one input, so a single
+// forward serves them all. Each tile starts on a multiple of the coarsest
+// head stride, so every grid cell belongs to exactly one camera; boxes go
+// to the tile holding their centre and are clipped to it.
+bool NCNNDetector::runBatch(const std::vector<Job>& jobs, int in_w, int in_h, float frame_area, uint64_t frame_id,
+                            bool debug, std::vector<std::vector<Detection>>& raw_dets, float& max_score_all) {
+    int stride = 1;
+    for (const auto& h : config.heads) stride = std::max(stride, h.stride);
+    const int tile_w = (in_w + stride - 1) / stride * stride;
+    const int tiles = static_cast<int>(jobs.size());
+
+    ncnn::Mat mosaic(tile_w * tiles, in_h, 3);
+    mosaic.fill(0.0f);   // the mean colour once normalized
+    for (int t = 0; t < tiles; ++t) {
+        ncnn::Mat tile;
+        if (!prepareInput(jobs[t].frame, in_w, in_h, tile)) continue;
+        for (int q = 0; q < 3; ++q) {
+            ncnn::Mat dst = mosaic.channel(q);
+            const ncnn::Mat src = tile.channel(q);
+            for (int y = 0; y < in_h; ++y) {
+                std::memcpy(dst.row(y) + t * tile_w, src.row(y), sizeof(float) * in_w);
+            }
+        }
+    }
+
+    DecodeParams params = makeDecodeParams(frame_area, in_w, in_h);
+    params.inputWidth = tile_w * tiles;
+    params.topK *= tiles;
+    std::vector<Detection> mosaic_dets;
+    if (!runPass(mosaic, params, frame_id, debug, mosaic_dets, max_score_all)) return false;
+
+    const float tile_frame_w = tile_w * params.scaleX;
+    for (auto d : mosaic_dets) {
+        int t = static_cast<int>((d.x + d.w * 0.5f) / tile_frame_w);
+        t = std::max(0, std::min(tiles - 1, t));
+        const int x0 = std::max(0, d.x - static_cast<int>(t * tile_frame_w));
+        const int x1 = std::min(config.frameWidth, d.x + d.w - static_cast<int>(t * tile_frame_w));
+        if (x1 <= x0) continue;
+        d.x = x0;
+        d.w = x1 - x0;
+        raw_dets[t].push_back(d);
+    }
+    return true;
+}
+
+void NCNNDetector::publishResult(size_t channel, std::vector<Detection>& final_dets, uint64_t pts,
+                                 int lat, float max_score_all, bool any_head_ok, bool debug) {
+    Channel& ch = *channels[channel];
+    const std::string cam = channels.size() > 1 ? "cam" + std::to_string(channel) + " " : "";
+    ch.seq++;
+    if (!final_dets.empty()) {
+        // Multi-target EMA smoothing with IOU association
+        {
+            stage_profiler::Scope scope(kStageSmooth);
+            smoothDetections(ch.prev, final_dets);
+        }
+        std::cout << "\r[NanoStream] " << cam << "Detected: " << final_dets.size() << " | Lat: " << lat << "ms    " << std::flush;
+        ch.prev = final_dets;
+        std::lock_guard<std::mutex> lock(ch.result_mutex);
+        ch.current = final_dets;
+    } else {
+        if (debug && ch.seq % 60 == 0) {
+            std::cout << "\r[NanoStream] " << cam << "MaxScore: " << max_score_all
+                      << " | HeadOK: " << (any_head_ok ? "Y" : "N")
+                      << " | Lat: " << lat << "ms    " << std::flush;
+        }
+        ch.prev.clear();
+        std::lock_guard<std::mutex> lock(ch.result_mutex);
+        ch.current.clear();
+    }
+    notifyListeners(ch, channel, final_dets, pts);
+}
 
 void NCNNDetector::workerLoop() {
     uint64_t frame_id = 0;
-
-    static const char* kCoco80[] = {
-        "person","bicycle","car","motorcycle","airplane","bus","train","truck","boat","traffic light",
-        "fire hydrant","stop sign","parking meter","bench","bird","cat","dog","horse","sheep","cow",
-        "elephant","bear","zebra","giraffe","backpack","umbrella","handbag","tie","suitcase","frisbee",
-        "skis","snowboard","sports ball","kite","baseball bat","baseball glove","skateboard","surfboard","tennis racket","bottle",
-        "wine glass","cup","fork","knife","spoon","bowl","banana","apple","sandwich","orange",
-        "broccoli","carrot","hot dog","pizza","donut","cake","chair","couch","potted plant","bed",
-        "dining table","toilet","tv","laptop","mouse","remote","keyboard","cell phone","microwave","oven",
-        "toaster","sink","refrigerator","book","clock","vase","scissors","teddy bear","hair drier","toothbrush"
-    };
+    applyThreadTopology(getRuntimeConfig());
+    std::vector<Job> jobs;
+    std::vector<std::vector<Detection>> raw_dets;
+    std::vector<std::vector<Detection>> final_dets;
 
     while (running) {
+        // Version first, then the snapshot: the snapshot is at least as new.
+        const uint64_t version = runtimeConfigVersion();
         const RuntimeConfig& runtime = getRuntimeConfig();
-        applyRuntimeOverrides(runtime);
-        if (runtime.debug && !config_logged) {
-            std::cout << "[NanoStream] Detector config: " << formatDetectorConfig() << std::endl;
-            config_logged = true;
+        if (version != compiled_version) {
+            compileConfig(runtime);
+            compiled_version = version;
+        }
+        if (runtime.detAdaptiveInput && !config.cascade && !input_governor_configured) {
+            InputSizeGovernor::Config gov;
+            gov.steps = runtime.detInputSteps;
+            gov.latencyBudgetMs = runtime.detLatencyBudgetMs;
+            input_governor.configure(gov, config.inputWidth);
+            input_governor_configured = true;
+            std::cout << "[AI] Adaptive input enabled, start=" << input_governor.current() << std::endl;
         }
         if (paused.load()) {
             clearResults();
@@ -192,163 +512,74 @@ void NCNNDetector::workerLoop() {
             continue;
         }
 
-        std::vector<unsigned char> local_frame;
-        int w = 0, h = 0;
-        if (!waitForFrame(local_frame, w, h)) break;
+        if (!waitForFrames(jobs)) break;
 
         int sleep_ms = throttle_ms.load();
         if (sleep_ms > 0) {
             std::this_thread::sleep_for(std::chrono::milliseconds(sleep_ms));
         }
 
-        ncnn::Mat in;
-        if (!prepareInput(local_frame, w, h, in)) continue;
-
         auto start = std::chrono::high_resolution_clock::now();
 
-        ncnn::Extractor ex = net.create_extractor();
-        ex.set_light_mode(true);
-        ex.input("input.1", in);
-        
         const float frame_area = static_cast<float>(config.frameWidth) * config.frameHeight;
-        std::vector<Detection> raw_dets;
+        raw_dets.resize(jobs.size());
+        for (auto& r : raw_dets) r.clear();
         float max_score_all = -1e9f;
         bool any_head_ok = false;
         bool debug = runtime.debug;
 
-        for (const auto& h : config.heads) {
-            ncnn::Mat out_cls, out_reg;
-            if (!extractHeadOutputs(ex, h.cls, h.reg, frame_id, debug, out_cls, out_reg)) continue;
-
-            // Layout handling: NanoDet-m (ncnn-assets) uses distribution regression (reg_max=7, 4*8 bins), and cls folded into w.
-            if (out_cls.c == 1 && out_reg.c == 1 && out_reg.w % 4 == 0 && out_reg.h == out_cls.h) {
-                int num_cls = out_cls.w;            // 80
-                int locations = out_cls.h;          // 1600/400/100
-                int bins = out_reg.w / 4;           // expect 8
-                int feat_w = (int)(std::sqrt((float)locations) + 0.5f);
-                if (feat_w <= 0) feat_w = locations;
-                int feat_h = locations / feat_w;
-                if (feat_w * feat_h != locations) { feat_w = locations; feat_h = 1; }
-
-                any_head_ok = true;
-                int kept = 0;
-                for (int loc = 0; loc < locations; ++loc) {
-                    const float* cls_ptr = out_cls.row(loc);
-                    const float* reg_ptr = out_reg.row(loc);
-
-                    float max_score = 0.f;
-                    int max_idx = 0;
-                    for (int c = 0; c < num_cls; ++c) {
-                        if (cls_ptr[c] > max_score) { max_score = cls_ptr[c]; max_idx = c; }
-                    }
-                    if (max_score > max_score_all) max_score_all = max_score;
-                    if (max_score <= config.baseScore) continue;
-                    if (kept++ > config.topK) continue;
-
-                    int gx = loc % feat_w;
-                    int gy = loc / feat_w;
-                    float l = distExpect(reg_ptr + 0 * bins, bins) * h.stride;
-                    float t = distExpect(reg_ptr + 1 * bins, bins) * h.stride;
-                    float r = distExpect(reg_ptr + 2 * bins, bins) * h.stride;
-                    float b = distExpect(reg_ptr + 3 * bins, bins) * h.stride;
-
-                    float scale_x = static_cast<float>(config.frameWidth) / config.inputWidth;
-                    float scale_y = static_cast<float>(config.frameHeight) / config.inputHeight;
-                    float cx = gx * h.stride;
-                    float cy = gy * h.stride;
-
-                    Detection d;
-                    d.x = (int)((cx - l) * scale_x);
-                    d.y = (int)((cy - t) * scale_y);
-                    d.w = (int)((l + r) * scale_x);
-                    d.h = (int)((t + b) * scale_y);
-                    d.score = max_score;
-                    if (runtime.showLabels && max_idx >= 0 && max_idx < 80) {
-                        d.label = kCoco80[max_idx];
-                    } else {
-                        d.label = "Target";
-                    }
-                    d.class_id = max_idx;
-                    float area_norm = (d.w * d.h) / frame_area;
-                    float min_score = config.baseScore;
-                    if (area_norm < config.minScoreSmallAreaThreshold) min_score = config.minScoreSmallArea;
-                    else if (area_norm < config.minScoreMediumAreaThreshold) min_score = config.minScoreMediumArea;
-                    if (d.class_id == 0) {
-                        if (min_score < runtime.personMinScore) min_score = runtime.personMinScore;
-                    }
-                    if (d.score < min_score) continue;
-                    if (d.w * d.h < config.minBoxArea) continue;
-                    raw_dets.push_back(d);
-                }
-                continue;
+        if (config.cascade) {
+            runCascade(jobs[0].frame, frame_area, frame_id, debug,
+                       raw_dets[0], max_score_all, any_head_ok);
+        } else {
+            int in_w = config.inputWidth;
+            int in_h = config.inputHeight;
+            if (input_governor_configured) {
+                in_w = input_governor.current();
+                in_h = input_governor.current();
             }
-
-            // Fallback: original layout
-            if (out_cls.w <= 0 || out_cls.h <= 0 || out_cls.c <= 0) continue;
-            if (out_reg.c < 4) continue;
-            any_head_ok = true;
-
-            for (int i = 0; i < out_cls.w * out_cls.h; i++) {
-                float max_logit = -1e9f;
-                for (int c = 0; c < out_cls.c; c++) max_logit = std::max(max_logit, out_cls.channel(c)[i]);
-                float score = 1.0f / (1.0f + std::exp(-max_logit));
-                if (score > max_score_all) max_score_all = score;
-
-                if (score > config.baseScore) {
-                    int gx = i % out_cls.w;
-                    int gy = i / out_cls.w;
-                    
-                    float l = out_reg.channel(0)[i] * h.stride;
-                    float t = out_reg.channel(1)[i] * h.stride;
-                    float r = out_reg.channel(2)[i] * h.stride;
-                    float b = out_reg.channel(3)[i] * h.stride;
-
-                    float scale_x = static_cast<float>(config.frameWidth) / config.inputWidth;
-                    float scale_y = static_cast<float>(config.frameHeight) / config.inputHeight;
-                    float cx = gx * h.stride;
-                    float cy = gy * h.stride;
-
-                    Detection d;
-                    d.x = (int)((cx - l) * scale_x);
-                    d.y = (int)((cy - t) * scale_y);
-                    d.w = (int)((l + r) * scale_x);
-                    d.h = (int)((t + b) * scale_y);
-                    d.score = score;
-                    d.label = "Target";
-                    d.class_id = -1;
-                    float area_norm = (d.w * d.h) / frame_area;
-                    float min_score = config.baseScore;
-                    if (area_norm < config.minScoreSmallAreaThreshold) min_score = config.minScoreSmallArea;
-                    else if (area_norm < config.minScoreMediumAreaThreshold) min_score = config.minScoreMediumArea;
-                    if (d.score < min_score) continue;
-                    if (d.w * d.h < config.minBoxArea) continue;
-                    raw_dets.push_back(d);
+            bool batched = false;
+            if (jobs.size() > 1) {
+                batched = runBatch(jobs, in_w, in_h, frame_area, frame_id, debug, raw_dets, max_score_all);
+                if (!batched) {
+                    // Models with fixed-size reshapes cannot take a wider input.
+                    std::cerr << "\n[AI] Batched forward failed, falling back to one frame per forward" << std::endl;
+                    batch_failed = true;
+                    batch_limit = 1;
+                    decoders_dirty.store(true);
                 }
+                any_head_ok = batched;
+            }
+            for (size_t j = 0; !batched && j < jobs.size(); ++j) {
+                ncnn::Mat in;
+                if (!prepareInput(jobs[j].frame, in_w, in_h, in)) continue;
+                const DecodeParams params = makeDecodeParams(frame_area, in_w, in_h);
+                any_head_ok = runPass(in, params, frame_id, debug, raw_dets[j], max_score_all) || any_head_ok;
             }
         }
 
         // NMS & Smoothing
-        std::vector<Detection> final_dets;
-        applyPostFilter(runtime, raw_dets, final_dets, frame_area);
+        final_dets.resize(jobs.size());
+        size_t total_dets = 0;
+        for (size_t j = 0; j < jobs.size(); ++j) {
+            final_dets[j].clear();
+            stage_profiler::Scope scope(kStageNms);
+            applyPostFilter(runtime, raw_dets[j], final_dets[j], frame_area);
+            total_dets += final_dets[j].size();
+        }
 
         auto lat = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count();
+        last_latency_ms.store(static_cast<int>(lat));
         frame_id++;
-        if (!final_dets.empty()) {
-            // Multi-target EMA smoothing with IOU association
-            smoothDetections(final_dets);
-            std::cout << "\r[NanoStream] Detected: " << final_dets.size() << " | Lat: " << lat << "ms    " << std::flush;
-            std::lock_guard<std::mutex> lock(result_mutex);
-            current_detections = final_dets;
-            prev_detections = final_dets;
-        } else {
-            if (debug && frame_id % 60 == 0) {
-                std::cout << "\r[NanoStream] MaxScore: " << max_score_all
-                          << " | HeadOK: " << (any_head_ok ? "Y" : "N")
-                          << " | Lat: " << lat << "ms    " << std::flush;
-            }
-            std::lock_guard<std::mutex> lock(result_mutex);
-            current_detections.clear();
-            prev_detections.clear();
+        if (input_governor_configured &&
+            input_governor.update(lat, total_dets, throttle_ms.load() > 0)) {
+            std::cout << "\n[AI] Input size -> " << input_governor.current()
+                      << " (lat=" << lat << "ms)" << std::endl;
+        }
+        for (size_t j = 0; j < jobs.size(); ++j) {
+            publishResult(jobs[j].channel, final_dets[j], jobs[j].frame.pts, static_cast<int>(lat),
+                          max_score_all, any_head_ok, debug);
+            jobs[j].frame = VideoFrameRef();
         }
     }
 }
@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include "ncnn_detector.hpp"
+#include "stage_profiler.hpp"
+
+namespace {
+
+const int kStagePreprocess = stage_profiler::stage("preprocess");
+
+struct Roi {
+    int x, y, w, h;
+};
+
+bool roiContains(const Roi& r, float px, float py) {
+    return px >= r.x && px < r.x + r.w && py >= r.y && py < r.y + r.h;
+}
+
+}
+
+bool NCNNDetector::prepareRoiInput(const VideoFrameRef& frame,
+                                   int roi_x, int roi_y, int roi_w, int roi_h,
+                                   int target_w, int target_h, ncnn::Mat& in) const {
+    stage_profiler::Scope scope(kStagePreprocess);
+    const int w = frame.width;
+    const int h = frame.height;
+    if (!frame.data || w <= 0 || h <= 0 || roi_w <= 0 || roi_h <= 0) return false;
+    if (roi_x < 0 || roi_y < 0 || roi_x + roi_w > w || roi_y + roi_h > h) return false;
+
+    in = ncnn::Mat::from_pixels_roi_resize(frame.data, ncnn::Mat::PIXEL_BGR, w, h, frame.stride,
+                                           roi_x, roi_y, roi_w, roi_h, target_w, target_h);
+    const float mean_vals[3] = {103.53f, 116.28f, 123.675f};
+    const float norm_vals[3] = {0.017429f, 0.017507f, 0.017125f};
+    in.substract_mean_normalize(mean_vals, norm_vals);
+    return true;
+}
+
+void NCNNDetector::runCascade(const VideoFrameRef& frame, float frame_area, uint64_t frame_id, bool debug,
+                              std::vector<Detection>& raw_dets, float& max_score_all, bool& any_head_ok) {
+    // Stage 1: coarse full-frame pass with gates relaxed to the proposal score,
+    // so low-confidence candidates survive long enough to be refined.
+    const int w = frame.width;
+    const int h = frame.height;
+    const int coarse = config.cascadeInputSize;
+    ncnn::Mat in;
+    if (!prepareRoiInput(frame, 0, 0, w, h, coarse, coarse, in)) return;
+
+    const DecodeParams strict = makeDecodeParams(frame_area, coarse, coarse);
+    DecodeParams relaxed = strict;
+    relaxed.baseScore = std::min(strict.baseScore, config.cascadeProposalScore);
+    relaxed.minScoreSmallArea = config.cascadeProposalScore;
+    relaxed.minScoreMediumArea = config.cascadeProposalScore;
+    relaxed.personMinScore = config.cascadeProposalScore;
+
+    std::vector<Detection> coarse_dets;
+    any_head_ok = runPass(in, relaxed, frame_id, debug, coarse_dets, max_score_all);
+
+    std::vector<Detection> proposals;
+    for (const auto& d : coarse_dets) {
+        float area_norm = (d.w * d.h) / frame_area;
+        if (decoder_detail::passesGate(strict, d) && area_norm >= config.cascadeRefineAreaThreshold) {
+            raw_dets.push_back(d);
+        } else {
+            proposals.push_back(d);
+        }
+    }
+    if (proposals.empty()) return;
+    std::sort(proposals.begin(), proposals.end(),
+              [](const Detection& a, const Detection& b){ return a.score > b.score; });
+
+    // Stage 2: square crops around the strongest proposals, at source-frame
+    // resolution. Proposals whose centre is already covered share a crop.
+    const float src_per_frame_x = static_cast<float>(w) / config.frameWidth;
+    const float src_per_frame_y = static_cast<float>(h) / config.frameHeight;
+    const int max_side = std::min(w, h);
+    const int min_side = std::min(max_side, std::max(32, config.cascadeRoiInputSize / 4));
+
+    std::vector<Roi> rois;
+    std::vector<bool> refined(proposals.size(), false);
+    for (size_t i = 0; i < proposals.size(); ++i) {
+        const auto& p = proposals[i];
+        float cx = (p.x + p.w * 0.5f) * src_per_frame_x;
+        float cy = (p.y + p.h * 0.5f) * src_per_frame_y;
+        bool covered = false;
+        for (const auto& r : rois) {
+            if (roiContains(r, cx, cy)) { covered = true; break; }
+        }
+        if (covered) { refined[i] = true; continue; }
+        if (static_cast<int>(rois.size()) >= config.cascadeMaxRois) continue;
+
+        float extent = std::max(p.w * src_per_frame_x, p.h * src_per_frame_y) * config.cascadeRoiExpand;
+        int side = std::max(min_side, std::min(max_side, static_cast<int>(extent)));
+        Roi r;
+        r.w = side;
+        r.h = side;
+        r.x = std::max(0, std::min(w - side, static_cast<int>(cx) - side / 2));
+        r.y = std::max(0, std::min(h - side, static_cast<int>(cy) - side / 2));
+        rois.push_back(r);
+        refined[i] = true;
+    }
+
+    const int roi_in = config.cascadeRoiInputSize;
+    const size_t refined_begin = raw_dets.size();
+    for (const auto& r : rois) {
+        ncnn::Mat roi_mat;
+        if (!prepareRoiInput(frame, r.x, r.y, r.w, r.h, roi_in, roi_in, roi_mat)) continue;
+        DecodeParams params = strict;
+        params.inputWidth = roi_in;
+        params.inputHeight = roi_in;
+        params.scaleX = static_cast<float>(r.w) / roi_in / src_per_frame_x;
+        params.scaleY = static_cast<float>(r.h) / roi_in / src_per_frame_y;
+        params.offsetX = r.x / src_per_frame_x;
+        params.offsetY = r.y / src_per_frame_y;
+        runPass(roi_mat, params, frame_id, debug, raw_dets, max_score_all);
+    }
+
+    // Proposals that clear the normal gate are kept unless a stage-2 box
+    // already covers them, so refinement can only add recall.
+    const size_t refined_end = raw_dets.size();
+    for (size_t i = 0; i < proposals.size(); ++i) {
+        if (!decoder_detail::passesGate(strict, proposals[i])) continue;
+        bool superseded = false;
+        for (size_t j = refined_begin; refined[i] && j < refined_end; ++j) {
+            if (calculateIoU(proposals[i], raw_dets[j]) > 0.1f) { superseded = true; break; }
+        }
+        if (!superseded) raw_dets.push_back(proposals[i]);
+    }
+
+    if (debug && frame_id % 60 == 0) {
+        std::cout << "\n[Cascade] proposals=" << proposals.size()
+                  << " rois=" << rois.size() << " raw=" << raw_dets.size() << std::endl;
+    }
+}
@@ -2,22 +2,7 @@
 #include <cmath>
 
 #include "ncnn_detector.hpp"
-
-float NCNNDetector::distExpect(const float* p, int bins) const {
-    float sum = 0.f;
-    if (bins <= 0 || bins > 16) return 0.0f;
-    float maxv = p[0];
-    for (int i = 1; i < bins; ++i) maxv = std::max(maxv, p[i]);
-    float expbuf[16];
-    for (int i = 0; i < bins; ++i) {
-        float expv = std::exp(p[i] - maxv);
-        expbuf[i] = expv;
-        sum += expv;
-    }
-    float v = 0.f;
-    for (int i = 0; i < bins; ++i) v += (expbuf[i] / sum) * i;
-    return v;
-}
+#include "stage_profiler.hpp"
 
 bool NCNNDetector::extractHeadOutputs(ncnn::Extractor& ex,
                                       const std::string& cls,
@@ -39,3 +24,44 @@ bool NCNNDetector::extractHeadOutputs(ncnn::Extractor& ex,
     }
     return extracted;
 }
+
+DecodeParams NCNNDetector::makeDecodeParams(float frame_area, int input_w, int input_h) const {
+    DecodeParams p = decode_template;
+    p.inputWidth = input_w;
+    p.inputHeight = input_h;
+    p.scaleX = static_cast<float>(config.frameWidth) / input_w;
+    p.scaleY = static_cast<float>(config.frameHeight) / input_h;
+    p.frameArea = frame_area;
+    return p;
+}
+
+bool NCNNDetector::resolveHeadDecoders(ncnn::Extractor& ex, bool debug) {
+    // Retried every pass while a head is unresolved, so only log changes.
+    std::vector<std::string> previous(config.heads.size());
+    if (head_decoders.size() == config.heads.size()) {
+        for (size_t i = 0; i < head_decoders.size(); ++i) {
+            previous[i] = head_decoders[i] ? head_decoders[i]->name() : "none";
+        }
+    }
+    head_decoders.clear();
+    head_decoders.reserve(config.heads.size());
+    extract_stages.clear();
+    bool all_resolved = true;
+    for (size_t i = 0; i < config.heads.size(); ++i) {
+        const auto& h = config.heads[i];
+        extract_stages.push_back(stage_profiler::stage("extract " + h.cls + "/" + h.reg));
+        ncnn::Mat out_cls, out_reg;
+        std::unique_ptr<HeadDecoder> decoder;
+        if (extractHeadOutputs(ex, h.cls, h.reg, 0, debug, out_cls, out_reg)) {
+            decoder = makeHeadDecoder(out_cls, out_reg, h.stride);
+        }
+        const std::string name = decoder ? decoder->name() : "none";
+        if (name != previous[i]) {
+            std::cout << "[AI] Head " << h.cls << "/" << h.reg << " stride=" << h.stride
+                      << " decoder=" << name << std::endl;
+        }
+        if (!decoder) all_resolved = false;
+        head_decoders.push_back(std::move(decoder));
+    }
+    return all_resolved;
+}
@@ -82,13 +82,13 @@ void NCNNDetector::applyPostFilter(const RuntimeConfig& runtime,
     append_with_caps();
 }
 
-void NCNNDetector::smoothDetections(std::vector<Detection>& final_dets) {
+void NCNNDetector::smoothDetections(const std::vector<Detection>& prev_dets, std::vector<Detection>& final_dets) const {
     std::vector<Detection> smoothed;
     smoothed.reserve(final_dets.size());
     for (const auto& cur : final_dets) {
         const Detection* best = nullptr;
         float best_iou = 0.0f;
-        for (const auto& prev : prev_detections) {
+        for (const auto& prev : prev_dets) {
             if (cur.class_id >= 0 && prev.class_id >= 0 && cur.class_id != prev.class_id) continue;
             float v = calculateIoU(cur, prev);
             if (v > best_iou) { best_iou = v; best = &prev; }
@@ -0,0 +1,38 @@
+#include <algorithm>
+
+#include "network_rate_controller.hpp"
+
+void NetworkRateController::configure(const Config& config) {
+    cfg = config;
+    cfg.minBitrateKbps = std::max(1, std::min(cfg.minBitrateKbps, cfg.maxBitrateKbps));
+    bitrate = cfg.maxBitrateKbps;
+    clean_windows = 0;
+    lossy = false;
+}
+
+bool NetworkRateController::update(const Feedback& fb) {
+    const int prev = bitrate;
+    // Nobody watching: nothing to learn, and no one to force keyframes
+    // for. Drift back to the configured rate for the next viewer.
+    if (fb.receivers <= 0) {
+        lossy = false;
+        clean_windows = 0;
+        bitrate = std::min(cfg.maxBitrateKbps, bitrate + cfg.increaseKbps);
+        return bitrate != prev;
+    }
+
+    lossy = fb.fractionLost > cfg.lossLow;
+    const bool congested = fb.fractionLost > cfg.lossHigh || fb.jitterMs > cfg.jitterHighMs || fb.qosEvents > 0;
+    if (congested) {
+        bitrate = std::max(cfg.minBitrateKbps, static_cast<int>(bitrate * cfg.decrease));
+        clean_windows = 0;
+    } else if (!lossy) {
+        if (++clean_windows >= cfg.probeWindows) {
+            bitrate = std::min(cfg.maxBitrateKbps, bitrate + cfg.increaseKbps);
+            clean_windows = 0;
+        }
+    } else {
+        clean_windows = 0;
+    }
+    return bitrate != prev;
+}
@@ -0,0 +1,275 @@
+#include <algorithm>
+#include <cstring>
+#include <cairo.h>
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "osd_renderer.hpp"
+
+namespace {
+
+// Upper bound on cached tiles; 80 classes x a few live buckets fits easily.
+constexpr size_t kMaxSprites = 256;
+
+// BT.601 limited range, integer approximation.
+inline uint8_t rgbToY(int r, int g, int b) { return static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16); }
+inline uint8_t rgbToU(int r, int g, int b) { return static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128); }
+inline uint8_t rgbToV(int r, int g, int b) { return static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128); }
+
+}
+
+namespace osd_detail {
+
+void fillPixels(uint32_t* dst, int n, uint32_t v) {
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    uint32x4_t vv = vdupq_n_u32(v);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) vst1q_u32(dst + i, vv);
+    for (; i < n; ++i) dst[i] = v;
+#else
+    std::fill_n(dst, n, v);
+#endif
+}
+
+}
+
+OsdRenderer::OsdRenderer() : OsdRenderer(Style()) {}
+
+OsdRenderer::OsdRenderer(const Style& style) : style_(style) {
+    dirty.reserve(32);
+    key_scratch.reserve(32);
+}
+
+OsdRenderer::Sprite OsdRenderer::rasterize(const std::string& text) const {
+    Sprite sprite;
+    sprite.h = style_.labelHeight;
+
+    // Measure on a scratch surface so the tile can grow with the text.
+    cairo_surface_t* probe = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 1, 1);
+    cairo_t* pcr = cairo_create(probe);
+    cairo_select_font_face(pcr, "Sans", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
+    cairo_set_font_size(pcr, style_.fontSize);
+    cairo_text_extents_t ext;
+    cairo_text_extents(pcr, text.c_str(), &ext);
+    cairo_destroy(pcr);
+    cairo_surface_destroy(probe);
+    sprite.w = std::max(style_.labelMinWidth, static_cast<int>(ext.x_advance) + 10);
+
+    cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, sprite.w, sprite.h);
+    cairo_t* cr = cairo_create(surface);
+    const uint32_t bg = style_.boxColor;
+    const uint32_t fg = style_.textColor;
+    cairo_set_source_rgb(cr, ((bg >> 16) & 0xff) / 255.0, ((bg >> 8) & 0xff) / 255.0, (bg & 0xff) / 255.0);
+    cairo_paint(cr);
+    cairo_select_font_face(cr, "Sans", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
+    cairo_set_font_size(cr, style_.fontSize);
+    cairo_set_source_rgb(cr, ((fg >> 16) & 0xff) / 255.0, ((fg >> 8) & 0xff) / 255.0, (fg & 0xff) / 255.0);
+    cairo_move_to(cr, 5, 20);
+    cairo_show_text(cr, text.c_str());
+    cairo_destroy(cr);
+    cairo_surface_flush(surface);
+
+    // ARGB32 is premultiplied native-endian, i.e. BGRA bytes on ARM/x86, so
+    // an opaque tile can be copied straight into a BGRx frame.
+    sprite.pixels.resize(static_cast<size_t>(sprite.w) * sprite.h);
+    const unsigned char* src = cairo_image_surface_get_data(surface);
+    const int src_stride = cairo_image_surface_get_stride(surface);
+    for (int y = 0; y < sprite.h; ++y) {
+        std::memcpy(&sprite.pixels[static_cast<size_t>(y) * sprite.w], src + y * src_stride,
+                    static_cast<size_t>(sprite.w) * 4);
+    }
+    cairo_surface_destroy(surface);
+
+    // Precompute the 4:2:0 version so YUV frames get plain row copies too.
+    const int cw = (sprite.w + 1) / 2;
+    const int ch = (sprite.h + 1) / 2;
+    sprite.yPlane.resize(static_cast<size_t>(sprite.w) * sprite.h);
+    sprite.uPlane.resize(static_cast<size_t>(cw) * ch);
+    sprite.vPlane.resize(static_cast<size_t>(cw) * ch);
+    for (int y = 0; y < sprite.h; ++y) {
+        for (int x = 0; x < sprite.w; ++x) {
+            uint32_t p = sprite.pixels[static_cast<size_t>(y) * sprite.w + x];
+            sprite.yPlane[static_cast<size_t>(y) * sprite.w + x] =
+                rgbToY((p >> 16) & 0xff, (p >> 8) & 0xff, p & 0xff);
+        }
+    }
+    for (int cy = 0; cy < ch; ++cy) {
+        for (int cx = 0; cx < cw; ++cx) {
+            int r = 0, g = 0, b = 0, n = 0;
+            for (int dy = 0; dy < 2 && cy * 2 + dy < sprite.h; ++dy) {
+                for (int dx = 0; dx < 2 && cx * 2 + dx < sprite.w; ++dx) {
+                    uint32_t p = sprite.pixels[static_cast<size_t>(cy * 2 + dy) * sprite.w + cx * 2 + dx];
+                    r += (p >> 16) & 0xff; g += (p >> 8) & 0xff; b += p & 0xff; ++n;
+                }
+            }
+            sprite.uPlane[static_cast<size_t>(cy) * cw + cx] = rgbToU(r / n, g / n, b / n);
+            sprite.vPlane[static_cast<size_t>(cy) * cw + cx] = rgbToV(r / n, g / n, b / n);
+        }
+    }
+    return sprite;
+}
+
+const OsdRenderer::Sprite& OsdRenderer::labelSprite(const Detection& det) {
+    int bucket = -1;
+    if (style_.showScore && style_.scoreBuckets > 0) {
+        bucket = static_cast<int>(det.score * style_.scoreBuckets);
+        bucket = std::max(0, std::min(style_.scoreBuckets, bucket));
+    }
+    key_scratch.assign(det.label);
+    key_scratch.push_back('\x1f');
+    key_scratch.append(std::to_string(bucket));
+
+    auto it = sprites.find(key_scratch);
+    if (it != sprites.end()) return it->second;
+
+    if (sprites.size() >= kMaxSprites) sprites.clear();
+    std::string text = det.label;
+    if (bucket >= 0) {
+        text += " " + std::to_string(bucket * 100 / style_.scoreBuckets) + "%";
+    }
+    return sprites.emplace(key_scratch, rasterize(text)).first->second;
+}
+
+void OsdRenderer::boxRects(int x, int y, int w, int h, int width, int height) {
+    const int lw = std::max(1, style_.lineWidth);
+    const int half = lw / 2;
+    auto clip = [&](int x0, int y0, int x1, int y1) {
+        x0 = std::max(0, x0); y0 = std::max(0, y0);
+        x1 = std::min(width, x1); y1 = std::min(height, y1);
+        if (x0 < x1 && y0 < y1) dirty.push_back({x0, y0, x1 - x0, y1 - y0});
+    };
+    // Stroke centred on the rectangle edge, as cairo_stroke would.
+    clip(x - half, y - half, x + w + lw - half, y - half + lw);
+    clip(x - half, y + h - half, x + w + lw - half, y + h - half + lw);
+    clip(x - half, y - half + lw, x - half + lw, y + h - half);
+    clip(x + w - half, y - half + lw, x + w - half + lw, y + h - half);
+}
+
+const std::vector<OsdRect>& OsdRenderer::drawBgrx(uint8_t* data, int width, int height, int stride,
+                                                  const std::vector<Detection>& dets) {
+    dirty.clear();
+    if (!data || width <= 0 || height <= 0) return dirty;
+
+    const uint32_t color = style_.boxColor;
+    auto row = [&](int y) { return reinterpret_cast<uint32_t*>(data + static_cast<size_t>(y) * stride); };
+
+    for (const auto& det : dets) {
+        int x = det.x;
+        int y = det.y;
+        int w = det.w;
+        int h = det.h;
+        if (w <= 0 || h <= 0) continue;
+
+        x = std::max(0, std::min(x, width - 1));
+        y = std::max(0, std::min(y, height - 1));
+        w = std::min(w, width - x);
+        h = std::min(h, height - y);
+        if (w <= 0 || h <= 0) continue;
+
+        const size_t first = dirty.size();
+        boxRects(x, y, w, h, width, height);
+        for (size_t i = first; i < dirty.size(); ++i) {
+            const OsdRect& r = dirty[i];
+            for (int ry = r.y; ry < r.y + r.h; ++ry) osd_detail::fillPixels(row(ry) + r.x, r.w, color);
+        }
+
+        const Sprite& sprite = labelSprite(det);
+        const int label_x = x;
+        const int label_y = std::max(0, y - sprite.h);
+        const int copy_w = std::min(sprite.w, width - label_x);
+        const int copy_h = std::min(sprite.h, height - label_y);
+        if (copy_w <= 0 || copy_h <= 0) continue;
+        for (int sy = 0; sy < copy_h; ++sy) {
+            std::memcpy(row(label_y + sy) + label_x, &sprite.pixels[static_cast<size_t>(sy) * sprite.w],
+                        static_cast<size_t>(copy_w) * 4);
+        }
+        dirty.push_back({label_x, label_y, copy_w, copy_h});
+    }
+    return dirty;
+}
+
+const std::vector<OsdRect>& OsdRenderer::drawYuv(const OsdYuvTarget& frame, const std::vector<Detection>& dets) {
+    dirty.clear();
+    if (!frame.y || !frame.u || !frame.v || frame.width <= 0 || frame.height <= 0) return dirty;
+
+    const uint32_t c = style_.boxColor;
+    const int cr = (c >> 16) & 0xff, cg = (c >> 8) & 0xff, cb = c & 0xff;
+    const uint8_t box_y = rgbToY(cr, cg, cb);
+    const uint8_t box_u = rgbToU(cr, cg, cb);
+    const uint8_t box_v = rgbToV(cr, cg, cb);
+    const int step = frame.interleaved ? 2 : 1;
+
+    auto fill_chroma = [&](const OsdRect& r) {
+        int x0 = r.x / 2, y0 = r.y / 2;
+        int x1 = (r.x + r.w + 1) / 2, y1 = (r.y + r.h + 1) / 2;
+        for (int cy = y0; cy < y1; ++cy) {
+            uint8_t* u = frame.u + static_cast<size_t>(cy) * frame.uvStride;
+            uint8_t* v = frame.v + static_cast<size_t>(cy) * frame.uvStride;
+            if (frame.interleaved) {
+                // NV12: 16-bit UV pairs
+                const uint16_t uv = static_cast<uint16_t>(box_u | (box_v << 8));
+                uint16_t* p = reinterpret_cast<uint16_t*>(u) + x0;
+                std::fill_n(p, x1 - x0, uv);
+            } else {
+                std::memset(u + x0, box_u, x1 - x0);
+                std::memset(v + x0, box_v, x1 - x0);
+            }
+        }
+    };
+
+    for (const auto& det : dets) {
+        int x = det.x;
+        int y = det.y;
+        int w = det.w;
+        int h = det.h;
+        if (w <= 0 || h <= 0) continue;
+
+        x = std::max(0, std::min(x, frame.width - 1));
+        y = std::max(0, std::min(y, frame.height - 1));
+        w = std::min(w, frame.width - x);
+        h = std::min(h, frame.height - y);
+        if (w <= 0 || h <= 0) continue;
+
+        const size_t first = dirty.size();
+        boxRects(x, y, w, h, frame.width, frame.height);
+        for (size_t i = first; i < dirty.size(); ++i) {
+            const OsdRect& r = dirty[i];
+            for (int ry = r.y; ry < r.y + r.h; ++ry) {
+                std::memset(frame.y + static_cast<size_t>(ry) * frame.yStride + r.x, box_y, r.w);
+            }
+            fill_chroma(r);
+        }
+
+        const Sprite& sprite = labelSprite(det);
+        const int label_x = x & ~1;
+        const int label_y = std::max(0, y - sprite.h) & ~1;
+        const int copy_w = std::min(sprite.w, frame.width - label_x);
+        const int copy_h = std::min(sprite.h, frame.height - label_y);
+        if (copy_w <= 0 || copy_h <= 0) continue;
+        for (int sy = 0; sy < copy_h; ++sy) {
+            std::memcpy(frame.y + static_cast<size_t>(label_y + sy) * frame.yStride + label_x,
+                        &sprite.yPlane[static_cast<size_t>(sy) * sprite.w], copy_w);
+        }
+        const int sprite_cw = (sprite.w + 1) / 2;
+        const int copy_cw = (copy_w + 1) / 2;
+        const int copy_ch = (copy_h + 1) / 2;
+        for (int sy = 0; sy < copy_ch; ++sy) {
+            const uint8_t* su = &sprite.uPlane[static_cast<size_t>(sy) * sprite_cw];
+            const uint8_t* sv = &sprite.vPlane[static_cast<size_t>(sy) * sprite_cw];
+            const size_t row = static_cast<size_t>(label_y / 2 + sy) * frame.uvStride;
+            if (frame.interleaved) {
+                uint8_t* dst = frame.u + row + (label_x / 2) * step;
+                for (int sx = 0; sx < copy_cw; ++sx) {
+                    dst[sx * 2] = su[sx];
+                    dst[sx * 2 + 1] = sv[sx];
+                }
+            } else {
+                std::memcpy(frame.u + row + label_x / 2, su, copy_cw);
+                std::memcpy(frame.v + row + label_x / 2, sv, copy_cw);
+            }
+        }
+        dirty.push_back({label_x, label_y, copy_w, copy_h});
+    }
+    return dirty;
+}
@@ -0,0 +1,126 @@
+#include "pipeline_graph.hpp"
+
+#include <iostream>
+#include <fcntl.h>
+#include <linux/videodev2.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+namespace {
+
+// Asks the element's device whether its OUTPUT queue accepts DMABUF
+// import. REQBUFS with count 0 allocates nothing, and fails for a memory
+// type the driver does not support; the enum nick alone is always present.
+bool supportsDmabufImport(const char *factory) {
+    GstElement *element = gst_element_factory_make(factory, nullptr);
+    if (!element) return false;
+    gchar *device = nullptr;
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(element), "device")) {
+        g_object_get(element, "device", &device, NULL);
+    }
+    gst_object_unref(gst_object_ref_sink(element));
+    if (!device) return false;
+
+    bool supported = false;
+    const int fd = open(device, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    v4l2_capability cap{};
+    if (fd >= 0 && ioctl(fd, VIDIOC_QUERYCAP, &cap) == 0) {
+        const uint32_t caps = (cap.capabilities & V4L2_CAP_DEVICE_CAPS) ? cap.device_caps : cap.capabilities;
+        v4l2_requestbuffers req{};
+        req.count = 0;
+        req.type = (caps & V4L2_CAP_VIDEO_M2M_MPLANE) ? V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE : V4L2_BUF_TYPE_VIDEO_OUTPUT;
+        req.memory = V4L2_MEMORY_DMABUF;
+        supported = ioctl(fd, VIDIOC_REQBUFS, &req) == 0;
+    }
+    if (fd < 0) std::cerr << "[NanoStream] Cannot open " << device << " to probe dmabuf-import" << std::endl;
+    else close(fd);
+    g_free(device);
+    return supported;
+}
+
+bool hasFactory(const char *factory) {
+    GstElementFactory *f = gst_element_factory_find(factory);
+    if (!f) return false;
+    gst_object_unref(f);
+    return true;
+}
+
+}
+
+void GraphBuilder::fail(const std::string& what) {
+    if (error_.empty()) error_ = what;
+}
+
+GstElement* GraphBuilder::make(const char *factory, const char *name) {
+    if (!ok()) return nullptr;
+    GstElement *element = gst_element_factory_make(factory, name);
+    if (!element) {
+        fail(std::string("no element '") + factory + "'");
+        return nullptr;
+    }
+    gst_bin_add(bin, element);
+    return element;
+}
+
+GstElement* GraphBuilder::caps(const std::string& caps) {
+    GstElement *filter = make("capsfilter");
+    if (!filter) return nullptr;
+    GstCaps *parsed = gst_caps_from_string(caps.c_str());
+    if (!parsed) {
+        fail("bad caps '" + caps + "'");
+        return nullptr;
+    }
+    g_object_set(filter, "caps", parsed, NULL);
+    gst_caps_unref(parsed);
+    return filter;
+}
+
+void GraphBuilder::set(GstElement *element, const char *property, const std::string& value) {
+    if (!ok() || !element) return;
+    if (!g_object_class_find_property(G_OBJECT_GET_CLASS(element), property)) {
+        fail(std::string(GST_OBJECT_NAME(element)) + " has no property '" + property + "'");
+        return;
+    }
+    gst_util_set_object_arg(G_OBJECT(element), property, value.c_str());
+}
+
+void GraphBuilder::set(GstElement *element, const char *property, int value) {
+    set(element, property, std::to_string(value));
+}
+
+bool GraphBuilder::chain(std::initializer_list<GstElement*> elements) {
+    if (!ok()) return false;
+    GstElement *prev = nullptr;
+    for (GstElement *element : elements) {
+        if (prev && !gst_element_link(prev, element)) {
+            fail(std::string("cannot link ") + GST_OBJECT_NAME(prev) + " -> " + GST_OBJECT_NAME(element));
+            return false;
+        }
+        prev = element;
+    }
+    return true;
+}
+
+bool addGhostSink(GstElement *bin, GstElement *first) {
+    GstPad *target = gst_element_get_static_pad(first, "sink");
+    if (!target) return false;
+    GstPad *ghost = gst_ghost_pad_new("sink", target);
+    gst_object_unref(target);
+    return ghost && gst_element_add_pad(bin, ghost);
+}
+
+const HardwareCaps& probeHardwareCaps() {
+    static const HardwareCaps caps = []() {
+        HardwareCaps c;
+        c.v4l2Convert = hasFactory("v4l2convert");
+        c.v4l2Encoder = hasFactory("v4l2h264enc");
+        c.convertDmabufImport = c.v4l2Convert && supportsDmabufImport("v4l2convert");
+        c.encoderDmabufImport = c.v4l2Encoder && supportsDmabufImport("v4l2h264enc");
+        std::cout << "[NanoStream] Hardware: v4l2convert=" << (c.v4l2Convert ? "1" : "0")
+                  << " (dmabuf-import=" << (c.convertDmabufImport ? "1" : "0") << ")"
+                  << " v4l2h264enc=" << (c.v4l2Encoder ? "1" : "0")
+                  << " (dmabuf-import=" << (c.encoderDmabufImport ? "1" : "0") << ")" << std::endl;
+        return c;
+    }();
+    return caps;
+}
@@ -2,311 +2,793 @@
 #include <string>
 #include <algorithm>
 #include <cstdlib>
-#include <fstream>
+#include <memory>
 #include <gst/app/gstappsink.h>
-#include <cairo.h>
-#include <cairo-gobject.h>
+#include <gst/video/video.h>
 
+#include "aligned_video_pool.hpp"
+#include "pipeline_graph.hpp"
 #include "pipeline_manager.hpp"
 #include "runtime_config.hpp"
+#include "stage_profiler.hpp"
+#include "thread_topology.hpp"
 
 namespace {
 
-std::string getDmabufDisableFlagPath() {
-    const char* home = std::getenv("HOME");
-    if (home) {
-        return std::string(home) + "/.nanostream_dmabuf_disabled";
+const int kStageOsd = stage_profiler::stage("osd");
+
+using StreamMode = PipelineManager::StreamMode;
+
+const char* streamModeName(StreamMode mode) {
+    switch (mode) {
+    case StreamMode::DmabufConvert: return "DMABUF zero-copy";
+    case StreamMode::DmabufDirect: return "DMABUF direct";
+    default: return "software";
+    }
+}
+
+// Whether the probed elements can run a mode at all; the software path
+// only needs stock plugins.
+bool streamModeSupported(StreamMode mode) {
+    const HardwareCaps& hw = probeHardwareCaps();
+    switch (mode) {
+    case StreamMode::DmabufConvert: return hw.convertDmabufImport && hw.encoderDmabufImport;
+    case StreamMode::DmabufDirect: return hw.encoderDmabufImport;
+    default: return true;
+    }
+}
+
+// Encoders that read GstVideoRegionOfInterestMeta ("roi/vaapi" delta-qp).
+// x264enc and the Pi's v4l2h264enc ignore it, so it is not attached there.
+bool encoderUsesRoiMeta(GstElement *enc) {
+    GstElementFactory *factory = enc ? gst_element_get_factory(enc) : nullptr;
+    if (!factory) return false;
+    const std::string name = GST_OBJECT_NAME(factory);
+    return name == "vaapih264enc" || name == "vah264enc" || name == "vah264lpenc";
+}
+
+// Detection boxes clamped to the frame, for ROI meta on paths where the
+// background hold doesn't run.
+const std::vector<OsdRect>& roiRects(const std::vector<Detection>& dets, int width, int height) {
+    static thread_local std::vector<OsdRect> rects;
+    rects.clear();
+    for (const auto& d : dets) {
+        int x0 = std::max(0, d.x), y0 = std::max(0, d.y);
+        int x1 = std::min(width, d.x + d.w), y1 = std::min(height, d.y + d.h);
+        if (x1 > x0 && y1 > y0) rects.push_back({x0, y0, x1 - x0, y1 - y0});
+    }
+    return rects;
+}
+
+int streamFps(const PipelineManager::PipelineConfig& config) {
+    return config.framerate_num / std::max(1, config.framerate_den);
+}
+
+GstElement* leakyQueue(GraphBuilder& g, int max_buffers, const char *name = nullptr) {
+    GstElement *queue = g.make("queue", name);
+    g.set(queue, "leaky", "downstream");
+    g.set(queue, "max-size-buffers", max_buffers);
+    return queue;
+}
+
+GstElement* appSink(GraphBuilder& g, const char *name) {
+    GstElement *sink = g.make("appsink", name);
+    g.set(sink, "sync", "false");
+    g.set(sink, "async", "false");
+    g.set(sink, "emit-signals", "true");
+    return sink;
+}
+
+// Encoded access units are handed to the RTSP server in-process.
+void encodedTail(GraphBuilder& g, GstElement *encoder, const char *sink_name) {
+    GstElement *parse = g.make("h264parse");
+    g.set(parse, "config-interval", 1);
+    GstElement *caps = g.caps("video/x-h264,stream-format=byte-stream,alignment=au");
+    GstElement *sink = appSink(g, sink_name);
+    g.set(sink, "max-buffers", 8);
+    g.set(sink, "drop", "false");
+    g.chain({encoder, parse, caps, sink});
+}
+
+// Main-stream x264 rate control. With ROI encoding, constant quality
+// capped at the usual bitrate lets held background cost almost nothing
+// instead of ABR spending the savings elsewhere.
+void x264RateControl(GraphBuilder& g, GstElement *enc, const PipelineManager::PipelineConfig& config) {
+    if (config.roi_encode) {
+        g.set(enc, "pass", "qual");
+        g.set(enc, "quantizer", config.roi_crf);
+        g.set(enc, "vbv-buf-capacity", 1000);
+    }
+    g.set(enc, "bitrate", config.stream_bitrate_kbps);
+}
+
+// Main-stream branch in its own bin behind a ghost pad, so it can be
+// swapped under a running pipeline. With a display delay the queue holds
+// buffers until that much media time is buffered, so the OSD draws each
+// frame after its own detection result is usually already in the history.
+GstElement* makeStreamBranch(const PipelineManager::PipelineConfig& config, StreamMode mode, std::string& error) {
+    GstElement *bin = gst_bin_new("stream_branch");
+    GraphBuilder g(GST_BIN(bin));
+    // DmabufDirect has no "osd" element: its buffers are the camera's own
+    // read-only DMABUFs, shared with the AI branch, so nothing is drawn.
+    const char *queue_name = mode == StreamMode::Software ? "stream_q" : nullptr;
+    int max_buffers = config.stream_queue_max;
+    if (config.stream_delay_ms > 0) max_buffers += (config.stream_delay_ms * std::max(1, streamFps(config)) + 999) / 1000;
+    GstElement *queue = leakyQueue(g, max_buffers, queue_name);
+    if (config.stream_delay_ms > 0) {
+        g.set(queue, "min-threshold-time", std::to_string(static_cast<long long>(config.stream_delay_ms) * 1000000));
+        g.set(queue, "max-size-time", 0);
+        g.set(queue, "max-size-bytes", 0);
     }
-    return ".nanostream_dmabuf_disabled";
+
+    GstElement *enc = nullptr;
+    if (mode == StreamMode::Software) {
+        GstElement *rate = g.make("videorate", "enc_rate");
+        g.set(rate, "drop-only", "true");
+        g.set(rate, "max-rate", streamFps(config));
+        GstElement *convert = g.make("videoconvert", "osd");
+        GstElement *caps = g.caps("video/x-raw,format={I420,NV12}");
+        enc = g.make("x264enc", "enc");
+        g.set(enc, "speed-preset", "ultrafast");
+        g.set(enc, "tune", "zerolatency");
+        x264RateControl(g, enc, config);
+        g.set(enc, "threads", config.encoder_threads);
+        g.chain({queue, rate, convert, caps, enc});
+    } else if (mode == StreamMode::DmabufConvert) {
+        GstElement *convert = g.make("v4l2convert", "osd");
+        g.set(convert, "output-io-mode", "dmabuf-import");
+        GstElement *caps = g.caps("video/x-raw,format=NV12");
+        enc = g.make("v4l2h264enc", "enc");
+        g.set(enc, "output-io-mode", "dmabuf-import");
+        g.chain({queue, convert, caps, enc});
+    } else {
+        enc = g.make("v4l2h264enc", "enc");
+        g.set(enc, "output-io-mode", "dmabuf-import");
+        g.chain({queue, enc});
+    }
+    encodedTail(g, enc, "stream_sink");
+
+    error = g.ok() ? (addGhostSink(bin, queue) ? "" : "no sink pad") : g.error();
+    if (!error.empty()) {
+        gst_object_unref(gst_object_ref_sink(bin));
+        return nullptr;
+    }
+    return bin;
 }
 
-void writeDmabufDisableFlag() {
-    std::ofstream flag(getDmabufDisableFlagPath());
+// Sub-stream encoder with its own rate control. The hardware pipelines
+// use a second v4l2h264enc instance fed from system memory.
+void subEncoder(GraphBuilder& g, GstElement *upstream, const PipelineManager::PipelineConfig& config, bool hw_encoder) {
+    GstElement *convert = g.make("videoconvert");
+    GstElement *caps = g.caps("video/x-raw,format=I420");
+    if (hw_encoder) {
+        GstElement *enc = g.make("v4l2h264enc");
+        g.set(enc, "extra-controls", "controls,video_bitrate=" + std::to_string(config.sub_bitrate_kbps * 1000));
+        GstElement *level = g.caps("video/x-h264,level=(string)4");
+        g.chain({upstream, convert, caps, enc, level});
+        encodedTail(g, level, "sub_sink");
+        return;
+    }
+    GstElement *enc = g.make("x264enc");
+    g.set(enc, "speed-preset", "ultrafast");
+    g.set(enc, "tune", "zerolatency");
+    g.set(enc, "bitrate", config.sub_bitrate_kbps);
+    g.set(enc, "threads", 2);
+    g.chain({upstream, convert, caps, enc});
+    encodedTail(g, enc, "sub_sink");
 }
 
-std::string buildPipelineString(const PipelineManager::PipelineConfig& config) {
-    const std::string base_caps =
-        "video/x-raw,width=" + std::to_string(config.width) +
-        ",height=" + std::to_string(config.height) +
-        ",framerate=" + std::to_string(config.framerate_num) +
-        "/" + std::to_string(config.framerate_den);
+// Branches fed from downscaled frames: the AI appsink and, when enabled,
+// the sub-stream. With sub_share_ai both hang off the AI's videoscale, so
+// the detector keeps its full input size and the sub-stream is made from
+// the AI-sized frames: no scaling of its own when the sizes match, else
+// only a small one instead of a second pass over the camera frame.
+void scaledBranches(GraphBuilder& g, GstElement *tee, const PipelineManager::PipelineConfig& config, bool hw_encoder) {
     const std::string ai_caps =
         "video/x-raw,format=RGB,width=" + std::to_string(config.ai_width) +
         ",height=" + std::to_string(config.ai_height);
+    const std::string sub_caps =
+        "video/x-raw,width=" + std::to_string(config.sub_width) +
+        ",height=" + std::to_string(config.sub_height);
+    const std::string ai_scaled_caps =
+        "video/x-raw,width=" + std::to_string(config.ai_width) +
+        ",height=" + std::to_string(config.ai_height);
 
-    const std::string dmabuf_pipeline =
-        "libcamerasrc ! " + base_caps + ",format=NV12 ! tee name=t "
-        "t. ! queue max-size-buffers=" + std::to_string(config.stream_queue_max) + " leaky=downstream ! "
-        "v4l2convert output-io-mode=dmabuf-import ! video/x-raw,format=NV12 ! "
-        "v4l2h264enc output-io-mode=dmabuf-import ! h264parse config-interval=1 ! "
-        "video/x-h264,stream-format=byte-stream ! udpsink host=127.0.0.1 port=" + std::to_string(config.stream_port) + " sync=false async=false "
-        "t. ! queue leaky=downstream max-size-buffers=" + std::to_string(config.ai_queue_max) + " ! videoscale ! videoconvert ! "
-        + ai_caps + " ! appsink name=ncnn_sink sync=false async=false emit-signals=true";
-
-    const std::string dmabuf_direct_pipeline =
-        "libcamerasrc ! " + base_caps + ",format=NV12 ! tee name=t "
-        "t. ! queue max-size-buffers=" + std::to_string(config.stream_queue_max) + " leaky=downstream ! "
-        "v4l2h264enc output-io-mode=dmabuf-import ! h264parse config-interval=1 ! "
-        "video/x-h264,stream-format=byte-stream ! udpsink host=127.0.0.1 port=" + std::to_string(config.stream_port) + " sync=false async=false "
-        "t. ! queue leaky=downstream max-size-buffers=" + std::to_string(config.ai_queue_max) + " ! videoscale ! videoconvert ! "
-        + ai_caps + " ! appsink name=ncnn_sink sync=false async=false emit-signals=true";
-
-    const std::string software_pipeline =
-        "libcamerasrc ! " + base_caps + " ! tee name=t "
-        "t. ! queue max-size-buffers=" + std::to_string(config.stream_queue_max) + " leaky=downstream ! "
-        "videoconvert ! video/x-raw,format=BGRx ! cairooverlay name=osd ! videoconvert ! video/x-raw,format=I420 ! "
-        "x264enc speed-preset=ultrafast tune=zerolatency bitrate=1000 threads=4 ! h264parse config-interval=1 ! "
-        "video/x-h264,stream-format=byte-stream ! udpsink host=127.0.0.1 port=" + std::to_string(config.stream_port) + " sync=false async=false "
-        "t. ! queue leaky=downstream max-size-buffers=" + std::to_string(config.ai_queue_max) + " ! videoscale ! videoconvert ! "
-        + ai_caps + " ! appsink name=ncnn_sink sync=false async=false emit-signals=true";
+    const bool share = config.sub_enabled && config.sub_share_ai;
+    GstElement *ai_queue = leakyQueue(g, config.ai_queue_max, "ai_q");
+    GstElement *ai_scale = share ? nullptr : g.make("videoscale");
+    GstElement *ai_convert = g.make("videoconvert");
+    GstElement *ai_filter = g.caps(ai_caps);
+    GstElement *ai_sink = appSink(g, "ncnn_sink");
+    if (share) {
+        g.chain({ai_queue, ai_convert, ai_filter, ai_sink});
+    } else {
+        g.chain({ai_queue, ai_scale, ai_convert, ai_filter, ai_sink});
+    }
 
-    if (config.useDmabuf && config.useDirect) {
-        return dmabuf_direct_pipeline;
+    if (!config.sub_enabled) {
+        g.chain({tee, ai_queue});
+        return;
     }
-    if (config.useDmabuf) {
-        return dmabuf_pipeline;
+    GstElement *sub_queue = leakyQueue(g, config.stream_queue_max);
+    if (share) {
+        GstElement *queue = leakyQueue(g, config.stream_queue_max);
+        GstElement *scale = g.make("videoscale");
+        GstElement *scaled = g.caps(ai_scaled_caps);
+        GstElement *split = g.make("tee", "st");
+        g.chain({tee, queue, scale, scaled, split});
+        g.chain({split, ai_queue});
+        g.chain({split, sub_queue});
+        if (config.sub_width == config.ai_width && config.sub_height == config.ai_height) {
+            subEncoder(g, sub_queue, config, hw_encoder);
+            return;
+        }
+        GstElement *sub_scale = g.make("videoscale");
+        GstElement *sub_filter = g.caps(sub_caps);
+        g.chain({sub_queue, sub_scale, sub_filter});
+        subEncoder(g, sub_filter, config, hw_encoder);
+        return;
     }
-    return software_pipeline;
+    g.chain({tee, ai_queue});
+    GstElement *sub_scale = g.make("videoscale");
+    GstElement *sub_filter = g.caps(sub_caps);
+    g.chain({tee, sub_queue, sub_scale, sub_filter});
+    subEncoder(g, sub_filter, config, hw_encoder);
 }
 
 }
 
-PipelineManager::PipelineManager() {}
+PipelineManager::PipelineManager(ObjectDetector& detector, int camera_index, const std::string& camera_name)
+    : detector(detector), camera_index(camera_index), camera_name(camera_name) {
+    detector.addResultListener([this](const DetectionFrame& frame) { osd_history.push(frame); });
+}
 
 PipelineManager::~PipelineManager() {
     stop();
 }
 
-void PipelineManager::draw_overlay(cairo_t *cr) {
-    std::vector<Detection> dets = detector.getDetections();
-
-    cairo_surface_t* surface = cairo_get_target(cr);
-    if (surface && cairo_surface_get_type(surface) == CAIRO_SURFACE_TYPE_IMAGE) {
-        overlay_width = cairo_image_surface_get_width(surface);
-        overlay_height = cairo_image_surface_get_height(surface);
-    }
-    
-    // 设置字体和基础绘图属性
-    cairo_select_font_face(cr, "Sans", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
-    cairo_set_font_size(cr, 20.0);
-    cairo_set_line_width(cr, 3.0);
-
-    for (const auto& det : dets) {
-        int x = det.x;
-        int y = det.y;
-        int w = det.w;
-        int h = det.h;
-        if (w <= 0 || h <= 0) continue;
-
-        int max_w = overlay_width > 0 ? overlay_width : 640;
-        int max_h = overlay_height > 0 ? overlay_height : 480;
-        x = std::max(0, std::min(x, max_w - 1));
-        y = std::max(0, std::min(y, max_h - 1));
-        w = std::min(w, max_w - x);
-        h = std::min(h, max_h - y);
-        if (w <= 0 || h <= 0) continue;
-
-        // 画绿色边框
-        cairo_set_source_rgb(cr, 0.0, 1.0, 0.0); 
-        cairo_rectangle(cr, x, y, w, h);
-        cairo_stroke(cr);
-        
-        // 写标签背景
-        int label_x = x;
-        int label_y = std::max(0, y - 25);
-        int label_w = std::min(100, max_w - label_x);
-        if (label_w <= 0) continue;
-        cairo_rectangle(cr, label_x, label_y, label_w, 25);
-        cairo_fill(cr);
-
-        // 写白色文字
-        cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
-        cairo_move_to(cr, label_x + 5, label_y + 20);
-        cairo_show_text(cr, det.label.c_str());
+GstPadProbeReturn PipelineManager::draw_overlay(GstPad *pad, GstPadProbeInfo *info) {
+    // Boxes come from the result matching this frame's PTS, extrapolated
+    // to it, rather than whatever inference finished last.
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    uint64_t pts = GST_BUFFER_PTS(buffer) == GST_CLOCK_TIME_NONE
+                       ? DetectionFrame::kNoPts
+                       : static_cast<uint64_t>(GST_BUFFER_PTS(buffer));
+    osd_history.lookup(pts, osd_dets);
+    if (osd_dets.empty() && !roi_meta_enabled && !roi_hold_enabled) return GST_PAD_PROBE_OK;
+
+    GstCaps *caps = gst_pad_get_current_caps(pad);
+    if (!caps) return GST_PAD_PROBE_OK;
+    if (caps != osd_caps) {
+        osd_format_ok = gst_video_info_from_caps(&osd_info, caps) &&
+                        (GST_VIDEO_INFO_FORMAT(&osd_info) == GST_VIDEO_FORMAT_NV12 ||
+                         GST_VIDEO_INFO_FORMAT(&osd_info) == GST_VIDEO_FORMAT_I420);
+        if (osd_caps) gst_caps_unref(osd_caps);
+        osd_caps = gst_caps_ref(caps);
+        if (!osd_format_ok) {
+            std::cerr << "[Warning] OSD needs NV12/I420 on the stream branch, overlay disabled." << std::endl;
+        }
+    }
+    gst_caps_unref(caps);
+    if (!osd_format_ok) return GST_PAD_PROBE_OK;
+
+    // The tee shares each camera buffer with the AI branch. Only the
+    // software encoder can take a private system-memory copy; the zero-copy
+    // paths draw only into buffers this branch already owns.
+    if (!gst_buffer_is_writable(buffer)) {
+        if (!osd_copy_allowed) return GST_PAD_PROBE_OK;
+        buffer = gst_buffer_make_writable(buffer);
+        GST_PAD_PROBE_INFO_DATA(info) = buffer;
+    }
+
+    GstVideoFrame frame;
+    if (!gst_video_frame_map(&frame, &osd_info, buffer, GST_MAP_WRITE)) return GST_PAD_PROBE_OK;
+    OsdYuvTarget target;
+    target.width = GST_VIDEO_FRAME_WIDTH(&frame);
+    target.height = GST_VIDEO_FRAME_HEIGHT(&frame);
+    target.y = static_cast<uint8_t*>(GST_VIDEO_FRAME_PLANE_DATA(&frame, 0));
+    target.yStride = GST_VIDEO_FRAME_PLANE_STRIDE(&frame, 0);
+    target.uvStride = GST_VIDEO_FRAME_PLANE_STRIDE(&frame, 1);
+    if (GST_VIDEO_FRAME_FORMAT(&frame) == GST_VIDEO_FORMAT_NV12) {
+        target.interleaved = true;
+        target.u = static_cast<uint8_t*>(GST_VIDEO_FRAME_PLANE_DATA(&frame, 1));
+        target.v = target.u + 1;
+    } else {
+        target.u = static_cast<uint8_t*>(GST_VIDEO_FRAME_PLANE_DATA(&frame, 1));
+        target.v = static_cast<uint8_t*>(GST_VIDEO_FRAME_PLANE_DATA(&frame, 2));
+    }
+    // ROI pass runs before drawing so burned-in labels never become part
+    // of the held background.
+    if (roi_meta_enabled || roi_hold_enabled) {
+        const std::vector<OsdRect>& rois = roi_hold_enabled ? roi_filter.process(target, osd_dets)
+                                                            : roiRects(osd_dets, target.width, target.height);
+        for (size_t i = 0; roi_meta_enabled && i < rois.size(); ++i) {
+            const OsdRect& r = rois[i];
+            GstVideoRegionOfInterestMeta *meta =
+                gst_buffer_add_video_region_of_interest_meta(buffer, "object", r.x, r.y, r.w, r.h);
+            gst_video_region_of_interest_meta_add_param(
+                meta, gst_structure_new("roi/vaapi", "delta-qp", G_TYPE_INT, roi_delta_qp, NULL));
+        }
+        if (roi_hold_enabled && getRuntimeConfig().debug && ++roi_frames % 150 == 0) {
+            std::cout << "\n[ROI] held " << roi_filter.heldBlocks() << "/" << roi_filter.totalBlocks()
+                      << " background blocks" << std::endl;
+        }
+    }
+    if (osd_draw_enabled && !osd_dets.empty()) {
+        stage_profiler::Scope scope(kStageOsd);
+        osd.drawYuv(target, osd_dets);
     }
+    gst_video_frame_unmap(&frame);
+    return GST_PAD_PROBE_OK;
 }
 
 gboolean PipelineManager::on_bus_message(GstBus *bus, GstMessage *message, gpointer user_data) {
     auto* self = static_cast<PipelineManager*>(user_data);
-    if (GST_MESSAGE_TYPE(message) == GST_MESSAGE_ERROR && self->use_dmabuf_config && self->dmabuf_active) {
-        const RuntimeConfig& runtime = getRuntimeConfig();
-        bool debug = runtime.debug;
+    if (GST_MESSAGE_TYPE(message) == GST_MESSAGE_QOS) {
+        self->qos_events++;
+        return TRUE;
+    }
+    if (GST_MESSAGE_TYPE(message) == GST_MESSAGE_ERROR) {
         GError *err = nullptr;
         gchar *dbg = nullptr;
         gst_message_parse_error(message, &err, &dbg);
         std::string msg = err ? err->message : "";
         const char* src_name = GST_MESSAGE_SRC(message) ? GST_OBJECT_NAME(GST_MESSAGE_SRC(message)) : "unknown";
-        if (err) g_error_free(err);
-        if (dbg) g_free(dbg);
-
-        if (debug) {
-            std::cout << "[NanoStream] DMABUF error from " << src_name << ": " << msg << std::endl;
+        if (getRuntimeConfig().debug && dbg) {
+            std::cout << "[NanoStream] Error detail from " << src_name << ": " << dbg << std::endl;
         }
-        if (!self->dmabuf_direct_tried) {
-            std::cout << "[NanoStream] DMABUF runtime failure detected, switching to direct DMABUF pipeline." << std::endl;
-            self->dmabuf_direct_tried = true;
-            self->rebuildDmabufDirectPipeline();
+        if (self->stream_branch_failed) {
+            self->failStreamBranch(std::string(src_name) + ": " + msg);
         } else {
-            std::cout << "[NanoStream] DMABUF runtime failure detected, switching to software pipeline." << std::endl;
-            self->dmabuf_active = false;
-            self->dmabuf_disabled = true;
-            std::cout << "[NanoStream] DMABUF disabled on this platform. Use NANOSTREAM_DMABUF=0." << std::endl;
-            writeDmabufDisableFlag();
-            self->rebuildSoftwarePipeline();
+            std::cerr << "[Error] " << src_name << ": " << msg << std::endl;
         }
+        if (err) g_error_free(err);
+        if (dbg) g_free(dbg);
     }
     return TRUE;
 }
 
+// Runs on the thread that posts the message, so the tee stops feeding a
+// failed stream branch before the main loop gets to it.
+GstBusSyncReply PipelineManager::on_bus_sync(GstBus *bus, GstMessage *message, gpointer user_data) {
+    auto* self = static_cast<PipelineManager*>(user_data);
+    if (GST_MESSAGE_TYPE(message) == GST_MESSAGE_STREAM_STATUS) {
+        GstStreamStatusType status;
+        GstElement *owner = nullptr;
+        gst_message_parse_stream_status(message, &status, &owner);
+        if (status == GST_STREAM_STATUS_TYPE_ENTER) placeStreamingThread(owner);
+        return GST_BUS_PASS;
+    }
+    if (GST_MESSAGE_TYPE(message) != GST_MESSAGE_ERROR) return GST_BUS_PASS;
+    // Only compared by address, never dereferenced, so a branch being
+    // removed on the main loop is harmless here.
+    GstObject *branch = reinterpret_cast<GstObject*>(self->stream_branch.load());
+    if (branch && GST_MESSAGE_SRC(message) && gst_object_has_as_ancestor(GST_MESSAGE_SRC(message), branch)) {
+        self->stream_branch_failed = true;
+    }
+    return GST_BUS_PASS;
+}
+
+// STREAM_STATUS ENTER is posted from the new streaming thread itself. The
+// AI queue's thread (scale/convert for the detector) joins the AI cores;
+// capture and encode threads get the stream cores and SCHED_FIFO.
+void PipelineManager::placeStreamingThread(GstElement *owner) {
+    const RuntimeConfig& runtime = getRuntimeConfig();
+    const char *name = owner ? GST_OBJECT_NAME(owner) : "unknown";
+    const bool ai = std::string(name) == "ai_q";
+    if (ai) {
+        thread_topology::pinCurrentThread(thread_topology::parseCpuList(runtime.cpuAi));
+        if (runtime.aiNice != 0) thread_topology::setCurrentThreadNice(runtime.aiNice);
+    } else {
+        thread_topology::pinCurrentThread(thread_topology::parseCpuList(runtime.cpuStream));
+        thread_topology::setCurrentThreadFifo(runtime.streamRtPriority);
+    }
+    std::cout << "[Topology] " << (ai ? "ai" : "stream") << " thread (" << name << "): "
+              << thread_topology::describeCurrentThread() << std::endl;
+}
+
 void PipelineManager::setAIThrottle(int sleep_ms, bool paused) {
     detector.setThrottle(sleep_ms, paused);
+    if (paused) osd_history.clear();
 }
 
-static void on_draw_wrapper(GstElement *overlay, cairo_t *cr, guint64 timestamp, guint64 duration, gpointer user_data) {
-    static_cast<PipelineManager*>(user_data)->draw_overlay(cr);
+void PipelineManager::addDetectionListener(ObjectDetector::ResultListener listener) {
+    detector.addResultListener(std::move(listener));
 }
 
-bool PipelineManager::applyPipeline(const std::string& pipeline_desc) {
-    GError *error = nullptr;
-    pipeline = gst_parse_launch(pipeline_desc.c_str(), &error);
-    if (error) {
-        std::cerr << "[Error] " << error->message << std::endl;
-        g_error_free(error);
-        return false;
+void PipelineManager::setEncodedListener(StreamProfile profile, EncodedListener listener) {
+    encoded_listeners[static_cast<int>(profile)] = std::move(listener);
+}
+
+void PipelineManager::requestKeyframe(StreamProfile profile) {
+    if (!pipeline) return;
+    const char *name = profile == StreamProfile::Sub ? "sub_sink" : "stream_sink";
+    GstElement *sink = gst_bin_get_by_name(GST_BIN(pipeline), name);
+    if (!sink) return;
+    gst_element_send_event(sink, gst_video_event_new_upstream_force_key_unit(GST_CLOCK_TIME_NONE, TRUE, 0));
+    gst_object_unref(sink);
+}
+
+GstPadProbeReturn PipelineManager::on_osd_probe_wrapper(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    return static_cast<PipelineManager*>(user_data)->draw_overlay(pad, info);
+}
+
+GstPadProbeReturn PipelineManager::on_share_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    static_cast<PipelineManager*>(user_data)->shareCameraFrame(pad, GST_PAD_PROBE_INFO_BUFFER(info));
+    return GST_PAD_PROBE_OK;
+}
+
+// Camera frames are copied once, before the tee, into the shared ring;
+// the buffer itself is only read.
+void PipelineManager::shareCameraFrame(GstPad *pad, GstBuffer *buffer) {
+    GstCaps *caps = gst_pad_get_current_caps(pad);
+    if (!caps) return;
+    if (caps != share_caps) {
+        share_format = frame_share::kFormatNone;
+        if (gst_video_info_from_caps(&share_info, caps)) {
+            if (GST_VIDEO_INFO_FORMAT(&share_info) == GST_VIDEO_FORMAT_NV12) share_format = frame_share::kFormatNV12;
+            if (GST_VIDEO_INFO_FORMAT(&share_info) == GST_VIDEO_FORMAT_I420) share_format = frame_share::kFormatI420;
+        }
+        if (share_caps) gst_caps_unref(share_caps);
+        share_caps = gst_caps_ref(caps);
+        if (share_format == frame_share::kFormatNone) {
+            std::cerr << "[Warning] Frame sharing needs NV12/I420 camera frames, camera channel idle." << std::endl;
+        }
     }
+    gst_caps_unref(caps);
+    if (share_format == frame_share::kFormatNone) return;
 
-    GstElement *osd = gst_bin_get_by_name(GST_BIN(pipeline), "osd");
-    if (osd) {
-        g_signal_connect(osd, "draw", G_CALLBACK(on_draw_wrapper), this);
-        gst_object_unref(osd);
+    GstVideoFrame frame;
+    if (!gst_video_frame_map(&frame, &share_info, buffer, GST_MAP_READ)) return;
+    const int planes = share_format == frame_share::kFormatNV12 ? 2 : 3;
+    const uint8_t *data[3] = {};
+    int strides[3] = {};
+    for (int p = 0; p < planes; ++p) {
+        data[p] = static_cast<const uint8_t*>(GST_VIDEO_FRAME_PLANE_DATA(&frame, p));
+        strides[p] = GST_VIDEO_FRAME_PLANE_STRIDE(&frame, p);
     }
+    uint64_t pts = GST_BUFFER_PTS(buffer) == GST_CLOCK_TIME_NONE
+                       ? DetectionFrame::kNoPts
+                       : static_cast<uint64_t>(GST_BUFFER_PTS(buffer));
+    frame_share.publishCamera(share_format, data, strides, GST_VIDEO_FRAME_WIDTH(&frame),
+                              GST_VIDEO_FRAME_HEIGHT(&frame), pts);
+    gst_video_frame_unmap(&frame);
+}
 
-    app_sink = gst_bin_get_by_name(GST_BIN(pipeline), "ncnn_sink");
-    if (app_sink) {
-        g_signal_connect(app_sink, "new-sample", G_CALLBACK(on_new_sample_wrapper), this);
-        gst_object_unref(app_sink);
-        app_sink = nullptr;
+bool PipelineManager::buildPipeline() {
+    const RuntimeConfig& runtime = getRuntimeConfig();
+    config.stream_delay_ms = runtime.osdDelayMs;
+    DetectionHistory::Config history_cfg;
+    history_cfg.extrapolate = runtime.osdExtrapolate;
+    history_cfg.maxExtrapolationNs = static_cast<uint64_t>(std::max(0, runtime.osdMaxExtrapolationMs)) * 1000000;
+    osd_history.configure(history_cfg);
+    config.stream_bitrate_kbps = runtime.encBitrateKbps;
+    config.encoder_threads = runtime.encThreads;
+    config.encoder_governor = runtime.encGovernor;
+    EncoderGovernor::Config enc_cfg;
+    enc_cfg.maxBitrateKbps = runtime.encBitrateKbps;
+    enc_cfg.minBitrateKbps = runtime.encMinBitrateKbps;
+    enc_cfg.maxFps = streamFps(config);
+    enc_cfg.minFps = runtime.encMinFps;
+    enc_cfg.aiLatencyBudgetMs = runtime.detLatencyBudgetMs;
+    encoder_governor.configure(enc_cfg);
+    net_adaptive = runtime.netAdaptive;
+    NetworkRateController::Config net_cfg;
+    net_cfg.maxBitrateKbps = runtime.encBitrateKbps;
+    net_cfg.minBitrateKbps = runtime.netMinBitrateKbps;
+    net_rate.configure(net_cfg);
+    config.roi_encode = runtime.roiEncode;
+    config.roi_crf = runtime.roiCrf;
+    RoiEncodeFilter::Config roi_cfg;
+    roi_cfg.staticThreshold = runtime.roiStaticThreshold;
+    roi_cfg.margin = runtime.roiMargin;
+    roi_cfg.maxHoldFrames = runtime.roiMaxHold;
+    roi_filter.configure(roi_cfg);
+    roi_delta_qp = runtime.roiDeltaQp;
+    config.sub_enabled = runtime.subEnabled;
+    config.sub_width = runtime.subWidth;
+    config.sub_height = runtime.subHeight;
+    config.sub_bitrate_kbps = runtime.subBitrateKbps;
+    // Cascade and adaptive input scale the AI frames to other sizes, so
+    // only the fixed-size detector lends its scaler to the sub-stream, and
+    // only to one no larger than its frames.
+    config.sub_share_ai = runtime.subShareAi && !runtime.detCascade && !runtime.detAdaptiveInput &&
+                          config.sub_width <= config.ai_width && config.sub_height <= config.ai_height;
+    if (runtime.detCascade) {
+        // Cascade ROIs are cropped from the AI frame, so feed it at full
+        // capture resolution and let the detector do the coarse resize.
+        config.ai_width = config.width;
+        config.ai_height = config.height;
+    } else if (runtime.detAdaptiveInput && !runtime.detInputSteps.empty()) {
+        // Scale once to the largest step; the detector resizes down per
+        // frame, so switching sizes never renegotiates the appsink caps.
+        int max_step = *std::max_element(runtime.detInputSteps.begin(), runtime.detInputSteps.end());
+        config.ai_width = max_step;
+        config.ai_height = max_step;
+    }
+    if (runtime.shareEnabled && !frame_share.active()) {
+        FrameSharePublisher::Config share_cfg;
+        share_cfg.socketPath = runtime.shareSocket;
+        if (camera_index > 0) share_cfg.socketPath += "." + std::to_string(camera_index);
+        share_cfg.slots = runtime.shareSlots;
+        if (runtime.shareCamera) {
+            share_cfg.cameraWidth = config.width;
+            share_cfg.cameraHeight = config.height;
+        }
+        if (runtime.shareAiInput) {
+            share_cfg.aiWidth = config.ai_width;
+            share_cfg.aiHeight = config.ai_height;
+        }
+        if (frame_share.start(share_cfg)) {
+            detector.addResultListener([this](const DetectionFrame& frame) { frame_share.publishDetections(frame); });
+        }
     }
 
-    if (!bus) {
-        bus = gst_element_get_bus(pipeline);
-        gst_bus_add_watch(bus, on_bus_message, this);
+    StreamMode mode = runtime.useDmabuf ? StreamMode::DmabufConvert : StreamMode::Software;
+    while (mode != StreamMode::Software && !streamModeUsable(mode)) mode = static_cast<StreamMode>(static_cast<int>(mode) + 1);
+    if (runtime.useDmabuf && mode == StreamMode::Software) {
+        std::cout << "[NanoStream] No dmabuf-import support on this platform, using software pipeline." << std::endl;
     }
+    if (!constructPipeline(mode)) return false;
 
     return true;
 }
 
-bool PipelineManager::buildPipeline() {
-    const RuntimeConfig& runtime = getRuntimeConfig();
-    bool use_dmabuf = runtime.useDmabuf;
-    use_dmabuf_config = use_dmabuf;
-    dmabuf_direct_tried = false;
-    config.useDmabuf = use_dmabuf;
-    config.useDirect = false;
-    if (use_dmabuf) {
-        std::ifstream flag(getDmabufDisableFlagPath());
-        if (flag.good()) {
-            dmabuf_disabled = true;
-        }
+bool PipelineManager::streamModeUsable(StreamMode mode) const {
+    return !stream_mode_failed[static_cast<int>(mode)] && streamModeSupported(mode);
+}
+
+// Source, tee and the scaled branches; the stream branch is added on top
+// so it can be replaced on its own later.
+bool PipelineManager::constructPipeline(StreamMode mode) {
+    const bool hw = mode != StreamMode::Software;
+    std::cout << "[NanoStream] Building pipeline (camera " << camera_index << ", "
+              << streamModeName(mode) << " stream branch)..." << std::endl;
+    const std::string name = camera_index > 0 ? "nanostream-cam" + std::to_string(camera_index) : "nanostream";
+    pipeline = gst_pipeline_new(name.c_str());
+    GraphBuilder g(GST_BIN(pipeline));
+    GstElement *src = g.make("libcamerasrc");
+    if (src && !camera_name.empty()) g_object_set(src, "camera-name", camera_name.c_str(), NULL);
+    GstElement *src_caps = g.caps("video/x-raw,width=" + std::to_string(config.width) +
+                                  ",height=" + std::to_string(config.height) +
+                                  ",framerate=" + std::to_string(config.framerate_num) + "/" +
+                                  std::to_string(config.framerate_den) + (hw ? ",format=NV12" : ""));
+    GstElement *tee = g.make("tee", "t");
+    g.chain({src, src_caps, tee});
+    scaledBranches(g, tee, config, hw && probeHardwareCaps().v4l2Encoder);
+    if (!g.ok()) {
+        std::cerr << "[Error] Pipeline: " << g.error() << std::endl;
+        gst_object_unref(pipeline);
+        pipeline = nullptr;
+        return false;
     }
-    if (use_dmabuf && dmabuf_disabled) {
-        std::cout << "[NanoStream] DMABUF disabled on this platform, using software pipeline." << std::endl;
-        use_dmabuf = false;
+    stream_tee = tee;
+
+    if (frame_share.active()) {
+        GstPad *tee_pad = gst_element_get_static_pad(tee, "sink");
+        gst_pad_add_probe(tee_pad, GST_PAD_PROBE_TYPE_BUFFER, on_share_probe, this, nullptr);
+        gst_object_unref(tee_pad);
+    }
+    GstElement *sub_sink = gst_bin_get_by_name(GST_BIN(pipeline), "sub_sink");
+    if (sub_sink) {
+        g_signal_connect(sub_sink, "new-sample", G_CALLBACK(on_sub_sample_wrapper), this);
+        gst_object_unref(sub_sink);
     }
-    return buildPipelineInternal(use_dmabuf, false);
+    GstElement *ai_sink = gst_bin_get_by_name(GST_BIN(pipeline), "ncnn_sink");
+    g_signal_connect(ai_sink, "new-sample", G_CALLBACK(on_new_sample_wrapper), this);
+    GstPad *ai_pad = gst_element_get_static_pad(ai_sink, "sink");
+    gst_pad_add_probe(ai_pad, GST_PAD_PROBE_TYPE_QUERY_DOWNSTREAM, aligned_video_pool::allocationProbe,
+                      GUINT_TO_POINTER(kAiPoolMinBuffers), nullptr);
+    gst_object_unref(ai_pad);
+    gst_object_unref(ai_sink);
+
+    bus = gst_element_get_bus(pipeline);
+    gst_bus_add_watch(bus, on_bus_message, this);
+    gst_bus_set_sync_handler(bus, on_bus_sync, this, nullptr);
+    if (!stream_watch_id) stream_watch_id = g_timeout_add(250, on_stream_watch, this);
+
+    if (insertStreamBranch(mode)) return true;
+    resetPipeline();
+    return false;
 }
 
-bool PipelineManager::buildPipelineInternal(bool use_dmabuf, bool use_direct) {
+// Adds the stream branch for the first usable mode at or below `mode` and
+// links it to a new tee pad. Also used on a playing pipeline during failover.
+bool PipelineManager::insertStreamBranch(StreamMode mode) {
+    GstElement *branch = nullptr;
+    for (; mode <= StreamMode::Software; mode = static_cast<StreamMode>(static_cast<int>(mode) + 1)) {
+        if (!streamModeUsable(mode)) continue;
+        std::string error;
+        branch = makeStreamBranch(config, mode, error);
+        if (branch) {
+            gst_bin_add(GST_BIN(pipeline), branch);
+            if (gst_element_link(stream_tee, branch)) break;
+            gst_bin_remove(GST_BIN(pipeline), branch);
+            branch = nullptr;
+            error = "cannot link to tee";
+        }
+        std::cout << "[NanoStream] " << streamModeName(mode) << " stream branch unavailable: " << error << std::endl;
+        stream_mode_failed[static_cast<int>(mode)] = true;
+    }
+    if (!branch) return false;
+
+    GstPad *branch_pad = gst_element_get_static_pad(branch, "sink");
+    gst_pad_set_element_private(branch_pad, this);
+    gst_pad_set_chain_function(branch_pad, on_stream_branch_chain);
+    gst_pad_set_chain_list_function(branch_pad, on_stream_branch_chain_list);
+    stream_tee_pad = gst_pad_get_peer(branch_pad);
+    gst_object_unref(branch_pad);
+    gst_pad_add_probe(stream_tee_pad, GST_PAD_PROBE_TYPE_BUFFER, on_stream_gate, this, nullptr);
+    stream_mode = mode;
+    stream_branch_failed = false;
+    stream_branch = branch;
+    branch_started_us = g_get_monotonic_time();
+
+    // Background hold writes every block on the CPU; only worth it in
+    // front of x264. ROI meta only goes to encoders that read it. Only the
+    // software encoder can take a private copy for the OSD.
     const RuntimeConfig& runtime = getRuntimeConfig();
-    PipelineConfig local_config = config;
-    local_config.useDmabuf = use_dmabuf;
-    local_config.useDirect = use_direct;
-    const std::string pipeline_desc = buildPipelineString(local_config);
-
-    if (use_dmabuf && use_direct) {
-        std::cout << "[NanoStream] Launching DMABUF Direct Pipeline..." << std::endl;
-    } else if (use_dmabuf) {
-        std::cout << "[NanoStream] Launching DMABUF Zero-Copy Pipeline..." << std::endl;
-    } else {
-        std::cout << "[NanoStream] Launching Stabilized OSD Engine (Software)..." << std::endl;
+    const bool software = mode == StreamMode::Software;
+    osd_copy_allowed = software;
+    encoder_is_x264 = software;
+    GstElement *enc = gst_bin_get_by_name(GST_BIN(branch), "enc");
+    roi_meta_enabled = runtime.roiEncode && encoderUsesRoiMeta(enc);
+    roi_hold_enabled = runtime.roiEncode && software;
+    if (runtime.roiEncode && !roi_meta_enabled) {
+        GstElementFactory *factory = enc ? gst_element_get_factory(enc) : nullptr;
+        std::cout << "[ROI] " << (factory ? GST_OBJECT_NAME(factory) : "encoder")
+                  << " ignores ROI meta, NANOSTREAM_ROI_DELTA_QP inactive"
+                  << (roi_hold_enabled ? "; background hold only" : "; no ROI encoding on this path") << std::endl;
     }
+    if (enc) gst_object_unref(enc);
 
-    GError *error = nullptr;
-    bool dmabuf_fallback = false;
-    if (!applyPipeline(pipeline_desc)) {
-        if (use_dmabuf && !use_direct) {
-            std::cout << "[NanoStream] DMABUF pipeline failed, trying direct DMABUF pipeline." << std::endl;
-            return buildPipelineInternal(true, true);
-        }
-        if (use_dmabuf && use_direct) {
-            std::cout << "[NanoStream] DMABUF pipeline failed, falling back to software pipeline." << std::endl;
-            dmabuf_fallback = true;
-            dmabuf_disabled = true;
-            PipelineConfig software_config = local_config;
-            software_config.useDmabuf = false;
-            software_config.useDirect = false;
-            const std::string software_desc = buildPipelineString(software_config);
-            if (!applyPipeline(software_desc)) {
-                return false;
-            }
-        }
-    } 
-
-    dmabuf_active = use_dmabuf && !dmabuf_fallback;
-    if (use_dmabuf) {
-        std::cout << "[NanoStream] DMABUF status: "
-                  << (dmabuf_fallback ? "fallback" : (use_direct ? "active-direct" : "active"))
-                  << " (set NANOSTREAM_DMABUF=0 to force software)" << std::endl;
-    }
-
-    if (use_dmabuf && use_direct) {
-        last_sample_us.store(0);
-        std::thread([this]() {
-            std::this_thread::sleep_for(std::chrono::seconds(3));
-            if (!use_dmabuf_config || !dmabuf_active) return;
-            long long last = last_sample_us.load();
-            if (last == 0) {
-                std::cout << "[NanoStream] DMABUF direct pipeline produced no samples, falling back to software." << std::endl;
-                dmabuf_active = false;
-                dmabuf_disabled = true;
-                writeDmabufDisableFlag();
-                rebuildSoftwarePipeline();
-            }
-        }).detach();
-    }
-
-    bool use_int8 = runtime.useInt8;
-    std::string int8_param = runtime.int8Param;
-    std::string int8_bin = runtime.int8Bin;
-    if (use_int8) {
-        std::ifstream p(int8_param);
-        std::ifstream b(int8_bin);
-        if (!p.good() || !b.good()) {
-            std::cout << "[NanoStream] INT8 model files missing, falling back to FP32." << std::endl;
-            detector.loadModel("models/nanodet_m.param", "models/nanodet_m.bin");
-        } else if (!detector.loadModel(int8_param, int8_bin)) {
-            std::cout << "[NanoStream] INT8 model load failed, falling back to FP32." << std::endl;
-            detector.loadModel("models/nanodet_m.param", "models/nanodet_m.bin");
-        } else {
-            std::cout << "[NanoStream] INT8 model active." << std::endl;
+    // With NANOSTREAM_OSD=0 frames stream untouched; clients draw boxes from
+    // the metadata feed instead.
+    osd_draw_enabled = runtime.osdEnabled;
+    if (mode == StreamMode::DmabufDirect && (runtime.osdEnabled || runtime.roiEncode)) {
+        std::cout << "[NanoStream] DMABUF direct stream branch has no OSD or ROI meta (camera buffers are read-only); "
+                  << "use NANOSTREAM_META for boxes" << std::endl;
+    }
+    GstElement *osd_elem = (runtime.osdEnabled || roi_meta_enabled || roi_hold_enabled) ? gst_bin_get_by_name(GST_BIN(branch), "osd") : nullptr;
+    if (osd_elem) {
+        GstPad *osd_pad = gst_element_get_static_pad(osd_elem, "src");
+        if (osd_pad) {
+            gst_pad_add_probe(osd_pad, GST_PAD_PROBE_TYPE_BUFFER, on_osd_probe_wrapper, this, nullptr);
+            gst_object_unref(osd_pad);
         }
-    } else {
-        detector.loadModel("models/nanodet_m.param", "models/nanodet_m.bin");
+        gst_object_unref(osd_elem);
     }
+    attachEncoderGovernor();
+    GstElement *stream_sink = gst_bin_get_by_name(GST_BIN(branch), "stream_sink");
+    g_signal_connect(stream_sink, "new-sample", G_CALLBACK(on_stream_sample_wrapper), this);
+    gst_object_unref(stream_sink);
+
+    gst_element_sync_state_with_parent(branch);
+    std::cout << "[NanoStream] Stream branch: " << streamModeName(mode) << std::endl;
     return true;
 }
 
-void PipelineManager::rebuildSoftwarePipeline() {
-    dmabuf_active = false;
-    resetPipeline();
-    buildPipelineInternal(false, false);
-    start();
+GstPadProbeReturn PipelineManager::on_stream_gate(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    auto* self = static_cast<PipelineManager*>(user_data);
+    if (self->stream_branch_failed) return GST_PAD_PROBE_DROP;
+    self->last_fed_us = g_get_monotonic_time();
+    return GST_PAD_PROBE_OK;
 }
 
-void PipelineManager::rebuildDmabufDirectPipeline() {
-    resetPipeline();
-    buildPipelineInternal(true, true);
-    start();
+// The branch's ghost sink pad chains through here in the tee's streaming
+// thread. Probes only see a buffer before it is pushed, so the push itself
+// is wrapped: a fatal flow return from the branch becomes OK before the
+// tee can pass it up to the camera source, and the branch is failed over.
+GstFlowReturn PipelineManager::on_stream_branch_chain(GstPad *pad, GstObject *parent, GstBuffer *buffer) {
+    auto* self = static_cast<PipelineManager*>(gst_pad_get_element_private(pad));
+    return self->containStreamFlow(gst_proxy_pad_chain_default(pad, parent, buffer));
+}
+
+GstFlowReturn PipelineManager::on_stream_branch_chain_list(GstPad *pad, GstObject *parent, GstBufferList *list) {
+    auto* self = static_cast<PipelineManager*>(gst_pad_get_element_private(pad));
+    return self->containStreamFlow(gst_proxy_pad_chain_list_default(pad, parent, list));
+}
+
+GstFlowReturn PipelineManager::containStreamFlow(GstFlowReturn ret) {
+    if (ret >= GST_FLOW_EOS) return ret;
+    // The bus sync handler may have marked it already; then the error
+    // message drives the swap.
+    if (!stream_branch_failed.exchange(true)) {
+        stream_flow_error = ret;
+        g_idle_add(on_stream_flow_error, this);
+    }
+    return GST_FLOW_OK;
+}
+
+gboolean PipelineManager::on_stream_flow_error(gpointer user_data) {
+    auto* self = static_cast<PipelineManager*>(user_data);
+    // A replacement branch starts unfailed, so a late call is a no-op.
+    if (self->stream_branch_failed) {
+        self->failStreamBranch(std::string("flow ") + gst_flow_get_name(self->stream_flow_error));
+    }
+    return G_SOURCE_REMOVE;
+}
+
+// Swaps only the stream branch: the tee pad is unlinked once idle and the
+// next mode's branch goes in on the main loop. Source, AI and sub-stream
+// branches keep running throughout.
+void PipelineManager::failStreamBranch(const std::string& reason) {
+    if (!pipeline || !stream_tee_pad || swap_pending) return;
+    stream_branch_failed = true;
+    stream_mode_failed[static_cast<int>(stream_mode)] = true;
+    if (stream_mode == StreamMode::Software) {
+        std::cerr << "[Error] Software stream branch failed: " << reason << std::endl;
+        return;
+    }
+    std::cout << "[NanoStream] " << streamModeName(stream_mode) << " stream branch failed (" << reason
+              << "), swapping it out." << std::endl;
+    swap_pending = true;
+    swap_started_us = g_get_monotonic_time();
+    gst_pad_add_probe(stream_tee_pad, GST_PAD_PROBE_TYPE_IDLE, on_stream_pad_idle, this, nullptr);
+}
+
+GstPadProbeReturn PipelineManager::on_stream_pad_idle(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    GstPad *peer = gst_pad_get_peer(pad);
+    if (peer) {
+        gst_pad_unlink(pad, peer);
+        gst_object_unref(peer);
+    }
+    g_idle_add(on_swap_stream_branch, user_data);
+    return GST_PAD_PROBE_REMOVE;
+}
+
+gboolean PipelineManager::on_swap_stream_branch(gpointer user_data) {
+    static_cast<PipelineManager*>(user_data)->swapStreamBranch();
+    return G_SOURCE_REMOVE;
+}
+
+void PipelineManager::swapStreamBranch() {
+    if (!swap_pending || !pipeline) return;
+    GstElement *old_branch = stream_branch.exchange(nullptr);
+    gst_element_set_state(old_branch, GST_STATE_NULL);
+    gst_bin_remove(GST_BIN(pipeline), old_branch);
+    gst_element_release_request_pad(stream_tee, stream_tee_pad);
+    gst_object_unref(stream_tee_pad);
+    stream_tee_pad = nullptr;
+    if (osd_caps) {
+        gst_caps_unref(osd_caps);
+        osd_caps = nullptr;
+    }
+
+    const bool ok = insertStreamBranch(static_cast<StreamMode>(static_cast<int>(stream_mode) + 1));
+    swap_pending = false;
+    if (!ok) {
+        std::cerr << "[Error] No stream branch left to fail over to." << std::endl;
+        return;
+    }
+    applyEncoderBitrate();
+    requestKeyframe(StreamProfile::Main);
+    std::cout << "[NanoStream] Stream branch swapped in "
+              << (g_get_monotonic_time() - swap_started_us) / 1000 << "ms." << std::endl;
+}
+
+gboolean PipelineManager::on_stream_watch(gpointer user_data) {
+    static_cast<PipelineManager*>(user_data)->checkStreamStall();
+    return G_SOURCE_CONTINUE;
+}
+
+// A hardware branch that takes frames but stops producing access units
+// counts as failed; camera stalls don't, since nothing is fed then either.
+void PipelineManager::checkStreamStall() {
+    if (!pipeline || swap_pending || stream_mode == StreamMode::Software) return;
+    if (GST_STATE(pipeline) != GST_STATE_PLAYING) {
+        branch_started_us = g_get_monotonic_time();
+        return;
+    }
+    // last_fed_us is stamped before the delay queue, so frames it holds
+    // back are not a stall.
+    const gint64 limit = kStreamStallUs + static_cast<gint64>(config.stream_delay_ms) * 1000;
+    const gint64 encoded = last_encoded_us.load();
+    const gint64 fed = last_fed_us.load();
+    if (encoded > branch_started_us ? fed - encoded > limit : fed - branch_started_us > limit + kStreamStartGraceUs) {
+        failStreamBranch("no encoded output for " +
+                         std::to_string((fed - std::max(encoded, branch_started_us)) / 1000) + "ms");
+    }
 }
 
 void PipelineManager::start() {
@@ -314,6 +796,14 @@ void PipelineManager::start() {
 }
 
 void PipelineManager::stop() {
+    if (encoder_tick_id) {
+        g_source_remove(encoder_tick_id);
+        encoder_tick_id = 0;
+    }
+    if (stream_watch_id) {
+        g_source_remove(stream_watch_id);
+        stream_watch_id = 0;
+    }
     resetPipeline();
 }
 
@@ -324,48 +814,238 @@ void PipelineManager::resetPipeline() {
             gst_object_unref(bus);
             bus = nullptr;
         }
+        if (stream_tee_pad) gst_object_unref(stream_tee_pad);
         gst_object_unref(pipeline);
         pipeline = nullptr;
     }
-    caps_logged = false;
+    stream_tee = nullptr;
+    stream_tee_pad = nullptr;
+    stream_branch = nullptr;
+    swap_pending = false;
+    if (osd_caps) {
+        gst_caps_unref(osd_caps);
+        osd_caps = nullptr;
+    }
+    if (share_caps) {
+        gst_caps_unref(share_caps);
+        share_caps = nullptr;
+    }
+    if (ai_caps) {
+        gst_caps_unref(ai_caps);
+        ai_caps = nullptr;
+    }
+}
+
+// Probes only exist on the software pipeline (named x264enc); hardware
+// encoders run off the CPU and keep their fixed settings.
+void PipelineManager::attachEncoderGovernor() {
+    if (!config.encoder_governor) return;
+    GstElement *enc = gst_bin_get_by_name(GST_BIN(pipeline), "enc");
+    GstElement *queue = gst_bin_get_by_name(GST_BIN(pipeline), "stream_q");
+    if (enc && queue) {
+        GstPad *queue_in = gst_element_get_static_pad(queue, "sink");
+        gst_pad_add_probe(queue_in, GST_PAD_PROBE_TYPE_BUFFER, on_stream_in_probe, this, nullptr);
+        gst_object_unref(queue_in);
+        g_signal_connect(queue, "overrun", G_CALLBACK(on_stream_overrun), this);
+
+        GstPad *enc_in = gst_element_get_static_pad(enc, "sink");
+        GstPad *enc_out = gst_element_get_static_pad(enc, "src");
+        gst_pad_add_probe(enc_in, GST_PAD_PROBE_TYPE_BUFFER, on_encoder_in_probe, this, nullptr);
+        gst_pad_add_probe(enc_out, GST_PAD_PROBE_TYPE_BUFFER, on_encoder_out_probe, this, nullptr);
+        gst_object_unref(enc_in);
+        gst_object_unref(enc_out);
+
+        if (!encoder_tick_id) encoder_tick_id = g_timeout_add_seconds(1, on_encoder_tick, this);
+        std::cout << "[Encoder] Governor active: " << encoder_governor.bitrateKbps() << "kbps @ "
+                  << encoder_governor.fps() << "fps, " << config.encoder_threads << " threads" << std::endl;
+    }
+    if (enc) gst_object_unref(enc);
+    if (queue) gst_object_unref(queue);
+}
+
+GstPadProbeReturn PipelineManager::on_stream_in_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    static_cast<PipelineManager*>(user_data)->enc_frames_in++;
+    return GST_PAD_PROBE_OK;
+}
+
+void PipelineManager::on_stream_overrun(GstElement *queue, gpointer user_data) {
+    // A leaky queue signals overrun each time it is about to drop a buffer.
+    static_cast<PipelineManager*>(user_data)->enc_dropped++;
+}
+
+GstPadProbeReturn PipelineManager::on_encoder_in_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    auto* self = static_cast<PipelineManager*>(user_data);
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    std::lock_guard<std::mutex> lock(self->enc_pending_mutex);
+    self->enc_pending_pts[self->enc_pending_next] = GST_BUFFER_PTS(buffer);
+    self->enc_pending_at[self->enc_pending_next] = g_get_monotonic_time();
+    self->enc_pending_next = (self->enc_pending_next + 1) % 8;
+    return GST_PAD_PROBE_OK;
+}
+
+GstPadProbeReturn PipelineManager::on_encoder_out_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    auto* self = static_cast<PipelineManager*>(user_data);
+    GstClockTime pts = GST_BUFFER_PTS(GST_PAD_PROBE_INFO_BUFFER(info));
+    const gint64 now = g_get_monotonic_time();
+    std::lock_guard<std::mutex> lock(self->enc_pending_mutex);
+    for (int i = 0; i < 8; ++i) {
+        if (self->enc_pending_at[i] && self->enc_pending_pts[i] == pts) {
+            self->enc_time_us += now - self->enc_pending_at[i];
+            self->enc_frames++;
+            self->enc_pending_at[i] = 0;
+            break;
+        }
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+gboolean PipelineManager::on_encoder_tick(gpointer user_data) {
+    static_cast<PipelineManager*>(user_data)->tickEncoderGovernor();
+    return G_SOURCE_CONTINUE;
+}
+
+void PipelineManager::tickEncoderGovernor() {
+    EncoderGovernor::Sample sample;
+    const int frames = enc_frames.exchange(0);
+    const long long time_us = enc_time_us.exchange(0);
+    sample.encodeMs = frames > 0 ? time_us / 1000.0 / frames : 0.0;
+    sample.framesIn = enc_frames_in.exchange(0);
+    sample.framesDropped = enc_dropped.exchange(0);
+    sample.aiLatencyMs = detector.lastLatencyMs();
+    if (!pipeline || !encoder_governor.update(sample)) return;
+
+    applyEncoderBitrate();
+    GstElement *rate = gst_bin_get_by_name(GST_BIN(pipeline), "enc_rate");
+    if (rate) {
+        g_object_set(rate, "max-rate", encoder_governor.fps(), NULL);
+        gst_object_unref(rate);
+    }
+    std::cout << "\n[Encoder] level=" << encoder_governor.level()
+              << " bitrate=" << encoder_governor.bitrateKbps() << "kbps fps=" << encoder_governor.fps()
+              << " (enc=" << sample.encodeMs << "ms drops=" << sample.framesDropped << "/" << sample.framesIn
+              << " ai=" << sample.aiLatencyMs << "ms)" << std::endl;
+}
+
+// The CPU governor and the network controller each cap the bitrate; the
+// encoder gets the lower of the two.
+void PipelineManager::applyEncoderBitrate() {
+    if (!pipeline) return;
+    int kbps = config.stream_bitrate_kbps;
+    if (config.encoder_governor) kbps = std::min(kbps, encoder_governor.bitrateKbps());
+    if (net_adaptive) kbps = std::min(kbps, net_rate.bitrateKbps());
+    GstElement *enc = gst_bin_get_by_name(GST_BIN(pipeline), "enc");
+    if (!enc) return;
+    if (encoder_is_x264) {
+        g_object_set(enc, "bitrate", static_cast<guint>(kbps), NULL);
+    } else {
+        // v4l2 encoders apply extra-controls immediately while streaming.
+        GstStructure *controls = gst_structure_new("controls", "video_bitrate", G_TYPE_INT, kbps * 1000, NULL);
+        g_object_set(enc, "extra-controls", controls, NULL);
+        gst_structure_free(controls);
+    }
+    gst_object_unref(enc);
+}
+
+void PipelineManager::reportNetworkFeedback(int receivers, float fraction_lost, float jitter_ms) {
+    if (!net_adaptive) return;
+    NetworkRateController::Feedback fb;
+    fb.receivers = receivers;
+    fb.fractionLost = fraction_lost;
+    fb.jitterMs = jitter_ms;
+    // Sink QoS with no RTSP receivers is local load (e.g. a slow encoder),
+    // not congestion, so it only counts while someone is watching.
+    fb.qosEvents = receivers > 0 ? qos_events : 0;
+    qos_events = 0;
+    if (net_rate.update(fb)) {
+        applyEncoderBitrate();
+        std::cout << "\n[Net] bitrate=" << net_rate.bitrateKbps() << "kbps (loss="
+                  << static_cast<int>(fraction_lost * 100.0f) << "% jitter=" << jitter_ms
+                  << "ms viewers=" << receivers << ")" << std::endl;
+    }
+
+    // Forced IDRs while viewers are losing packets, so they resync sooner.
+    const int interval = net_rate.keyframeIntervalSec();
+    const gint64 now = g_get_monotonic_time();
+    if (receivers > 0 && interval > 0 && now - last_forced_keyframe_us >= interval * G_USEC_PER_SEC) {
+        requestKeyframe(StreamProfile::Main);
+        last_forced_keyframe_us = now;
+    }
 }
 
 GstFlowReturn PipelineManager::on_new_sample_wrapper(GstElement *sink, gpointer user_data) {
     return static_cast<PipelineManager*>(user_data)->on_new_sample(sink);
 }
 
+GstFlowReturn PipelineManager::on_stream_sample_wrapper(GstElement *sink, gpointer user_data) {
+    return static_cast<PipelineManager*>(user_data)->on_stream_sample(sink, StreamProfile::Main);
+}
+
+GstFlowReturn PipelineManager::on_sub_sample_wrapper(GstElement *sink, gpointer user_data) {
+    return static_cast<PipelineManager*>(user_data)->on_stream_sample(sink, StreamProfile::Sub);
+}
+
+GstFlowReturn PipelineManager::on_stream_sample(GstElement *sink, StreamProfile profile) {
+    GstSample *sample;
+    g_signal_emit_by_name(sink, "pull-sample", &sample);
+    if (!sample) return GST_FLOW_ERROR;
+    GstBuffer *buffer = gst_sample_get_buffer(sample);
+    if (profile == StreamProfile::Main) last_encoded_us = g_get_monotonic_time();
+    const EncodedListener& listener = encoded_listeners[static_cast<int>(profile)];
+    if (buffer && listener) listener(buffer);
+    gst_sample_unref(sample);
+    return GST_FLOW_OK;
+}
+
 GstFlowReturn PipelineManager::on_new_sample(GstElement *sink) {
     GstSample *sample;
     g_signal_emit_by_name(sink, "pull-sample", &sample);
-    if (sample) {
-        if (!caps_logged) {
-            GstCaps *caps = gst_sample_get_caps(sample);
-            if (caps) {
-                gchar *caps_str = gst_caps_to_string(caps);
-                std::cout << "[Debug] appsink caps: " << caps_str << std::endl;
-                g_free(caps_str);
-                caps_logged = true;
-            }
-        }
+    if (!sample) return GST_FLOW_ERROR;
 
-        GstBuffer *buffer = gst_sample_get_buffer(sample);
-        GstMapInfo map;
-        if (gst_buffer_map(buffer, &map, GST_MAP_READ)) {
-            last_sample_us.store(g_get_monotonic_time());
-            const size_t expected_size = static_cast<size_t>(320) * 320 * 3;
-            if (map.size < expected_size) {
-                std::cerr << "[Warning] appsink buffer too small: " << map.size
-                          << " bytes, expected at least " << expected_size << " bytes" << std::endl;
-                gst_buffer_unmap(buffer, &map);
-                gst_sample_unref(sample);
-                return GST_FLOW_OK;
-            }
-
-            detector.pushFrame(map.data, 320, 320);
-            gst_buffer_unmap(buffer, &map);
+    // Format, size and stride all come from the negotiated caps and the
+    // buffer's video meta, never from the configured AI size.
+    GstCaps *caps = gst_sample_get_caps(sample);
+    if (caps && caps != ai_caps) {
+        ai_format_ok = gst_video_info_from_caps(&ai_info, caps) &&
+                       GST_VIDEO_INFO_FORMAT(&ai_info) == GST_VIDEO_FORMAT_RGB;
+        if (ai_caps) gst_caps_unref(ai_caps);
+        ai_caps = gst_caps_ref(caps);
+        gchar *caps_str = gst_caps_to_string(caps);
+        std::cout << "[Debug] appsink caps: " << caps_str << std::endl;
+        g_free(caps_str);
+        if (!ai_format_ok) {
+            std::cerr << "[Warning] AI branch needs packed RGB frames, detection idle." << std::endl;
         }
+    }
+    GstBuffer *buffer = gst_sample_get_buffer(sample);
+    if (!ai_format_ok || !buffer) {
         gst_sample_unref(sample);
         return GST_FLOW_OK;
     }
-    return GST_FLOW_ERROR;
+
+    // The mapped frame holds its own buffer ref, so the detector can keep
+    // it past this callback and read the pool memory in place.
+    auto *frame = new GstVideoFrame;
+    if (!gst_video_frame_map(frame, &ai_info, buffer, GST_MAP_READ)) {
+        delete frame;
+        gst_sample_unref(sample);
+        return GST_FLOW_OK;
+    }
+    gst_sample_unref(sample);
+    std::shared_ptr<GstVideoFrame> mapped(frame, [](GstVideoFrame *f) {
+        gst_video_frame_unmap(f);
+        delete f;
+    });
+
+    VideoFrameRef ref;
+    ref.data = static_cast<const unsigned char*>(GST_VIDEO_FRAME_PLANE_DATA(frame, 0));
+    ref.width = GST_VIDEO_FRAME_WIDTH(frame);
+    ref.height = GST_VIDEO_FRAME_HEIGHT(frame);
+    ref.stride = GST_VIDEO_FRAME_PLANE_STRIDE(frame, 0);
+    ref.pts = GST_BUFFER_PTS(frame->buffer) == GST_CLOCK_TIME_NONE
+                  ? DetectionFrame::kNoPts
+                  : static_cast<uint64_t>(GST_BUFFER_PTS(frame->buffer));
+    ref.owner = std::move(mapped);
+    frame_share.publishAiInput(ref.data, ref.width, ref.height, ref.stride, ref.pts);
+    detector.pushFrame(std::move(ref));
+    return GST_FLOW_OK;
 }
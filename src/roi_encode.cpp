@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "roi_encode.hpp"
+
+namespace {
+
+int blockSad(const uint8_t* a, int a_stride, const uint8_t* b, int b_stride, int w, int h) {
+    int sad = 0;
+    for (int y = 0; y < h; ++y) {
+        const uint8_t* ra = a + y * a_stride;
+        const uint8_t* rb = b + y * b_stride;
+        for (int x = 0; x < w; ++x) sad += std::abs(ra[x] - rb[x]);
+    }
+    return sad;
+}
+
+void copyBlock(uint8_t* dst, int dst_stride, const uint8_t* src, int src_stride, int w, int h) {
+    for (int y = 0; y < h; ++y) std::memcpy(dst + y * dst_stride, src + y * src_stride, w);
+}
+
+}
+
+RoiEncodeFilter::RoiEncodeFilter() : RoiEncodeFilter(Config()) {}
+
+RoiEncodeFilter::RoiEncodeFilter(const Config& cfg) : config(cfg) {
+    rois.reserve(16);
+}
+
+void RoiEncodeFilter::configure(const Config& cfg) {
+    config = cfg;
+    have_ref = false;
+}
+
+void RoiEncodeFilter::reset(const OsdYuvTarget& frame) {
+    width = frame.width;
+    height = frame.height;
+    interleaved = frame.interleaved;
+    mb_cols = (width + kBlock - 1) / kBlock;
+    mb_rows = (height + kBlock - 1) / kBlock;
+    roi_mask.assign(static_cast<size_t>(mb_cols) * mb_rows, 0);
+    hold_run.assign(static_cast<size_t>(mb_cols) * mb_rows, 0);
+    ref_y.assign(static_cast<size_t>(width) * height, 0);
+    ref_uv.assign(static_cast<size_t>((width + 1) / 2) * ((height + 1) / 2) * 2, 128);
+    have_ref = false;
+}
+
+void RoiEncodeFilter::markRois(const std::vector<Detection>& dets, int w, int h) {
+    std::fill(roi_mask.begin(), roi_mask.end(), 0);
+    rois.clear();
+    for (const auto& d : dets) {
+        const int mx = static_cast<int>(d.w * config.margin);
+        const int my = static_cast<int>(d.h * config.margin);
+        const int x0 = std::max(0, (d.x - mx) / kBlock);
+        const int y0 = std::max(0, (d.y - my) / kBlock);
+        const int x1 = std::min(mb_cols - 1, (std::min(w, d.x + d.w + mx) - 1) / kBlock);
+        const int y1 = std::min(mb_rows - 1, (std::min(h, d.y + d.h + my) - 1) / kBlock);
+        if (x1 < x0 || y1 < y0) continue;
+        for (int by = y0; by <= y1; ++by) {
+            std::fill_n(&roi_mask[static_cast<size_t>(by) * mb_cols + x0], x1 - x0 + 1, 1);
+        }
+        OsdRect r;
+        r.x = x0 * kBlock;
+        r.y = y0 * kBlock;
+        r.w = std::min(w, (x1 + 1) * kBlock) - r.x;
+        r.h = std::min(h, (y1 + 1) * kBlock) - r.y;
+        rois.push_back(r);
+    }
+}
+
+const std::vector<OsdRect>& RoiEncodeFilter::process(const OsdYuvTarget& frame, const std::vector<Detection>& dets) {
+    if (frame.width != width || frame.height != height || frame.interleaved != interleaved || roi_mask.empty()) {
+        reset(frame);
+    }
+    markRois(dets, frame.width, frame.height);
+    held_blocks = 0;
+
+    const int ref_stride = width;
+    const int cw = (width + 1) / 2;
+    const int ch = (height + 1) / 2;
+    // NV12 keeps UV interleaved at full chroma-row width; I420 packs U then V.
+    uint8_t* ref_u = ref_uv.data();
+    uint8_t* ref_v = interleaved ? nullptr : ref_uv.data() + static_cast<size_t>(cw) * ch;
+    const int ref_uv_stride = interleaved ? cw * 2 : cw;
+    const int refresh_row = static_cast<int>(frame_count++ % static_cast<uint32_t>(mb_rows));
+    const int threshold = config.staticThreshold * kBlock * kBlock;
+    const int max_hold = std::max(0, config.maxHoldFrames);
+
+    for (int by = 0; by < mb_rows; ++by) {
+        const int py = by * kBlock;
+        const int bh = std::min(kBlock, height - py);
+        for (int bx = 0; bx < mb_cols; ++bx) {
+            const int px = bx * kBlock;
+            const int bw = std::min(kBlock, width - px);
+            const size_t block = static_cast<size_t>(by) * mb_cols + bx;
+            uint8_t* fy = frame.y + static_cast<size_t>(py) * frame.yStride + px;
+            uint8_t* ry = ref_y.data() + static_cast<size_t>(py) * ref_stride + px;
+            const int cpx = px / 2, cpy = py / 2, cbw = (bw + 1) / 2, cbh = (bh + 1) / 2;
+            // Chroma planes of this block; for NV12 fu/ru cover interleaved UV.
+            uint8_t* fu = frame.u + static_cast<size_t>(cpy) * frame.uvStride + (interleaved ? cpx * 2 : cpx);
+            uint8_t* ru = ref_u + static_cast<size_t>(cpy) * ref_uv_stride + (interleaved ? cpx * 2 : cpx);
+            uint8_t* fv = interleaved ? nullptr : frame.v + static_cast<size_t>(cpy) * frame.uvStride + cpx;
+            uint8_t* rv = interleaved ? nullptr : ref_v + static_cast<size_t>(cpy) * ref_uv_stride + cpx;
+
+            // Luma first; chroma only for blocks that are still candidates.
+            bool hold = have_ref && by != refresh_row && !roi_mask[block] && hold_run[block] < max_hold &&
+                        blockSad(fy, frame.yStride, ry, ref_stride, bw, bh) * (kBlock * kBlock) <= threshold * bw * bh;
+            if (hold) {
+                const int chroma_sad = interleaved
+                    ? blockSad(fu, frame.uvStride, ru, ref_uv_stride, cbw * 2, cbh)
+                    : blockSad(fu, frame.uvStride, ru, ref_uv_stride, cbw, cbh) +
+                      blockSad(fv, frame.uvStride, rv, ref_uv_stride, cbw, cbh);
+                hold = chroma_sad * (kBlock * kBlock) <= threshold * cbw * cbh * 2;
+            }
+            hold_run[block] = hold ? hold_run[block] + 1 : 0;
+            if (hold) {
+                copyBlock(fy, frame.yStride, ry, ref_stride, bw, bh);
+                held_blocks++;
+            } else {
+                copyBlock(ry, ref_stride, fy, frame.yStride, bw, bh);
+            }
+
+            if (interleaved) {
+                if (hold) copyBlock(fu, frame.uvStride, ru, ref_uv_stride, cbw * 2, cbh);
+                else copyBlock(ru, ref_uv_stride, fu, frame.uvStride, cbw * 2, cbh);
+            } else {
+                if (hold) {
+                    copyBlock(fu, frame.uvStride, ru, ref_uv_stride, cbw, cbh);
+                    copyBlock(fv, frame.uvStride, rv, ref_uv_stride, cbw, cbh);
+                } else {
+                    copyBlock(ru, ref_uv_stride, fu, frame.uvStride, cbw, cbh);
+                    copyBlock(rv, ref_uv_stride, fv, frame.uvStride, cbw, cbh);
+                }
+            }
+        }
+    }
+    have_ref = true;
+    return rois;
+}
@@ -1,36 +1,245 @@
 #include "rtsp_service.hpp"
+#include <algorithm>
 #include <iostream>
+#include <gst/app/gstappsrc.h>
 
 #include "runtime_config.hpp"
 
+namespace {
+
+// Past this much queued data the media pipeline isn't keeping up; drop
+// whole access units at the source instead of growing latency.
+constexpr guint64 kMaxQueuedBytes = 2 * 1024 * 1024;
+
+}
+
 RTSPServer::RTSPServer() {}
 
 RTSPServer::~RTSPServer() {
+    if (stats_tick_id) g_source_remove(stats_tick_id);
+    for (auto& mount : mounts) {
+        std::lock_guard<std::mutex> lock(mount->src_mutex);
+        if (mount->app_src) gst_object_unref(mount->app_src);
+        if (mount->media) g_object_unref(mount->media);
+        mount->app_src = nullptr;
+        mount->media = nullptr;
+    }
     if (server) g_object_unref(server);
 }
 
-void RTSPServer::start(int rtsp_port, const std::string &mount_point, int udp_port, const std::string &host_label) {
+int RTSPServer::addMount(const std::string &mount_point) {
+    auto mount = std::make_unique<Mount>();
+    mount->path = mount_point;
+    mount->server = this;
+    mounts.push_back(std::move(mount));
+    return static_cast<int>(mounts.size()) - 1;
+}
+
+void RTSPServer::start(int rtsp_port, const std::string &host_label) {
     server = gst_rtsp_server_new();
     gst_rtsp_server_set_service(server, std::to_string(rtsp_port).c_str());
 
-    GstRTSPMountPoints *mounts = gst_rtsp_server_get_mount_points(server);
-    GstRTSPMediaFactory *factory = gst_rtsp_media_factory_new();
+    GstRTSPMountPoints *mount_points = gst_rtsp_server_get_mount_points(server);
 
-    // RECEIVE RAW H264:
-    // This is the most robust way to bridge between the app and the server.
-    // Explicitly set byte-stream format to match the sender.
-    std::string launch_str = 
-        "( udpsrc port=" + std::to_string(udp_port) + " address=127.0.0.1 caps=\"video/x-h264,stream-format=byte-stream,alignment=au\" ! "
+    // RECEIVE RAW H264 IN-PROCESS:
+    // The camera pipeline's encoded buffers are pushed straight into this
+    // appsrc. do-timestamp restamps them on the media pipeline's clock,
+    // since the two pipelines run on different base times.
+    const std::string launch_str =
+        "( appsrc name=src is-live=true format=time do-timestamp=true "
+        "caps=\"video/x-h264,stream-format=byte-stream,alignment=au\" ! "
         "h264parse ! rtph264pay name=pay0 pt=96 config-interval=1 )";
 
-    gst_rtsp_media_factory_set_launch(factory, launch_str.c_str());
-    gst_rtsp_media_factory_set_shared(factory, TRUE);
-
-    gst_rtsp_mount_points_add_factory(mounts, mount_point.c_str(), factory);
-    g_object_unref(mounts);
+    std::string host = host_label.empty() ? resolveRtspHost(getRuntimeConfig()) : host_label;
+    for (auto& mount : mounts) {
+        GstRTSPMediaFactory *factory = gst_rtsp_media_factory_new();
+        gst_rtsp_media_factory_set_launch(factory, launch_str.c_str());
+        gst_rtsp_media_factory_set_shared(factory, TRUE);
+        g_signal_connect(factory, "media-configure", G_CALLBACK(on_media_configure), mount.get());
+        gst_rtsp_mount_points_add_factory(mount_points, mount->path.c_str(), factory);
+        std::cout << "[RTSP] Gateway active at rtsp://" << host << ":" << rtsp_port << mount->path << std::endl;
+    }
+    g_object_unref(mount_points);
 
     source_id = gst_rtsp_server_attach(server, NULL);
-    std::string host = host_label.empty() ? resolveRtspHost(getRuntimeConfig()) : host_label;
-    std::cout << "[RTSP] Gateway active at rtsp://" << host << ":" << rtsp_port << mount_point << std::endl;
     std::cout << "[RTSP] Ensure you are using VLC with 'RTP over RTSP (TCP)' enabled if UDP fails." << std::endl;
 }
+
+void RTSPServer::setKeyframeRequest(int mount, std::function<void()> request) {
+    if (mount < 0 || mount >= static_cast<int>(mounts.size())) return;
+    std::lock_guard<std::mutex> lock(mounts[mount]->src_mutex);
+    mounts[mount]->keyframe_request = std::move(request);
+}
+
+guint64 RTSPServer::droppedUnits(int mount) const {
+    if (mount < 0 || mount >= static_cast<int>(mounts.size())) return 0;
+    return mounts[mount]->dropped.load();
+}
+
+RTSPServer::ReceiverStats RTSPServer::receiverStats(int mount_id) const {
+    ReceiverStats stats;
+    if (mount_id < 0 || mount_id >= static_cast<int>(mounts.size())) return stats;
+    Mount& mount = *mounts[mount_id];
+    GstRTSPMedia *media = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mount.src_mutex);
+        if (mount.media) media = GST_RTSP_MEDIA(g_object_ref(mount.media));
+    }
+    if (!media) return stats;
+
+    // Receiver reports about our stream are kept on the internal sender
+    // source of each stream's RTP session, one entry per receiver in
+    // "received-rr". Jitter is in RTP clock units (90 kHz for H.264).
+    auto accumulate = [&stats](const GstStructure *rb) {
+        guint fraction_lost = 0, jitter = 0;
+        if (!gst_structure_get_uint(rb, "rb-fractionlost", &fraction_lost) ||
+            !gst_structure_get_uint(rb, "rb-jitter", &jitter)) return;
+        stats.receivers++;
+        stats.fractionLost = std::max(stats.fractionLost, fraction_lost / 256.0f);
+        stats.jitterMs = std::max(stats.jitterMs, jitter / 90.0f);
+    };
+    // rtpsession still hands both lists out as GValueArray, which GLib
+    // deprecates; there is no replacement property to read instead.
+    G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+    for (guint i = 0; i < gst_rtsp_media_n_streams(media); ++i) {
+        GstRTSPStream *stream = gst_rtsp_media_get_stream(media, i);
+        GObject *session = stream ? gst_rtsp_stream_get_rtpsession(stream) : nullptr;
+        if (!session) continue;
+        GValueArray *sources = nullptr;
+        g_object_get(session, "sources", &sources, NULL);
+        for (guint j = 0; sources && j < sources->n_values; ++j) {
+            GObject *source = static_cast<GObject*>(g_value_get_object(g_value_array_get_nth(sources, j)));
+            GstStructure *s = nullptr;
+            g_object_get(source, "stats", &s, NULL);
+            if (!s) continue;
+            gboolean internal = FALSE, have_rb = FALSE;
+            gst_structure_get_boolean(s, "internal", &internal);
+            const GValue *received = gst_structure_get_value(s, "received-rr");
+            if (internal && received && G_VALUE_HOLDS(received, G_TYPE_VALUE_ARRAY)) {
+                auto *rrs = static_cast<GValueArray*>(g_value_get_boxed(received));
+                for (guint k = 0; rrs && k < rrs->n_values; ++k) {
+                    accumulate(gst_value_get_structure(g_value_array_get_nth(rrs, k)));
+                }
+            } else if (internal && gst_structure_get_boolean(s, "have-rb", &have_rb) && have_rb) {
+                accumulate(s);
+            }
+            gst_structure_free(s);
+        }
+        if (sources) g_value_array_free(sources);
+        g_object_unref(session);
+    }
+    G_GNUC_END_IGNORE_DEPRECATIONS
+    g_object_unref(media);
+    return stats;
+}
+
+void RTSPServer::setReceiverStatsListener(int mount, std::function<void(const ReceiverStats&)> listener) {
+    if (mount < 0 || mount >= static_cast<int>(mounts.size())) return;
+    mounts[mount]->stats_listener = std::move(listener);
+    if (!stats_tick_id) stats_tick_id = g_timeout_add_seconds(1, on_stats_tick, this);
+}
+
+gboolean RTSPServer::on_stats_tick(gpointer user_data) {
+    auto* self = static_cast<RTSPServer*>(user_data);
+    for (size_t i = 0; i < self->mounts.size(); ++i) {
+        if (self->mounts[i]->stats_listener) {
+            self->mounts[i]->stats_listener(self->receiverStats(static_cast<int>(i)));
+        }
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+GstPadProbeReturn RTSPServer::on_test_drop_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    auto* self = static_cast<RTSPServer*>(user_data);
+    return g_random_double() < self->test_loss ? GST_PAD_PROBE_DROP : GST_PAD_PROBE_OK;
+}
+
+void RTSPServer::on_media_configure(GstRTSPMediaFactory *factory, GstRTSPMedia *media, gpointer user_data) {
+    auto* mount = static_cast<Mount*>(user_data);
+    GstElement *element = gst_rtsp_media_get_element(media);
+    GstElement *src = gst_bin_get_by_name_recurse_up(GST_BIN(element), "src");
+    if (!src) {
+        gst_object_unref(element);
+        return;
+    }
+
+    if (mount->server->test_loss > 0.0) {
+        GstElement *pay = gst_bin_get_by_name_recurse_up(GST_BIN(element), "pay0");
+        if (pay) {
+            GstPad *pad = gst_element_get_static_pad(pay, "src");
+            gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, on_test_drop_probe, mount->server, nullptr);
+            gst_object_unref(pad);
+            gst_object_unref(pay);
+            std::cout << "[RTSP] Test packet loss " << mount->server->test_loss * 100.0 << "% on " << mount->path << std::endl;
+        }
+    }
+
+    std::function<void()> request;
+    {
+        std::lock_guard<std::mutex> lock(mount->src_mutex);
+        if (mount->app_src) gst_object_unref(mount->app_src);
+        if (mount->media) g_object_unref(mount->media);
+        mount->app_src = src;
+        mount->media = GST_RTSP_MEDIA(g_object_ref(media));
+        request = mount->keyframe_request;
+    }
+    gst_object_unref(element);
+    g_signal_connect(media, "unprepared", G_CALLBACK(on_media_unprepared), mount);
+    if (request) request();
+}
+
+void RTSPServer::on_media_unprepared(GstRTSPMedia *media, gpointer user_data) {
+    auto* mount = static_cast<Mount*>(user_data);
+    GstElement *element = gst_rtsp_media_get_element(media);
+    GstElement *src = gst_bin_get_by_name_recurse_up(GST_BIN(element), "src");
+    gst_object_unref(element);
+
+    std::lock_guard<std::mutex> lock(mount->src_mutex);
+    if (src && src == mount->app_src) {
+        gst_object_unref(mount->app_src);
+        mount->app_src = nullptr;
+        if (mount->media) g_object_unref(mount->media);
+        mount->media = nullptr;
+    }
+    if (src) gst_object_unref(src);
+}
+
+void RTSPServer::pushBuffer(int mount_id, GstBuffer *buffer) {
+    if (mount_id < 0 || mount_id >= static_cast<int>(mounts.size())) return;
+    Mount& mount = *mounts[mount_id];
+    GstElement *src = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mount.src_mutex);
+        if (!mount.app_src) return;
+        src = GST_ELEMENT(gst_object_ref(mount.app_src));
+    }
+
+    const bool keyframe = !GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+    const bool behind = gst_app_src_get_current_level_bytes(GST_APP_SRC(src)) > kMaxQueuedBytes;
+    if (behind || (mount.resync && !keyframe)) {
+        guint64 dropped = ++mount.dropped;
+        if (dropped % 30 == 1) {
+            std::cerr << "[RTSP] " << mount.path << " media behind, dropped "
+                      << dropped << " access units" << std::endl;
+        }
+        // Ask for an IDR when the resync starts, and again if the one we
+        // were waiting for had to be dropped too.
+        if (!mount.resync.exchange(true) || keyframe) {
+            std::function<void()> request;
+            {
+                std::lock_guard<std::mutex> lock(mount.src_mutex);
+                request = mount.keyframe_request;
+            }
+            if (request) request();
+        }
+    } else {
+        mount.resync = false;
+        // Shallow copy: new metadata, same memory. Clear the camera-pipeline
+        // timestamps so appsrc stamps it on arrival.
+        GstBuffer *out = gst_buffer_copy(buffer);
+        GST_BUFFER_PTS(out) = GST_CLOCK_TIME_NONE;
+        GST_BUFFER_DTS(out) = GST_CLOCK_TIME_NONE;
+        gst_app_src_push_buffer(GST_APP_SRC(src), out);
+    }
+    gst_object_unref(src);
+}
@@ -1,32 +1,130 @@
 #include "runtime_config.hpp"
 
+#include <atomic>
 #include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <sstream>
 
 #include "net_util.hpp"
+#include "thread_topology.hpp"
 
 namespace {
 
+using Settings = std::map<std::string, std::string>;
+
+// Settings from NANOSTREAM_CONFIG while a load is in progress; they take
+// precedence over the environment.
+thread_local const Settings* file_settings = nullptr;
+
+const char* lookup(const char* name) {
+    if (file_settings) {
+        auto it = file_settings->find(name);
+        if (it != file_settings->end()) return it->second.c_str();
+    }
+    return std::getenv(name);
+}
+
+// KEY=VALUE lines using the environment variable names; '#' starts a comment.
+bool readSettingsFile(const std::string& path, Settings& out, std::string& error) {
+    std::ifstream in(path);
+    if (!in.good()) {
+        error = "cannot read " + path;
+        return false;
+    }
+    std::string line;
+    int line_no = 0;
+    while (std::getline(in, line)) {
+        ++line_no;
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) line.erase(hash);
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos) continue;
+        size_t eq = line.find('=');
+        if (eq == std::string::npos || eq < first) {
+            error = path + ":" + std::to_string(line_no) + ": expected KEY=VALUE";
+            return false;
+        }
+        std::string key = line.substr(first, eq - first);
+        key.erase(key.find_last_not_of(" \t") + 1);
+        std::string value = line.substr(eq + 1);
+        value.erase(0, value.find_first_not_of(" \t"));
+        value.erase(value.find_last_not_of(" \t\r") + 1);
+        if (key.compare(0, 11, "NANOSTREAM_") != 0) {
+            error = path + ":" + std::to_string(line_no) + ": unknown key " + key;
+            return false;
+        }
+        out[key] = value;
+    }
+    return true;
+}
+
+// Every snapshot ever published stays alive, so a reference obtained from
+// getRuntimeConfig() never dangles. Reloads are operator-driven and rare.
+std::mutex snapshot_mutex;
+std::vector<std::unique_ptr<const RuntimeConfig>> snapshots;
+std::atomic<const RuntimeConfig*> current_snapshot{nullptr};
+std::atomic<uint64_t> snapshot_version{0};
+
+void publishSnapshot(RuntimeConfig cfg) {
+    snapshots.push_back(std::make_unique<const RuntimeConfig>(std::move(cfg)));
+    current_snapshot.store(snapshots.back().get(), std::memory_order_release);
+    snapshot_version.fetch_add(1, std::memory_order_release);
+}
+
 bool envEnabled(const char* name) {
-    const char* v = std::getenv(name);
+    const char* v = lookup(name);
     return v && std::string(v) == "1";
 }
 
 int envInt(const char* name, int default_value) {
-    if (const char* v = std::getenv(name)) {
+    if (const char* v = lookup(name)) {
         return std::atoi(v);
     }
     return default_value;
 }
 
 float envFloat(const char* name, float default_value) {
-    if (const char* v = std::getenv(name)) {
+    if (const char* v = lookup(name)) {
         return std::atof(v);
     }
     return default_value;
 }
 
+std::vector<int> envIntList(const char* name, const std::vector<int>& default_value) {
+    const char* v = lookup(name);
+    if (!v) return default_value;
+    std::vector<int> parsed;
+    std::string list = v;
+    size_t start = 0;
+    while (start < list.size()) {
+        size_t end = list.find(',', start);
+        int value = std::atoi(list.substr(start, end - start).c_str());
+        if (value > 0) parsed.push_back(value);
+        if (end == std::string::npos) break;
+        start = end + 1;
+    }
+    return parsed.empty() ? default_value : parsed;
+}
+
+std::vector<std::string> envStringList(const char* name) {
+    std::vector<std::string> parsed;
+    const char* v = lookup(name);
+    if (!v) return parsed;
+    std::stringstream in(v);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        item.erase(0, item.find_first_not_of(" \t"));
+        item.erase(item.find_last_not_of(" \t") + 1);
+        if (!item.empty()) parsed.push_back(item);
+    }
+    return parsed;
+}
+
 }
 
 RuntimeConfig loadRuntimeConfig() {
@@ -40,11 +138,34 @@ RuntimeConfig loadRuntimeConfig() {
 
     cfg.useDmabuf = envEnabled("NANOSTREAM_DMABUF");
     cfg.useInt8 = envEnabled("NANOSTREAM_INT8");
-    if (const char* v = std::getenv("NANOSTREAM_INT8_PARAM")) cfg.int8Param = v;
-    if (const char* v = std::getenv("NANOSTREAM_INT8_BIN")) cfg.int8Bin = v;
+    if (const char* v = lookup("NANOSTREAM_INT8_PARAM")) cfg.int8Param = v;
+    if (const char* v = lookup("NANOSTREAM_INT8_BIN")) cfg.int8Bin = v;
 
-    const char* label_env = std::getenv("NANOSTREAM_LABELS");
+    const char* label_env = lookup("NANOSTREAM_LABELS");
     cfg.showLabels = !(label_env && std::string(label_env) == "0");
+    const char* osd_env = lookup("NANOSTREAM_OSD");
+    cfg.osdEnabled = !(osd_env && std::string(osd_env) == "0");
+    const char* extrap_env = lookup("NANOSTREAM_OSD_EXTRAPOLATE");
+    cfg.osdExtrapolate = !(extrap_env && std::string(extrap_env) == "0");
+    cfg.osdMaxExtrapolationMs = envInt("NANOSTREAM_OSD_MAX_EXTRAP_MS", cfg.osdMaxExtrapolationMs);
+    cfg.osdDelayMs = envInt("NANOSTREAM_OSD_DELAY_MS", cfg.osdDelayMs);
+
+    cfg.encBitrateKbps = envInt("NANOSTREAM_ENC_BITRATE", cfg.encBitrateKbps);
+    cfg.encThreads = envInt("NANOSTREAM_ENC_THREADS", cfg.encThreads);
+    cfg.encGovernor = envEnabled("NANOSTREAM_ENC_GOVERNOR");
+    cfg.encMinBitrateKbps = envInt("NANOSTREAM_ENC_BITRATE_MIN", cfg.encMinBitrateKbps);
+    cfg.encMinFps = envInt("NANOSTREAM_ENC_FPS_MIN", cfg.encMinFps);
+
+    cfg.netAdaptive = envEnabled("NANOSTREAM_NET_ADAPTIVE");
+    cfg.netMinBitrateKbps = envInt("NANOSTREAM_NET_BITRATE_MIN", cfg.netMinBitrateKbps);
+    cfg.netTestLoss = envFloat("NANOSTREAM_NET_TEST_LOSS", cfg.netTestLoss);
+
+    cfg.roiEncode = envEnabled("NANOSTREAM_ROI_ENCODE");
+    cfg.roiCrf = envInt("NANOSTREAM_ROI_CRF", cfg.roiCrf);
+    cfg.roiStaticThreshold = envInt("NANOSTREAM_ROI_STATIC_SAD", cfg.roiStaticThreshold);
+    cfg.roiMargin = envFloat("NANOSTREAM_ROI_MARGIN", cfg.roiMargin);
+    cfg.roiMaxHold = envInt("NANOSTREAM_ROI_MAX_HOLD", cfg.roiMaxHold);
+    cfg.roiDeltaQp = envInt("NANOSTREAM_ROI_DELTA_QP", cfg.roiDeltaQp);
 
     cfg.personMinScore = envFloat("NANOSTREAM_PERSON_MIN_SCORE", cfg.personMinScore);
     cfg.personMax = envInt("NANOSTREAM_PERSON_MAX", cfg.personMax);
@@ -52,7 +173,62 @@ RuntimeConfig loadRuntimeConfig() {
     cfg.personArMin = envFloat("NANOSTREAM_PERSON_AR_MIN", cfg.personArMin);
     cfg.personArMax = envFloat("NANOSTREAM_PERSON_AR_MAX", cfg.personArMax);
 
-    if (const char* v = std::getenv("NANOSTREAM_RTSP_HOST")) cfg.rtspHost = v;
+    if (const char* v = lookup("NANOSTREAM_RTSP_HOST")) cfg.rtspHost = v;
+    cfg.cameras = envStringList("NANOSTREAM_CAMERAS");
+
+    cfg.subEnabled = envEnabled("NANOSTREAM_SUB");
+    cfg.subWidth = envInt("NANOSTREAM_SUB_WIDTH", cfg.subWidth);
+    cfg.subHeight = envInt("NANOSTREAM_SUB_HEIGHT", cfg.subHeight);
+    cfg.subBitrateKbps = envInt("NANOSTREAM_SUB_BITRATE", cfg.subBitrateKbps);
+    const char* share_env = lookup("NANOSTREAM_SUB_SHARE_AI");
+    cfg.subShareAi = !(share_env && std::string(share_env) == "0");
+
+    cfg.metaEnabled = envEnabled("NANOSTREAM_META");
+    if (const char* v = lookup("NANOSTREAM_META_UDP_HOST")) cfg.metaUdpHost = v;
+    cfg.metaUdpPort = envInt("NANOSTREAM_META_UDP_PORT", cfg.metaUdpPort);
+    cfg.metaHttpPort = envInt("NANOSTREAM_META_HTTP_PORT", cfg.metaHttpPort);
+
+    cfg.webrtcEnabled = envEnabled("NANOSTREAM_WEBRTC");
+    cfg.webrtcPort = envInt("NANOSTREAM_WEBRTC_PORT", cfg.webrtcPort);
+    if (const char* v = lookup("NANOSTREAM_WEBRTC_BIND")) cfg.webrtcBind = v;
+    cfg.webrtcMaxSessions = envInt("NANOSTREAM_WEBRTC_MAX_SESSIONS", cfg.webrtcMaxSessions);
+    if (const char* v = lookup("NANOSTREAM_WEBRTC_STUN")) cfg.webrtcStun = v;
+
+    cfg.shareEnabled = envEnabled("NANOSTREAM_SHARE");
+    if (const char* v = lookup("NANOSTREAM_SHARE_SOCKET")) cfg.shareSocket = v;
+    const char* share_cam_env = lookup("NANOSTREAM_SHARE_CAMERA");
+    cfg.shareCamera = !(share_cam_env && std::string(share_cam_env) == "0");
+    const char* share_ai_env = lookup("NANOSTREAM_SHARE_AI");
+    cfg.shareAiInput = !(share_ai_env && std::string(share_ai_env) == "0");
+    cfg.shareSlots = envInt("NANOSTREAM_SHARE_SLOTS", cfg.shareSlots);
+
+    cfg.eventsEnabled = envEnabled("NANOSTREAM_EVENTS");
+    if (const char* v = lookup("NANOSTREAM_EVENTS_URL")) cfg.eventsUrl = v;
+    if (const char* v = lookup("NANOSTREAM_EVENTS_ZONES")) cfg.eventsZones = v;
+    cfg.eventsMinHits = envInt("NANOSTREAM_EVENTS_MIN_HITS", cfg.eventsMinHits);
+    cfg.eventsExitMs = envInt("NANOSTREAM_EVENTS_EXIT_MS", cfg.eventsExitMs);
+    cfg.eventsQueue = envInt("NANOSTREAM_EVENTS_QUEUE", cfg.eventsQueue);
+    cfg.eventsBatchMs = envInt("NANOSTREAM_EVENTS_BATCH_MS", cfg.eventsBatchMs);
+    if (const char* v = lookup("NANOSTREAM_EVENTS_DROP")) cfg.eventsDrop = v;
+
+    cfg.recEnabled = envEnabled("NANOSTREAM_REC");
+    if (const char* v = lookup("NANOSTREAM_REC_DIR")) cfg.recDir = v;
+    if (const char* v = lookup("NANOSTREAM_REC_FORMAT")) cfg.recFormat = v;
+    if (const char* v = lookup("NANOSTREAM_REC_LABELS")) cfg.recLabels = v;
+    cfg.recMinScore = envFloat("NANOSTREAM_REC_MIN_SCORE", cfg.recMinScore);
+    cfg.recPreRollSec = envInt("NANOSTREAM_REC_PRE_SEC", cfg.recPreRollSec);
+    cfg.recPostRollSec = envInt("NANOSTREAM_REC_POST_SEC", cfg.recPostRollSec);
+    cfg.recMaxClipSec = envInt("NANOSTREAM_REC_MAX_SEC", cfg.recMaxClipSec);
+    cfg.recRingKb = envInt("NANOSTREAM_REC_RING_KB", cfg.recRingKb);
+
+    if (const char* v = lookup("NANOSTREAM_CPU_STREAM")) cfg.cpuStream = v;
+    if (const char* v = lookup("NANOSTREAM_CPU_AI")) cfg.cpuAi = v;
+    cfg.streamRtPriority = envInt("NANOSTREAM_RT_PRIO", cfg.streamRtPriority);
+    cfg.aiNice = envInt("NANOSTREAM_AI_NICE", cfg.aiNice);
+
+    cfg.perfProfile = envEnabled("NANOSTREAM_PERF");
+    if (const char* v = lookup("NANOSTREAM_PERF_REPORT")) cfg.perfReport = v;
+    cfg.perfIntervalSec = envInt("NANOSTREAM_PERF_INTERVAL", cfg.perfIntervalSec);
 
     cfg.detInputWidth = envInt("NANOSTREAM_DET_INPUT_W", cfg.detInputWidth);
     cfg.detInputHeight = envInt("NANOSTREAM_DET_INPUT_H", cfg.detInputHeight);
@@ -68,14 +244,183 @@ RuntimeConfig loadRuntimeConfig() {
     cfg.detCapMediumAreaThreshold = envFloat("NANOSTREAM_DET_CAP_AREA_MED", cfg.detCapMediumAreaThreshold);
     cfg.detIouThreshold = envFloat("NANOSTREAM_DET_IOU", cfg.detIouThreshold);
     cfg.detEmaAlpha = envFloat("NANOSTREAM_DET_EMA", cfg.detEmaAlpha);
-    if (const char* v = std::getenv("NANOSTREAM_DET_HEADS")) cfg.detHeads = v;
+    if (const char* v = lookup("NANOSTREAM_DET_HEADS")) cfg.detHeads = v;
+    cfg.detCascade = envEnabled("NANOSTREAM_DET_CASCADE");
+    cfg.detCascadeInput = envInt("NANOSTREAM_DET_CASCADE_INPUT", cfg.detCascadeInput);
+    cfg.detCascadeRoiInput = envInt("NANOSTREAM_DET_CASCADE_ROI_INPUT", cfg.detCascadeRoiInput);
+    cfg.detCascadeMaxRois = envInt("NANOSTREAM_DET_CASCADE_MAX_ROIS", cfg.detCascadeMaxRois);
+    cfg.detCascadeProposalScore = envFloat("NANOSTREAM_DET_CASCADE_PROPOSAL_SCORE", cfg.detCascadeProposalScore);
+    cfg.detCascadeRefineArea = envFloat("NANOSTREAM_DET_CASCADE_REFINE_AREA", cfg.detCascadeRefineArea);
+    cfg.detAdaptiveInput = envEnabled("NANOSTREAM_DET_ADAPTIVE");
+    cfg.detInputSteps = envIntList("NANOSTREAM_DET_INPUT_STEPS", cfg.detInputSteps);
+    cfg.detLatencyBudgetMs = envInt("NANOSTREAM_DET_LATENCY_BUDGET", cfg.detLatencyBudgetMs);
+    cfg.detDecodeThreads = envInt("NANOSTREAM_DET_DECODE_THREADS", cfg.detDecodeThreads);
+    cfg.detBatch = envInt("NANOSTREAM_DET_BATCH", cfg.detBatch);
+    if (const char* v = lookup("NANOSTREAM_DET_SCHEDULE")) cfg.detSchedule = v;
 
     return cfg;
 }
 
+bool loadRuntimeConfig(RuntimeConfig& out, std::string& error) {
+    // Validate the environment alone first so an error names its source.
+    RuntimeConfig cfg = loadRuntimeConfig();
+    if (!validateRuntimeConfig(cfg, error)) {
+        error = "environment: " + error;
+        return false;
+    }
+    const char* path = std::getenv("NANOSTREAM_CONFIG");
+    if (path && *path) {
+        Settings settings;
+        if (!readSettingsFile(path, settings, error)) return false;
+        file_settings = &settings;
+        cfg = loadRuntimeConfig();
+        file_settings = nullptr;
+        if (!validateRuntimeConfig(cfg, error)) {
+            error = std::string(path) + ": " + error;
+            return false;
+        }
+    }
+    out = std::move(cfg);
+    return true;
+}
+
+bool validateRuntimeConfig(const RuntimeConfig& cfg, std::string& error) {
+    auto unit = [](float v) { return v >= 0.0f && v <= 1.0f; };
+    std::vector<EventZone> zones;
+    if (!unit(cfg.detBaseScore) || !unit(cfg.detMinScoreSmallArea) || !unit(cfg.detMinScoreMediumArea) ||
+        !unit(cfg.detCascadeProposalScore) || !unit(cfg.personMinScore) || !unit(cfg.recMinScore)) {
+        error = "scores must be within [0, 1]";
+    } else if (!unit(cfg.detIouThreshold) || !unit(cfg.detEmaAlpha)) {
+        error = "NANOSTREAM_DET_IOU and NANOSTREAM_DET_EMA must be within [0, 1]";
+    } else if (cfg.detTopK < 0 || cfg.detInputWidth < 0 || cfg.detInputHeight < 0 || cfg.detMaxDetections < 0 || cfg.detMinBoxArea < 0 || cfg.personMax < 0) {
+        error = "detector counts must not be negative";
+    } else if (!cfg.detHeads.empty() && parseDetectorHeads(cfg.detHeads).empty()) {
+        error = "NANOSTREAM_DET_HEADS must be cls:reg:stride[,...]";
+    } else if (cfg.personArMin > cfg.personArMax) {
+        error = "person aspect ratio range is empty";
+    } else if ((!cfg.cpuStream.empty() && thread_topology::parseCpuList(cfg.cpuStream).empty()) ||
+               (!cfg.cpuAi.empty() && thread_topology::parseCpuList(cfg.cpuAi).empty())) {
+        error = "NANOSTREAM_CPU_STREAM and NANOSTREAM_CPU_AI must be core lists like 0-1 or 2,3";
+    } else if (cfg.streamRtPriority < 0 || cfg.streamRtPriority > 99 || cfg.aiNice < -20 || cfg.aiNice > 19) {
+        error = "NANOSTREAM_RT_PRIO must be 0-99 and NANOSTREAM_AI_NICE -20..19";
+    } else if (cfg.detDecodeThreads < 0 || cfg.detDecodeThreads > 4) {
+        error = "NANOSTREAM_DET_DECODE_THREADS must be 0-4";
+    } else if (cfg.detBatch < 1 || cfg.detBatch > 4) {
+        error = "NANOSTREAM_DET_BATCH must be 1-4";
+    } else if (cfg.detSchedule != "rr" && cfg.detSchedule != "deadline") {
+        error = "NANOSTREAM_DET_SCHEDULE must be rr or deadline";
+    } else if (cfg.cameras.size() > 4) {
+        error = "NANOSTREAM_CAMERAS lists at most 4 cameras";
+    } else if (cfg.webrtcEnabled && (cfg.webrtcPort < 1 || cfg.webrtcPort > 65535 || cfg.webrtcMaxSessions < 1 || cfg.webrtcMaxSessions > 16)) {
+        error = "NANOSTREAM_WEBRTC_PORT must be a port and NANOSTREAM_WEBRTC_MAX_SESSIONS within [1, 16]";
+    } else if (cfg.webrtcEnabled && !cfg.webrtcStun.empty() && cfg.webrtcStun.compare(0, 7, "stun://") != 0) {
+        error = "NANOSTREAM_WEBRTC_STUN must be stun://host:port";
+    } else if (cfg.eventsEnabled && cfg.eventsUrl.compare(0, 7, "mqtt://") != 0 && cfg.eventsUrl.compare(0, 7, "unix://") != 0) {
+        error = "NANOSTREAM_EVENTS_URL must be mqtt://host[:port]/topic or unix:///path";
+    } else if (cfg.eventsEnabled && !parseEventZones(cfg.eventsZones, zones)) {
+        error = "NANOSTREAM_EVENTS_ZONES must be name:x0,y0,x1,y1[;...] within [0, 1]";
+    } else if (cfg.eventsEnabled && (cfg.eventsMinHits < 1 || cfg.eventsExitMs < 0 || cfg.eventsQueue < 1 || cfg.eventsBatchMs < 0)) {
+        error = "NANOSTREAM_EVENTS_MIN_HITS and _QUEUE must be positive, _EXIT_MS and _BATCH_MS not negative";
+    } else if (cfg.eventsEnabled && cfg.eventsDrop != "oldest" && cfg.eventsDrop != "newest") {
+        error = "NANOSTREAM_EVENTS_DROP must be oldest or newest";
+    } else if (cfg.roiMaxHold < 0 || cfg.roiMaxHold > 300) {
+        error = "NANOSTREAM_ROI_MAX_HOLD must be 0-300 frames";
+    } else if (cfg.osdDelayMs < 0 || cfg.osdDelayMs > 2000) {
+        error = "NANOSTREAM_OSD_DELAY_MS must be 0-2000";
+    } else if (cfg.perfIntervalSec < 1) {
+        error = "NANOSTREAM_PERF_INTERVAL must be at least 1 second";
+    } else {
+        return true;
+    }
+    return false;
+}
+
+std::vector<DetectorHead> parseDetectorHeads(const std::string& spec) {
+    std::vector<DetectorHead> parsed;
+    size_t start = 0;
+    while (start < spec.size()) {
+        size_t end = spec.find(',', start);
+        std::string token = spec.substr(start, end - start);
+        size_t p1 = token.find(':');
+        size_t p2 = token.find(':', p1 == std::string::npos ? p1 : p1 + 1);
+        if (p1 != std::string::npos && p2 != std::string::npos) {
+            DetectorHead h;
+            h.cls = token.substr(0, p1);
+            h.reg = token.substr(p1 + 1, p2 - p1 - 1);
+            h.stride = std::atoi(token.substr(p2 + 1).c_str());
+            if (!h.cls.empty() && !h.reg.empty() && h.stride > 0) {
+                parsed.push_back(h);
+            }
+        }
+        if (end == std::string::npos) break;
+        start = end + 1;
+    }
+    return parsed;
+}
+
+bool parseEventZones(const std::string& spec, std::vector<EventZone>& out) {
+    std::vector<EventZone> parsed;
+    std::stringstream in(spec);
+    std::string entry;
+    while (std::getline(in, entry, ';')) {
+        if (entry.empty()) continue;
+        size_t colon = entry.find(':');
+        if (colon == 0 || colon == std::string::npos) return false;
+        EventZone z;
+        z.name = entry.substr(0, colon);
+        float v[4];
+        const char* p = entry.c_str() + colon + 1;
+        for (int i = 0; i < 4; ++i) {
+            char* end = nullptr;
+            v[i] = std::strtof(p, &end);
+            if (end == p || (i < 3 ? *end != ',' : *end != '\0')) return false;
+            p = end + 1;
+        }
+        z.x0 = v[0];
+        z.y0 = v[1];
+        z.x1 = v[2];
+        z.y1 = v[3];
+        if (z.x0 < 0.0f || z.y0 < 0.0f || z.x1 > 1.0f || z.y1 > 1.0f || z.x0 >= z.x1 || z.y0 >= z.y1) return false;
+        parsed.push_back(z);
+    }
+    out.swap(parsed);
+    return true;
+}
+
 const RuntimeConfig& getRuntimeConfig() {
-    static RuntimeConfig cfg = loadRuntimeConfig();
-    return cfg;
+    const RuntimeConfig* cfg = current_snapshot.load(std::memory_order_acquire);
+    if (cfg) return *cfg;
+    std::lock_guard<std::mutex> lock(snapshot_mutex);
+    if (!current_snapshot.load(std::memory_order_acquire)) {
+        RuntimeConfig loaded;
+        std::string error;
+        if (!loadRuntimeConfig(loaded, error)) {
+            // At startup there is nothing to keep: drop the file, and the
+            // environment too if it is the one at fault.
+            std::string env_error;
+            loaded = loadRuntimeConfig();
+            if (validateRuntimeConfig(loaded, env_error)) {
+                std::cerr << "[Config] " << error << ", ignoring NANOSTREAM_CONFIG" << std::endl;
+            } else {
+                std::cerr << "[Config] " << error << ", using defaults" << std::endl;
+                loaded = RuntimeConfig{};
+            }
+        }
+        publishSnapshot(std::move(loaded));
+    }
+    return *current_snapshot.load(std::memory_order_acquire);
+}
+
+uint64_t runtimeConfigVersion() {
+    return snapshot_version.load(std::memory_order_acquire);
+}
+
+bool reloadRuntimeConfig(std::string& error) {
+    RuntimeConfig loaded;
+    if (!loadRuntimeConfig(loaded, error)) return false;
+    std::lock_guard<std::mutex> lock(snapshot_mutex);
+    publishSnapshot(std::move(loaded));
+    return true;
 }
 
 std::string formatRuntimeConfig(const RuntimeConfig& cfg) {
@@ -90,12 +435,76 @@ std::string formatRuntimeConfig(const RuntimeConfig& cfg) {
         << " int8_param=" << cfg.int8Param
         << " int8_bin=" << cfg.int8Bin
         << " labels=" << (cfg.showLabels ? "1" : "0")
+        << " osd=" << (cfg.osdEnabled ? "1" : "0")
+        << " osd_extrapolate=" << (cfg.osdExtrapolate ? "1" : "0")
+        << " osd_max_extrap_ms=" << cfg.osdMaxExtrapolationMs
+        << " osd_delay_ms=" << cfg.osdDelayMs
+        << " enc_bitrate=" << cfg.encBitrateKbps
+        << " enc_threads=" << cfg.encThreads
+        << " enc_governor=" << (cfg.encGovernor ? "1" : "0")
+        << " enc_bitrate_min=" << cfg.encMinBitrateKbps
+        << " enc_fps_min=" << cfg.encMinFps
+        << " net_adaptive=" << (cfg.netAdaptive ? "1" : "0")
+        << " net_bitrate_min=" << cfg.netMinBitrateKbps
+        << " net_test_loss=" << cfg.netTestLoss
+        << " roi_encode=" << (cfg.roiEncode ? "1" : "0")
+        << " roi_crf=" << cfg.roiCrf
+        << " roi_static_sad=" << cfg.roiStaticThreshold
+        << " roi_margin=" << cfg.roiMargin
+        << " roi_max_hold=" << cfg.roiMaxHold
+        << " roi_delta_qp=" << cfg.roiDeltaQp
         << " person_min_score=" << cfg.personMinScore
         << " person_max=" << cfg.personMax
         << " person_min_area_ratio=" << cfg.personMinAreaRatio
         << " person_ar_min=" << cfg.personArMin
         << " person_ar_max=" << cfg.personArMax
         << " rtsp_host=" << (cfg.rtspHost.empty() ? "<device-ip>" : cfg.rtspHost)
+        << " cameras=";
+    for (size_t i = 0; i < cfg.cameras.size(); ++i) {
+        out << (i > 0 ? "," : "") << cfg.cameras[i];
+    }
+    if (cfg.cameras.empty()) out << "<default>";
+    out << " sub=" << (cfg.subEnabled ? "1" : "0")
+        << " sub_size=" << cfg.subWidth << "x" << cfg.subHeight
+        << " sub_bitrate=" << cfg.subBitrateKbps
+        << " sub_share_ai=" << (cfg.subShareAi ? "1" : "0")
+        << " meta=" << (cfg.metaEnabled ? "1" : "0")
+        << " meta_udp=" << cfg.metaUdpHost << ":" << cfg.metaUdpPort
+        << " meta_http_port=" << cfg.metaHttpPort
+        << " webrtc=" << (cfg.webrtcEnabled ? "1" : "0")
+        << " webrtc_port=" << cfg.webrtcPort
+        << " webrtc_bind=" << cfg.webrtcBind
+        << " webrtc_max_sessions=" << cfg.webrtcMaxSessions
+        << " webrtc_stun=" << (cfg.webrtcStun.empty() ? "<none>" : cfg.webrtcStun)
+        << " share=" << (cfg.shareEnabled ? "1" : "0")
+        << " share_socket=" << cfg.shareSocket
+        << " share_camera=" << (cfg.shareCamera ? "1" : "0")
+        << " share_ai=" << (cfg.shareAiInput ? "1" : "0")
+        << " share_slots=" << cfg.shareSlots
+        << " events=" << (cfg.eventsEnabled ? "1" : "0")
+        << " events_url=" << cfg.eventsUrl
+        << " events_zones=" << (cfg.eventsZones.empty() ? "<none>" : cfg.eventsZones)
+        << " events_min_hits=" << cfg.eventsMinHits
+        << " events_exit_ms=" << cfg.eventsExitMs
+        << " events_queue=" << cfg.eventsQueue
+        << " events_batch_ms=" << cfg.eventsBatchMs
+        << " events_drop=" << cfg.eventsDrop
+        << " rec=" << (cfg.recEnabled ? "1" : "0")
+        << " rec_dir=" << cfg.recDir
+        << " rec_format=" << cfg.recFormat
+        << " rec_labels=" << (cfg.recLabels.empty() ? "<any>" : cfg.recLabels)
+        << " rec_min_score=" << cfg.recMinScore
+        << " rec_pre_sec=" << cfg.recPreRollSec
+        << " rec_post_sec=" << cfg.recPostRollSec
+        << " rec_max_sec=" << cfg.recMaxClipSec
+        << " rec_ring_kb=" << cfg.recRingKb
+        << " cpu_stream=" << (cfg.cpuStream.empty() ? "<any>" : cfg.cpuStream)
+        << " cpu_ai=" << (cfg.cpuAi.empty() ? "<any>" : cfg.cpuAi)
+        << " rt_prio=" << cfg.streamRtPriority
+        << " ai_nice=" << cfg.aiNice
+        << " perf=" << (cfg.perfProfile ? "1" : "0")
+        << " perf_report=" << cfg.perfReport
+        << " perf_interval=" << cfg.perfIntervalSec
         << " det_input_w=" << cfg.detInputWidth
         << " det_input_h=" << cfg.detInputHeight
         << " det_topk=" << cfg.detTopK
@@ -110,7 +519,22 @@ std::string formatRuntimeConfig(const RuntimeConfig& cfg) {
         << " det_cap_area_med=" << cfg.detCapMediumAreaThreshold
         << " det_iou=" << cfg.detIouThreshold
         << " det_ema=" << cfg.detEmaAlpha
-        << " det_heads=" << (cfg.detHeads.empty() ? "<default>" : cfg.detHeads);
+        << " det_heads=" << (cfg.detHeads.empty() ? "<default>" : cfg.detHeads)
+        << " det_cascade=" << (cfg.detCascade ? "1" : "0")
+        << " det_cascade_input=" << cfg.detCascadeInput
+        << " det_cascade_roi_input=" << cfg.detCascadeRoiInput
+        << " det_cascade_max_rois=" << cfg.detCascadeMaxRois
+        << " det_cascade_proposal_score=" << cfg.detCascadeProposalScore
+        << " det_cascade_refine_area=" << cfg.detCascadeRefineArea
+        << " det_adaptive=" << (cfg.detAdaptiveInput ? "1" : "0")
+        << " det_input_steps=";
+    for (size_t i = 0; i < cfg.detInputSteps.size(); ++i) {
+        out << (i > 0 ? "," : "") << cfg.detInputSteps[i];
+    }
+    out << " det_latency_budget_ms=" << cfg.detLatencyBudgetMs
+        << " det_decode_threads=" << cfg.detDecodeThreads
+        << " det_batch=" << cfg.detBatch
+        << " det_schedule=" << cfg.detSchedule;
     return out.str();
 }
 
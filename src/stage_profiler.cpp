@@ -0,0 +1,259 @@
+#include "stage_profiler.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <vector>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace stage_profiler {
+
+namespace {
+
+std::atomic<bool> profiling{false};
+std::atomic<bool> unavailable_logged{false};
+
+struct StageTotals {
+    std::string name;
+    uint64_t calls = 0;
+    uint64_t countedCalls[kCounterCount] = {};
+    double ns = 0.0;
+    double counts[kCounterCount] = {};
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<StageTotals> stages;
+    uint64_t missing[kCounterCount] = {};   // threads where the event could not be opened
+    uint64_t threads = 0;
+};
+
+Registry& registry() {
+    static Registry r;
+    return r;
+}
+
+constexpr uint64_t cacheEvent(uint64_t cache, uint64_t op, uint64_t result) {
+    return cache | (op << 8) | (result << 16);
+}
+
+struct EventSpec {
+    uint32_t type;
+    uint64_t config;
+};
+
+const EventSpec kEvents[kCounterCount] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HW_CACHE, cacheEvent(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_ACCESS)},
+    {PERF_TYPE_HW_CACHE, cacheEvent(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+    {PERF_TYPE_HW_CACHE, cacheEvent(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+int openEvent(uint32_t type, uint64_t config, int group_fd) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1;    // allowed at perf_event_paranoid 2
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC));
+}
+
+// One counter group per thread, opened on its first Scope. Counters are
+// per thread, so work a stage hands to other threads (ncnn's OpenMP team)
+// is not included.
+class ThreadGroup {
+public:
+    ThreadGroup() {
+        leader = openEvent(kEvents[kCycles].type, kEvents[kCycles].config, -1);
+        if (leader < 0) {
+            if (!unavailable_logged.exchange(true)) {
+                std::cerr << "[Perf] Hardware counters unavailable (" << std::strerror(errno)
+                          << "), stages record wall time only" << std::endl;
+            }
+            return;
+        }
+        slot[kCycles] = 0;
+        int next = 1;
+        for (int c = kCycles + 1; c < kCounterCount; ++c) {
+            int fd = openEvent(kEvents[c].type, kEvents[c].config, leader);
+            // Some PMUs have no generic LLC read-miss mapping; fall back to
+            // the plain cache-miss event.
+            if (fd < 0 && c == kLlcMisses) fd = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, leader);
+            if (fd < 0) continue;
+            members.push_back(fd);
+            slot[c] = next++;
+        }
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        registry().threads++;
+        for (int c = 0; c < kCounterCount; ++c) {
+            if (slot[c] < 0) registry().missing[c]++;
+        }
+    }
+
+    ~ThreadGroup() {
+        for (int fd : members) close(fd);
+        if (leader >= 0) close(leader);
+    }
+
+    bool read(Snapshot& snap) const {
+        if (leader < 0) return false;
+        uint64_t buf[3 + kCounterCount];
+        const ssize_t want = static_cast<ssize_t>(sizeof(uint64_t) * (3 + members.size() + 1));
+        if (::read(leader, buf, sizeof(buf)) < want) return false;
+        snap.enabledNs = buf[1];
+        snap.runningNs = buf[2];
+        for (int c = 0; c < kCounterCount; ++c) {
+            snap.values[c] = slot[c] >= 0 ? buf[3 + slot[c]] : 0;
+        }
+        return true;
+    }
+
+    bool has(int counter) const { return slot[counter] >= 0; }
+
+private:
+    int leader = -1;
+    std::vector<int> members;
+    int slot[kCounterCount] = {-1, -1, -1, -1, -1, -1, -1};
+};
+
+ThreadGroup& threadGroup() {
+    thread_local ThreadGroup group;
+    return group;
+}
+
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::string perCall(double total, uint64_t calls, double scale, const char* fmt) {
+    if (calls == 0) return "n/a";
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), fmt, total / calls / scale);
+    return buf;
+}
+
+std::string ratio(double num, double den, double scale, const char* fmt) {
+    if (den <= 0.0) return "n/a";
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), fmt, scale * num / den);
+    return buf;
+}
+
+}
+
+void enable() {
+    profiling.store(true);
+}
+
+bool enabled() {
+    return profiling.load(std::memory_order_relaxed);
+}
+
+int stage(const std::string& name) {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (size_t i = 0; i < r.stages.size(); ++i) {
+        if (r.stages[i].name == name) return static_cast<int>(i);
+    }
+    r.stages.emplace_back();
+    r.stages.back().name = name;
+    return static_cast<int>(r.stages.size() - 1);
+}
+
+Scope::Scope(int stage) : stage_(stage), active_(enabled()) {
+    if (!active_) return;
+    start_.counters = threadGroup().read(start_);
+    start_.ns = nowNs();
+}
+
+Scope::~Scope() {
+    if (!active_) return;
+    const int64_t end_ns = nowNs();
+    Snapshot end;
+    const ThreadGroup& group = threadGroup();
+    end.counters = start_.counters && group.read(end);
+
+    // Scale each delta by how long the group was actually on the PMU.
+    double scale = 0.0;
+    if (end.counters && end.runningNs > start_.runningNs) {
+        scale = static_cast<double>(end.enabledNs - start_.enabledNs) / (end.runningNs - start_.runningNs);
+    }
+
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    StageTotals& st = r.stages[stage_];
+    st.calls++;
+    st.ns += static_cast<double>(end_ns - start_.ns);
+    if (scale <= 0.0) return;
+    for (int c = 0; c < kCounterCount; ++c) {
+        if (!group.has(c)) continue;
+        st.counts[c] += scale * static_cast<double>(end.values[c] - start_.values[c]);
+        st.countedCalls[c]++;
+    }
+}
+
+std::string formatReport() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    std::ostringstream out;
+    out << "| stage | calls | us/call | Mcycles/call | Minstr/call | IPC | L1D miss % | LLC MPKI | branch miss % |\n"
+        << "|---|---|---|---|---|---|---|---|---|\n";
+    for (const auto& st : r.stages) {
+        if (st.calls == 0) continue;
+        // Ratios only use calls where both counters ran, so mix-and-match
+        // across threads with different event sets stays consistent.
+        const bool ipc = st.countedCalls[kCycles] > 0 && st.countedCalls[kCycles] == st.countedCalls[kInstructions];
+        const bool l1 = st.countedCalls[kL1dAccesses] > 0 && st.countedCalls[kL1dAccesses] == st.countedCalls[kL1dMisses];
+        const bool llc = st.countedCalls[kLlcMisses] > 0 && st.countedCalls[kLlcMisses] == st.countedCalls[kInstructions];
+        const bool br = st.countedCalls[kBranches] > 0 && st.countedCalls[kBranches] == st.countedCalls[kBranchMisses];
+        out << "| " << st.name
+            << " | " << st.calls
+            << " | " << perCall(st.ns, st.calls, 1e3, "%.1f")
+            << " | " << perCall(st.counts[kCycles], st.countedCalls[kCycles], 1e6, "%.3f")
+            << " | " << perCall(st.counts[kInstructions], st.countedCalls[kInstructions], 1e6, "%.3f")
+            << " | " << (ipc ? ratio(st.counts[kInstructions], st.counts[kCycles], 1.0, "%.2f") : "n/a")
+            << " | " << (l1 ? ratio(st.counts[kL1dMisses], st.counts[kL1dAccesses], 100.0, "%.2f") : "n/a")
+            << " | " << (llc ? ratio(st.counts[kLlcMisses], st.counts[kInstructions], 1000.0, "%.2f") : "n/a")
+            << " | " << (br ? ratio(st.counts[kBranchMisses], st.counts[kBranches], 100.0, "%.2f") : "n/a")
+            << " |\n";
+    }
+    static const char* const kNames[kCounterCount] = {
+        "cycles", "instructions", "L1D accesses", "L1D misses", "LLC misses", "branches", "branch misses"};
+    std::string missing;
+    for (int c = 0; c < kCounterCount; ++c) {
+        if (r.missing[c] > 0) missing += (missing.empty() ? "" : ", ") + std::string(kNames[c]);
+    }
+    out << "\nCounters: " << (r.threads == 0 ? "unavailable (wall time only)"
+                              : missing.empty() ? "all available" : "missing " + missing)
+        << ". User space only; work on other threads (ncnn's OpenMP team) is not attributed.\n";
+    return out.str();
+}
+
+bool writeReport(const std::string& path) {
+    const std::string report = formatReport();
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp);
+        if (!out) return false;
+        out << "# Detector stage counters\n\n" << report;
+        if (!out.good()) return false;
+    }
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+}
@@ -0,0 +1,42 @@
+#include "task_pool.hpp"
+
+TaskPool::TaskPool(int threads) {
+    for (int i = 0; i < threads; ++i) workers.emplace_back(&TaskPool::workerLoop, this);
+}
+
+TaskPool::~TaskPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    task_cv.notify_all();
+    for (auto& t : workers) t.join();
+}
+
+void TaskPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+        unfinished++;
+    }
+    task_cv.notify_one();
+}
+
+void TaskPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle_cv.wait(lock, [this] { return unfinished == 0; });
+}
+
+void TaskPool::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        task_cv.wait(lock, [this] { return stopping || !tasks.empty(); });
+        if (tasks.empty()) return;
+        std::function<void()> task = std::move(tasks.front());
+        tasks.pop_front();
+        lock.unlock();
+        task();
+        lock.lock();
+        if (--unfinished == 0) idle_cv.notify_all();
+    }
+}
@@ -0,0 +1,125 @@
+#include "thread_topology.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace thread_topology {
+
+namespace {
+
+pid_t currentTid() {
+    return static_cast<pid_t>(syscall(SYS_gettid));
+}
+
+void warnOnce(std::atomic<bool>& warned, const std::string& what) {
+    if (!warned.exchange(true)) {
+        std::cerr << "[Topology] " << what << ": " << std::strerror(errno) << std::endl;
+    }
+}
+
+std::atomic<bool> affinity_warned{false};
+std::atomic<bool> fifo_warned{false};
+std::atomic<bool> nice_warned{false};
+
+}
+
+std::vector<int> parseCpuList(const std::string& spec) {
+    std::vector<int> cpus;
+    std::stringstream in(spec);
+    std::string token;
+    while (std::getline(in, token, ',')) {
+        if (token.empty()) return {};
+        char *end = nullptr;
+        long first = std::strtol(token.c_str(), &end, 10);
+        long last = first;
+        if (*end == '-') last = std::strtol(end + 1, &end, 10);
+        if (*end != '\0' || first < 0 || last < first || last >= CPU_SETSIZE) return {};
+        for (long c = first; c <= last; ++c) cpus.push_back(static_cast<int>(c));
+    }
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+std::string formatCpuList(const std::vector<int>& cpus) {
+    std::string out;
+    for (size_t i = 0; i < cpus.size();) {
+        size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) ++j;
+        if (!out.empty()) out += ",";
+        out += std::to_string(cpus[i]);
+        if (j > i) out += "-" + std::to_string(cpus[j]);
+        i = j + 1;
+    }
+    return out.empty() ? "-" : out;
+}
+
+bool pinCurrentThread(const std::vector<int>& cpus) {
+    if (cpus.empty()) return true;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int c : cpus) CPU_SET(c, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        warnOnce(affinity_warned, "Cannot pin to cores " + formatCpuList(cpus));
+        return false;
+    }
+    return true;
+}
+
+bool setCurrentThreadFifo(int priority) {
+    if (priority <= 0) return true;
+    sched_param param{};
+    param.sched_priority = priority;
+    errno = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (errno != 0) {
+        warnOnce(fifo_warned, "Cannot use SCHED_FIFO/" + std::to_string(priority));
+        return false;
+    }
+    return true;
+}
+
+bool setCurrentThreadNice(int nice) {
+    // PRIO_PROCESS with a tid targets just that thread on Linux.
+    if (setpriority(PRIO_PROCESS, static_cast<id_t>(currentTid()), nice) != 0) {
+        warnOnce(nice_warned, "Cannot set nice " + std::to_string(nice));
+        return false;
+    }
+    return true;
+}
+
+std::string describeCurrentThread() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int c = 0; c < CPU_SETSIZE; ++c) {
+            if (CPU_ISSET(c, &set)) cpus.push_back(c);
+        }
+    }
+    int policy = 0;
+    sched_param param{};
+    pthread_getschedparam(pthread_self(), &policy, &param);
+
+    std::ostringstream out;
+    out << "tid=" << currentTid() << " cpus=" << formatCpuList(cpus);
+    if (policy == SCHED_FIFO || policy == SCHED_RR) {
+        out << (policy == SCHED_FIFO ? " SCHED_FIFO/" : " SCHED_RR/") << param.sched_priority;
+    } else {
+        errno = 0;
+        int nice = getpriority(PRIO_PROCESS, static_cast<id_t>(currentTid()));
+        out << " SCHED_OTHER nice=" << (errno == 0 ? nice : 0);
+    }
+    return out.str();
+}
+
+}
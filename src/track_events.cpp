@@ -0,0 +1,150 @@
+#include "track_events.hpp"
+
+#include <algorithm>
+
+namespace {
+
+float iou(const Detection& a, const Detection& b) {
+    int x1 = std::max(a.x, b.x);
+    int y1 = std::max(a.y, b.y);
+    int x2 = std::min(a.x + a.w, b.x + b.w);
+    int y2 = std::min(a.y + a.h, b.y + b.h);
+    int inter = std::max(0, x2 - x1) * std::max(0, y2 - y1);
+    int uni = a.w * a.h + b.w * b.h - inter;
+    return uni > 0 ? static_cast<float>(inter) / uni : 0.0f;
+}
+
+}
+
+const char* TrackEvent::typeName(Type type) {
+    switch (type) {
+    case Enter: return "enter";
+    case Exit: return "exit";
+    case Zone: return "zone";
+    case Class: return "class";
+    }
+    return "unknown";
+}
+
+void TrackEventTracker::configure(const Config& cfg) {
+    config = cfg;
+    tracks.clear();
+}
+
+std::string TrackEventTracker::zoneOf(const Detection& d, int frame_w, int frame_h) const {
+    if (frame_w <= 0 || frame_h <= 0) return "";
+    const float cx = (d.x + d.w * 0.5f) / frame_w;
+    const float cy = (d.y + d.h * 0.5f) / frame_h;
+    for (const auto& z : config.zones) {
+        if (cx >= z.x0 && cx < z.x1 && cy >= z.y0 && cy < z.y1) return z.name;
+    }
+    return "";
+}
+
+TrackEvent TrackEventTracker::makeEvent(TrackEvent::Type type, const Track& track, const DetectionFrame& frame) const {
+    TrackEvent ev;
+    ev.type = type;
+    ev.camera = frame.camera;
+    ev.track = track.id;
+    ev.classId = track.box.class_id;
+    ev.label = track.box.label;
+    ev.zone = track.zone;
+    ev.score = track.box.score;
+    ev.x = track.box.x;
+    ev.y = track.box.y;
+    ev.w = track.box.w;
+    ev.h = track.box.h;
+    ev.pts = frame.pts;
+    ev.timestampUs = frame.timestampUs;
+    return ev;
+}
+
+void TrackEventTracker::update(const DetectionFrame& frame, std::vector<TrackEvent>& events) {
+    const int64_t now = frame.timestampUs;
+    const size_t existing = tracks.size();
+    std::vector<bool> matched(existing, false);
+
+    for (const auto& d : frame.detections) {
+        int best = -1;
+        float best_iou = config.iouThreshold;
+        for (size_t i = 0; i < existing; ++i) {
+            if (matched[i] || tracks[i].box.class_id != d.class_id) continue;
+            float v = iou(tracks[i].box, d);
+            if (v >= best_iou) {
+                best_iou = v;
+                best = static_cast<int>(i);
+            }
+        }
+        // A relabelled object keeps its track if it barely moved.
+        if (best < 0) {
+            best_iou = config.classIouThreshold;
+            for (size_t i = 0; i < existing; ++i) {
+                if (matched[i]) continue;
+                float v = iou(tracks[i].box, d);
+                if (v >= best_iou) {
+                    best_iou = v;
+                    best = static_cast<int>(i);
+                }
+            }
+        }
+        const std::string zone = zoneOf(d, frame.frameWidth, frame.frameHeight);
+        if (best < 0) {
+            Track t;
+            t.id = next_id++;
+            t.box = d;
+            t.hits = 1;
+            t.lastSeenUs = now;
+            t.zone = zone;
+            if (config.minHits <= 1) {
+                t.confirmed = true;
+                events.push_back(makeEvent(TrackEvent::Enter, t, frame));
+            }
+            tracks.push_back(t);
+            continue;
+        }
+
+        Track& t = tracks[best];
+        matched[best] = true;
+        if (t.confirmed && t.box.class_id != d.class_id) {
+            Track relabelled = t;
+            relabelled.box = d;
+            TrackEvent ev = makeEvent(TrackEvent::Class, relabelled, frame);
+            ev.fromClassId = t.box.class_id;
+            ev.fromLabel = t.box.label;
+            events.push_back(ev);
+        }
+        t.box = d;
+        t.hits++;
+        t.lastSeenUs = now;
+        if (!t.confirmed) {
+            t.zone = zone;
+            if (t.hits >= config.minHits) {
+                t.confirmed = true;
+                events.push_back(makeEvent(TrackEvent::Enter, t, frame));
+            }
+        } else if (zone != t.zone) {
+            TrackEvent ev = makeEvent(TrackEvent::Zone, t, frame);
+            ev.fromZone = t.zone;
+            ev.zone = zone;
+            t.zone = zone;
+            events.push_back(ev);
+        }
+    }
+
+    // Tentative tracks need consecutive hits; confirmed ones ride out
+    // missed detections for exitMs before they are reported gone.
+    size_t keep = 0;
+    for (size_t i = 0; i < tracks.size(); ++i) {
+        Track& t = tracks[i];
+        if (i < existing && !matched[i]) {
+            if (!t.confirmed) continue;
+            if (now - t.lastSeenUs >= static_cast<int64_t>(config.exitMs) * 1000) {
+                events.push_back(makeEvent(TrackEvent::Exit, t, frame));
+                continue;
+            }
+        }
+        if (keep != i) tracks[keep] = std::move(t);
+        ++keep;
+    }
+    tracks.resize(keep);
+}
@@ -0,0 +1,700 @@
+#include "webrtc_service.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <gst/app/gstappsrc.h>
+#include <gst/sdp/sdp.h>
+#include <gst/video/video.h>
+#define GST_USE_UNSTABLE_API
+#include <gst/webrtc/webrtc.h>
+
+namespace {
+
+// A viewer whose pipeline holds this much is not keeping up; drop whole
+// access units rather than let latency build.
+constexpr guint64 kMaxQueuedBytes = 1024 * 1024;
+constexpr int kMaxSessions = 16;
+constexpr int64_t kConnectTimeoutUs = 20 * G_USEC_PER_SEC;
+constexpr int64_t kDisconnectGraceUs = 5 * G_USEC_PER_SEC;
+constexpr int64_t kKeyframeIntervalUs = G_USEC_PER_SEC;
+constexpr int kGatherTimeoutMs = 3000;
+constexpr size_t kMaxRequestBytes = 64 * 1024;
+const char kPagePath[] = "deploy/mediamtx/webrtc-simple.html";
+
+void setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags >= 0) fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+bool sendAll(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// WHEP resource ids double as the only credential for DELETE, so they must
+// not be guessable: 128 random bits as hex.
+std::string newSessionId() {
+    std::random_device rd;
+    char id[33];
+    for (int i = 0; i < 4; ++i) std::snprintf(id + i * 8, 9, "%08x", static_cast<unsigned>(rd()));
+    return std::string(id, 32);
+}
+
+bool hasFactory(const char* factory) {
+    GstElementFactory* f = gst_element_factory_find(factory);
+    if (!f) return false;
+    gst_object_unref(f);
+    return true;
+}
+
+void sendResponse(int fd, int status, const char* reason, const std::string& type,
+                  const std::string& body, const std::string& extra = "") {
+    std::ostringstream out;
+    out << "HTTP/1.1 " << status << " " << reason << "\r\n"
+        << "Access-Control-Allow-Origin: *\r\n"
+        << "Access-Control-Allow-Methods: GET, POST, DELETE, OPTIONS\r\n"
+        << "Access-Control-Allow-Headers: Content-Type\r\n"
+        << "Access-Control-Expose-Headers: Location\r\n";
+    if (!type.empty()) out << "Content-Type: " << type << "\r\n";
+    out << extra
+        << "Content-Length: " << body.size() << "\r\n"
+        << "Connection: close\r\n\r\n"
+        << body;
+    const std::string response = out.str();
+    sendAll(fd, response.data(), response.size());
+}
+
+// Picks the H.264 payload type the browser offered with
+// packetization-mode=1, preferring constrained baseline (42e0xx).
+bool pickH264(const std::string& sdp, int& pt, std::string& profile) {
+    std::vector<int> h264;
+    std::istringstream lines(sdp);
+    std::string line;
+    while (std::getline(lines, line)) {
+        int id = 0;
+        char codec[32] = "";
+        if (std::sscanf(line.c_str(), "a=rtpmap:%d %31[^/]", &id, codec) == 2 && std::strcmp(codec, "H264") == 0) {
+            h264.push_back(id);
+        }
+    }
+    pt = -1;
+    lines.clear();
+    lines.seekg(0);
+    while (std::getline(lines, line)) {
+        int id = 0;
+        if (std::sscanf(line.c_str(), "a=fmtp:%d", &id) != 1) continue;
+        bool offered = false;
+        for (int h : h264) offered = offered || h == id;
+        if (!offered || line.find("packetization-mode=1") == std::string::npos) continue;
+        std::string level;
+        size_t at = line.find("profile-level-id=");
+        if (at != std::string::npos) level = line.substr(at + 17, 6);
+        if (pt < 0 || (level.compare(0, 4, "42e0") == 0 && profile.compare(0, 4, "42e0") != 0)) {
+            pt = id;
+            profile = level;
+        }
+    }
+    return pt >= 0;
+}
+
+// Value of a top-level string field in a small JSON object.
+bool jsonString(const std::string& json, const char* key, std::string& out) {
+    const std::string quoted = std::string("\"") + key + "\"";
+    size_t at = json.find(quoted);
+    if (at == std::string::npos) return false;
+    at = json.find(':', at + quoted.size());
+    if (at == std::string::npos) return false;
+    at = json.find('"', at);
+    if (at == std::string::npos) return false;
+    out.clear();
+    for (size_t i = at + 1; i < json.size(); ++i) {
+        char c = json[i];
+        if (c == '"') return true;
+        if (c != '\\' || i + 1 >= json.size()) {
+            out.push_back(c);
+            continue;
+        }
+        c = json[++i];
+        switch (c) {
+        case 'n': out.push_back('\n'); break;
+        case 'r': out.push_back('\r'); break;
+        case 't': out.push_back('\t'); break;
+        case 'u':
+            // SDP is ASCII; anything else is dropped.
+            if (i + 4 < json.size()) {
+                long code = std::strtol(json.substr(i + 1, 4).c_str(), nullptr, 16);
+                if (code > 0 && code < 0x80) out.push_back(static_cast<char>(code));
+                i += 4;
+            }
+            break;
+        default: out.push_back(c); break;
+        }
+    }
+    return false;
+}
+
+std::string jsonEscape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out.push_back('\\');
+            out.push_back(c);
+        } else if (c == '\r') {
+            out += "\\r";
+        } else if (c == '\n') {
+            out += "\\n";
+        } else if (static_cast<unsigned char>(c) >= 0x20) {
+            out.push_back(c);
+        }
+    }
+    return out;
+}
+
+// Runs a webrtcbin action signal and waits for its promise. Returns the
+// reply, or null on error; the caller frees it.
+GstStructure* emitAndWait(GstElement* webrtc, const char* signal, GstWebRTCSessionDescription* desc) {
+    GstPromise* promise = gst_promise_new();
+    if (desc) g_signal_emit_by_name(webrtc, signal, desc, promise);
+    else g_signal_emit_by_name(webrtc, signal, NULL, promise);
+    GstStructure* reply = nullptr;
+    if (gst_promise_wait(promise) == GST_PROMISE_RESULT_REPLIED) {
+        const GstStructure* s = gst_promise_get_reply(promise);
+        if (s && gst_structure_has_field(s, "error")) {
+            GError* error = nullptr;
+            gst_structure_get(s, "error", G_TYPE_ERROR, &error, NULL);
+            std::cerr << "[WebRTC] " << signal << " failed: " << (error ? error->message : "unknown") << std::endl;
+            if (error) g_error_free(error);
+        } else {
+            reply = s ? gst_structure_copy(s) : gst_structure_new_empty("reply");
+        }
+    }
+    gst_promise_unref(promise);
+    return reply;
+}
+
+}
+
+struct WebRTCServer::Session {
+    WebRTCServer* server = nullptr;
+    int path = 0;
+    std::string id;
+    GstElement* pipeline = nullptr;
+    GstElement* app_src = nullptr;
+    GstElement* webrtc = nullptr;
+    int64_t created_us = 0;
+    std::atomic<bool> connected{false};
+    std::atomic<bool> closing{false};
+    std::atomic<int64_t> disconnected_us{0};
+    std::atomic<int64_t> last_keyframe_us{0};
+    std::atomic<guint64> dropped{0};
+    // Delta units are dropped until a keyframe: at the start, and after
+    // any drop, so the browser never decodes a broken GOP.
+    std::atomic<bool> waiting_idr{true};
+};
+
+WebRTCServer::WebRTCServer() {}
+
+WebRTCServer::~WebRTCServer() {
+    stop();
+}
+
+int WebRTCServer::addPath(const std::string& path) {
+    paths.push_back(Path{path, nullptr});
+    return static_cast<int>(paths.size()) - 1;
+}
+
+void WebRTCServer::setKeyframeRequest(int path, std::function<void()> request) {
+    if (path < 0 || path >= static_cast<int>(paths.size())) return;
+    std::lock_guard<std::mutex> lock(sessions_mutex);
+    paths[path].keyframe_request = std::move(request);
+}
+
+bool WebRTCServer::start(const Config& cfg) {
+    if (running) return true;
+    config = cfg;
+    for (const char* factory : {"webrtcbin", "rtph264pay", "h264parse", "dtlssrtpenc", "srtpenc", "nicesink"}) {
+        if (!hasFactory(factory)) {
+            std::cerr << "[WebRTC] Missing GStreamer element " << factory
+                      << " (gstreamer1.0-plugins-bad, gstreamer1.0-nice), WebRTC disabled" << std::endl;
+            return false;
+        }
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(config.port));
+    listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    if (listen_fd >= 0) setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (listen_fd < 0 || inet_pton(AF_INET, config.bind.c_str(), &addr.sin_addr) != 1 ||
+        bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(listen_fd, 8) != 0) {
+        std::cerr << "[WebRTC] Cannot listen on " << config.bind << ":" << config.port << ": "
+                  << std::strerror(errno) << std::endl;
+        if (listen_fd >= 0) close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+    if (pipe(wake_pipe) != 0) {
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+    setNonBlocking(listen_fd);
+
+    std::ifstream in(kPagePath);
+    if (in) {
+        std::stringstream buffer;
+        buffer << in.rdbuf();
+        page = buffer.str();
+    }
+
+    running = true;
+    serve_thread = std::thread(&WebRTCServer::serveLoop, this);
+    reap_tick_id = g_timeout_add_seconds(1, on_reap_tick, this);
+    const std::string host = config.bind == "0.0.0.0" ? "<device-ip>" : config.bind;
+    for (const auto& path : paths) {
+        std::cout << "[WebRTC] Signaling at http://" << host << ":" << config.port << "/" << path.name
+                  << "/whep (WHEP) and /" << path.name << "/webrtc (JSON)" << std::endl;
+    }
+    if (!page.empty()) std::cout << "[WebRTC] Player page at http://" << host << ":" << config.port << "/" << std::endl;
+    return true;
+}
+
+void WebRTCServer::stop() {
+    if (!running.exchange(false)) return;
+    char c = 0;
+    if (write(wake_pipe[1], &c, 1) < 0) {}
+    if (serve_thread.joinable()) serve_thread.join();
+    if (reap_tick_id) g_source_remove(reap_tick_id);
+    reap_tick_id = 0;
+    std::vector<std::shared_ptr<Session>> closing;
+    {
+        std::lock_guard<std::mutex> lock(sessions_mutex);
+        closing.swap(sessions);
+    }
+    for (auto& session : closing) teardown(*session);
+    for (int* fd : {&listen_fd, &wake_pipe[0], &wake_pipe[1]}) {
+        if (*fd >= 0) close(*fd);
+        *fd = -1;
+    }
+}
+
+void WebRTCServer::pushBuffer(int path, GstBuffer* buffer) {
+    if (!running) return;
+    // Owning snapshot: the reap tick may drop a session from the list and
+    // free it while this thread is still pushing to it.
+    std::shared_ptr<Session> targets[kMaxSessions];
+    GstElement* srcs[kMaxSessions];
+    int count = 0;
+    std::function<void()> request;
+    {
+        std::lock_guard<std::mutex> lock(sessions_mutex);
+        request = paths[path].keyframe_request;
+        for (auto& session : sessions) {
+            if (count == kMaxSessions) break;
+            if (session->path != path || !session->connected || session->closing) continue;
+            targets[count] = session;
+            srcs[count++] = GST_ELEMENT(gst_object_ref(session->app_src));
+        }
+    }
+    const bool keyframe = !GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+    bool request_keyframe = false;
+    for (int i = 0; i < count; ++i) {
+        Session& session = *targets[i];
+        const bool behind = gst_app_src_get_current_level_bytes(GST_APP_SRC(srcs[i])) > kMaxQueuedBytes;
+        if (behind || (session.waiting_idr && !keyframe)) {
+            // Deltas before the first keyframe are not losses; the connect
+            // handler has already asked for an IDR.
+            if (behind || session.dropped > 0) {
+                guint64 dropped = ++session.dropped;
+                if (dropped % 30 == 1) {
+                    std::cerr << "[WebRTC] Viewer " << session.id << " behind, dropped "
+                              << dropped << " access units" << std::endl;
+                }
+            }
+            // PLIs are limited to one a second, so don't wait for the
+            // browser: ask for an IDR as soon as this viewer starts
+            // waiting, and again if the keyframe itself was dropped.
+            if (behind && (!session.waiting_idr.exchange(true) || keyframe)) request_keyframe = true;
+        } else {
+            session.waiting_idr = false;
+            // Shallow copy, restamped on arrival like the RTSP mounts.
+            GstBuffer* out = gst_buffer_copy(buffer);
+            GST_BUFFER_PTS(out) = GST_CLOCK_TIME_NONE;
+            GST_BUFFER_DTS(out) = GST_CLOCK_TIME_NONE;
+            gst_app_src_push_buffer(GST_APP_SRC(srcs[i]), out);
+        }
+        gst_object_unref(srcs[i]);
+        targets[i].reset();
+    }
+    if (request_keyframe && request) request();
+}
+
+void WebRTCServer::serveLoop() {
+    while (running) {
+        pollfd fds[2] = {{wake_pipe[0], POLLIN, 0}, {listen_fd, POLLIN, 0}};
+        if (poll(fds, 2, 1000) < 0 && errno != EINTR) break;
+        if (!running) break;
+        if (!(fds[1].revents & POLLIN)) continue;
+        while (true) {
+            int fd = accept(listen_fd, nullptr, nullptr);
+            if (fd < 0) break;
+            handleClient(fd);
+            close(fd);
+        }
+    }
+}
+
+void WebRTCServer::handleClient(int fd) {
+    // One request per connection. Negotiation blocks this thread for at
+    // most the ICE gathering timeout; viewers are few.
+    std::string request;
+    size_t header_end = std::string::npos;
+    size_t content_length = 0;
+    char buf[4096];
+    while (request.size() < kMaxRequestBytes) {
+        pollfd p{fd, POLLIN, 0};
+        if (poll(&p, 1, 2000) <= 0) return;
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) return;
+        request.append(buf, static_cast<size_t>(n));
+        if (header_end == std::string::npos) {
+            header_end = request.find("\r\n\r\n");
+            if (header_end == std::string::npos) continue;
+            std::string headers = request.substr(0, header_end);
+            for (auto& ch : headers) ch = static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+            size_t at = headers.find("\r\ncontent-length:");
+            if (at != std::string::npos) content_length = std::strtoul(headers.c_str() + at + 17, nullptr, 10);
+        }
+        if (request.size() >= header_end + 4 + content_length) break;
+    }
+    if (header_end == std::string::npos || request.size() < header_end + 4 + content_length) return;
+
+    std::istringstream first_line(request.substr(0, request.find("\r\n")));
+    std::string method, target;
+    first_line >> method >> target;
+    const std::string body = request.substr(header_end + 4, content_length);
+    target = target.substr(0, target.find('?'));
+
+    if (method == "OPTIONS") {
+        sendResponse(fd, 204, "No Content", "", "");
+        return;
+    }
+    if (method == "GET" && (target == "/" || target == "/index.html") && !page.empty()) {
+        // Point the page's defaults at this server.
+        std::string host = "127.0.0.1:" + std::to_string(config.port);
+        size_t at = request.find("\r\nHost: ");
+        if (at != std::string::npos) host = request.substr(at + 8, request.find("\r\n", at + 8) - at - 8);
+        const std::string hostname = host.substr(0, host.rfind(':'));
+        std::string html = page;
+        for (const auto& swap : {std::make_pair(std::string("http://192.168.1.48:8889/"), "http://" + host + "/"),
+                                 std::make_pair(std::string("http://192.168.1.48:8081/"), "http://" + hostname + ":8081/")}) {
+            size_t pos = html.find(swap.first);
+            if (pos != std::string::npos) html.replace(pos, swap.first.size(), swap.second);
+        }
+        sendResponse(fd, 200, "OK", "text/html; charset=utf-8", html);
+        return;
+    }
+
+    // /<path>/webrtc, /<path>/whep or /<path>/whep/<session>
+    std::vector<std::string> parts;
+    std::istringstream segments(target);
+    std::string segment;
+    while (std::getline(segments, segment, '/')) {
+        if (!segment.empty()) parts.push_back(segment);
+    }
+    int path = -1;
+    for (size_t i = 0; !parts.empty() && i < paths.size(); ++i) {
+        if (paths[i].name == parts[0]) path = static_cast<int>(i);
+    }
+    const bool json = parts.size() == 2 && parts[1] == "webrtc";
+    const bool whep = parts.size() == 2 && parts[1] == "whep";
+    if (method == "DELETE" && parts.size() == 3 && parts[1] == "whep" && path >= 0) {
+        closeSession(parts[2]);
+        sendResponse(fd, 200, "OK", "", "");
+        return;
+    }
+    if (method != "POST" || path < 0 || (!json && !whep)) {
+        sendResponse(fd, 404, "Not Found", "", "");
+        return;
+    }
+
+    std::string offer = body;
+    if (json && !jsonString(body, "sdp", offer)) {
+        sendResponse(fd, 400, "Bad Request", "text/plain", "expected {\"type\":\"offer\",\"sdp\":...}\n");
+        return;
+    }
+    std::string session_id;
+    int status = 500;
+    const std::string answer = negotiate(path, offer, session_id, status);
+    if (answer.empty()) {
+        const char* reason = status == 400 ? "Bad Request" : status == 503 ? "Service Unavailable" : "Internal Server Error";
+        sendResponse(fd, status, reason, "text/plain", std::string(reason) + "\n");
+        return;
+    }
+    if (json) {
+        sendResponse(fd, 200, "OK", "application/json",
+                     "{\"type\":\"answer\",\"sdp\":\"" + jsonEscape(answer) + "\"}");
+    } else {
+        sendResponse(fd, 201, "Created", "application/sdp", answer,
+                     "Location: /" + paths[path].name + "/whep/" + session_id + "\r\n");
+    }
+}
+
+std::string WebRTCServer::negotiate(int path, const std::string& offer_sdp, std::string& session_id, int& status) {
+    int pt = -1;
+    std::string profile;
+    if (!pickH264(offer_sdp, pt, profile)) {
+        std::cerr << "[WebRTC] Offer has no H.264 with packetization-mode=1" << std::endl;
+        status = 400;
+        return "";
+    }
+    {
+        std::lock_guard<std::mutex> lock(sessions_mutex);
+        if (static_cast<int>(sessions.size()) >= std::min(config.maxSessions, kMaxSessions)) {
+            std::cerr << "[WebRTC] " << sessions.size() << " viewers already, refusing another" << std::endl;
+            status = 503;
+            return "";
+        }
+    }
+
+    auto session = std::make_shared<Session>();
+    session->server = this;
+    session->path = path;
+    session->id = newSessionId();
+    session->created_us = g_get_monotonic_time();
+
+    // The payloader's caps carry the browser's payload type and profile so
+    // webrtcbin matches the offered m-line to this send-only transceiver.
+    std::string rtp_caps = "application/x-rtp,media=video,encoding-name=H264,clock-rate=90000,payload=" +
+                           std::to_string(pt) + ",packetization-mode=(string)1";
+    if (!profile.empty()) rtp_caps += ",profile-level-id=(string)" + profile;
+    const std::string launch =
+        "appsrc name=src is-live=true format=time do-timestamp=true "
+        "caps=\"video/x-h264,stream-format=byte-stream,alignment=au\" ! "
+        "h264parse ! rtph264pay config-interval=-1 pt=" + std::to_string(pt) + " ! " +
+        rtp_caps + " ! webrtcbin name=webrtc bundle-policy=max-bundle";
+    GError* error = nullptr;
+    session->pipeline = gst_parse_launch(launch.c_str(), &error);
+    if (!session->pipeline) {
+        std::cerr << "[WebRTC] Cannot build viewer pipeline: " << (error ? error->message : "unknown") << std::endl;
+        if (error) g_error_free(error);
+        return "";
+    }
+    session->app_src = gst_bin_get_by_name(GST_BIN(session->pipeline), "src");
+    session->webrtc = gst_bin_get_by_name(GST_BIN(session->pipeline), "webrtc");
+    if (!config.stunServer.empty()) g_object_set(session->webrtc, "stun-server", config.stunServer.c_str(), NULL);
+#if GST_CHECK_VERSION(1, 22, 0)
+    if (config.bind != "0.0.0.0") {
+        GstWebRTCICE* ice = nullptr;
+        g_object_get(session->webrtc, "ice-agent", &ice, NULL);
+        if (ice) {
+            gst_webrtc_ice_add_local_ip_address(ice, config.bind.c_str());
+            gst_object_unref(ice);
+        }
+    }
+#endif
+    GstWebRTCRTPTransceiver* transceiver = nullptr;
+    g_signal_emit_by_name(session->webrtc, "get-transceiver", 0, &transceiver);
+    if (transceiver) {
+        GstCaps* caps = gst_caps_from_string(rtp_caps.c_str());
+        g_object_set(transceiver, "direction", GST_WEBRTC_RTP_TRANSCEIVER_DIRECTION_SENDONLY,
+                     "codec-preferences", caps, NULL);
+        gst_caps_unref(caps);
+        gst_object_unref(transceiver);
+    }
+    g_signal_connect(session->webrtc, "notify::connection-state", G_CALLBACK(on_connection_state), session.get());
+    GstPad* src_pad = gst_element_get_static_pad(session->app_src, "src");
+    gst_pad_add_probe(src_pad, GST_PAD_PROBE_TYPE_EVENT_UPSTREAM, on_upstream_event, session.get(), nullptr);
+    gst_object_unref(src_pad);
+
+    std::string answer_sdp;
+    GstSDPMessage* sdp = nullptr;
+    gst_sdp_message_new(&sdp);
+    if (gst_element_set_state(session->pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE ||
+        gst_sdp_message_parse_buffer(reinterpret_cast<const guint8*>(offer_sdp.data()),
+                                     static_cast<guint>(offer_sdp.size()), sdp) != GST_SDP_OK) {
+        gst_sdp_message_free(sdp);
+        status = 400;
+        teardown(*session);
+        return "";
+    }
+    GstWebRTCSessionDescription* offer = gst_webrtc_session_description_new(GST_WEBRTC_SDP_TYPE_OFFER, sdp);
+    GstStructure* reply = emitAndWait(session->webrtc, "set-remote-description", offer);
+    gst_webrtc_session_description_free(offer);
+    GstWebRTCSessionDescription* answer = nullptr;
+    if (reply) {
+        gst_structure_free(reply);
+        reply = emitAndWait(session->webrtc, "create-answer", nullptr);
+        if (reply) gst_structure_get(reply, "answer", GST_TYPE_WEBRTC_SESSION_DESCRIPTION, &answer, NULL);
+        if (reply) gst_structure_free(reply);
+    }
+    if (answer) {
+        reply = emitAndWait(session->webrtc, "set-local-description", answer);
+        gst_webrtc_session_description_free(answer);
+        if (reply) {
+            gst_structure_free(reply);
+            // Non-trickle: the answer carries every local candidate. Host
+            // candidates on a LAN or loopback gather in milliseconds.
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kGatherTimeoutMs);
+            GstWebRTCICEGatheringState gathering = GST_WEBRTC_ICE_GATHERING_STATE_NEW;
+            while (std::chrono::steady_clock::now() < deadline) {
+                g_object_get(session->webrtc, "ice-gathering-state", &gathering, NULL);
+                if (gathering == GST_WEBRTC_ICE_GATHERING_STATE_COMPLETE) break;
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            GstWebRTCSessionDescription* local = nullptr;
+            g_object_get(session->webrtc, "local-description", &local, NULL);
+            if (local) {
+                gchar* text = gst_sdp_message_as_text(local->sdp);
+                answer_sdp = text;
+                g_free(text);
+                gst_webrtc_session_description_free(local);
+            }
+        }
+    }
+    if (answer_sdp.empty()) {
+        teardown(*session);
+        return "";
+    }
+
+    session_id = session->id;
+    {
+        std::lock_guard<std::mutex> lock(sessions_mutex);
+        sessions.push_back(session);
+    }
+    std::cout << "[WebRTC] Viewer " << session->id << " on /" << paths[path].name << " (H.264 pt " << pt
+              << (profile.empty() ? "" : ", profile-level-id " + profile) << ")" << std::endl;
+    status = 201;
+    return answer_sdp;
+}
+
+void WebRTCServer::closeSession(const std::string& id) {
+    std::lock_guard<std::mutex> lock(sessions_mutex);
+    for (auto& session : sessions) {
+        if (session->id == id) session->closing = true;
+    }
+}
+
+void WebRTCServer::teardown(Session& session) {
+    if (!session.pipeline) return;
+    gst_element_set_state(session.pipeline, GST_STATE_NULL);
+    if (session.webrtc) {
+        g_signal_handlers_disconnect_by_data(session.webrtc, &session);
+        gst_object_unref(session.webrtc);
+    }
+    if (session.app_src) gst_object_unref(session.app_src);
+    gst_object_unref(session.pipeline);
+    session.pipeline = nullptr;
+    session.webrtc = nullptr;
+    session.app_src = nullptr;
+}
+
+void WebRTCServer::on_connection_state(GstElement* webrtc, GParamSpec*, gpointer user_data) {
+    auto* session = static_cast<Session*>(user_data);
+    GstWebRTCPeerConnectionState state = GST_WEBRTC_PEER_CONNECTION_STATE_NEW;
+    g_object_get(webrtc, "connection-state", &state, NULL);
+    switch (state) {
+    case GST_WEBRTC_PEER_CONNECTION_STATE_CONNECTED: {
+        session->disconnected_us = 0;
+        if (session->connected.exchange(true)) break;
+        std::cout << "[WebRTC] Viewer " << session->id << " connected" << std::endl;
+        std::function<void()> request;
+        {
+            std::lock_guard<std::mutex> lock(session->server->sessions_mutex);
+            request = session->server->paths[session->path].keyframe_request;
+        }
+        session->last_keyframe_us = g_get_monotonic_time();
+        if (request) request();
+        break;
+    }
+    case GST_WEBRTC_PEER_CONNECTION_STATE_DISCONNECTED:
+        if (session->disconnected_us == 0) session->disconnected_us = g_get_monotonic_time();
+        break;
+    case GST_WEBRTC_PEER_CONNECTION_STATE_FAILED:
+    case GST_WEBRTC_PEER_CONNECTION_STATE_CLOSED:
+        session->closing = true;
+        break;
+    default:
+        break;
+    }
+}
+
+GstPadProbeReturn WebRTCServer::on_upstream_event(GstPad*, GstPadProbeInfo* info, gpointer user_data) {
+    // A PLI/FIR from the browser reaches appsrc as an upstream force-key-unit;
+    // forward it to the encoder, at most once a second per viewer.
+    auto* session = static_cast<Session*>(user_data);
+    GstEvent* event = GST_PAD_PROBE_INFO_EVENT(info);
+    if (!event || !gst_video_event_is_force_key_unit(event)) return GST_PAD_PROBE_OK;
+    const int64_t now = g_get_monotonic_time();
+    if (now - session->last_keyframe_us < kKeyframeIntervalUs) return GST_PAD_PROBE_OK;
+    session->last_keyframe_us = now;
+    std::function<void()> request;
+    {
+        std::lock_guard<std::mutex> lock(session->server->sessions_mutex);
+        request = session->server->paths[session->path].keyframe_request;
+    }
+    if (request) request();
+    return GST_PAD_PROBE_OK;
+}
+
+gboolean WebRTCServer::on_reap_tick(gpointer user_data) {
+    auto* self = static_cast<WebRTCServer*>(user_data);
+    const int64_t now = g_get_monotonic_time();
+    std::vector<std::shared_ptr<Session>> closing;
+    {
+        std::lock_guard<std::mutex> lock(self->sessions_mutex);
+        for (size_t i = 0; i < self->sessions.size();) {
+            Session& session = *self->sessions[i];
+            GstBus* bus = gst_element_get_bus(session.pipeline);
+            while (GstMessage* msg = gst_bus_pop(bus)) {
+                if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR) {
+                    GError* err = nullptr;
+                    gchar* debug = nullptr;
+                    gst_message_parse_error(msg, &err, &debug);
+                    std::cerr << "[WebRTC] Viewer " << session.id << " error: " << (err ? err->message : "unknown") << std::endl;
+                    if (err) g_error_free(err);
+                    g_free(debug);
+                    session.closing = true;
+                }
+                gst_message_unref(msg);
+            }
+            gst_object_unref(bus);
+            const int64_t lost = session.disconnected_us;
+            const bool stale = (!session.connected && now - session.created_us > kConnectTimeoutUs) ||
+                               (lost != 0 && now - lost > kDisconnectGraceUs);
+            if (session.closing || stale) {
+                closing.push_back(self->sessions[i]);
+                self->sessions[i] = self->sessions.back();
+                self->sessions.pop_back();
+                continue;
+            }
+            ++i;
+        }
+    }
+    for (auto& session : closing) {
+        teardown(*session);
+        std::cout << "[WebRTC] Viewer " << session->id << " gone" << std::endl;
+    }
+    return G_SOURCE_CONTINUE;
+}
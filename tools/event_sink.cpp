@@ -0,0 +1,155 @@
+// Local stand-in for the track event backend (NANOSTREAM_EVENTS=1): a
+// single-client MQTT 3.1.1 listener or a Unix socket that prints every
+// batch it receives. --delay-ms makes it a slow consumer to exercise the
+// publisher's queue bound and drop policy.
+//
+//   ./build/event_sink --mqtt 1883 [--delay-ms 500] [--count N]
+//   ./build/event_sink --unix /tmp/nanostream-events.sock
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+int delay_ms = 0;
+long remaining = -1;
+
+bool readAll(int fd, uint8_t* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = recv(fd, data, len, 0);
+        if (n <= 0) return false;
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+void delivered(const std::string& payload) {
+    std::printf("%s\n", payload.c_str());
+    std::fflush(stdout);
+    if (remaining > 0) remaining--;
+    if (delay_ms > 0) std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+}
+
+// Returns when the client disconnects or breaks the protocol.
+void serveMqtt(int fd) {
+    while (remaining != 0) {
+        uint8_t header = 0;
+        if (!readAll(fd, &header, 1)) return;
+        size_t len = 0;
+        for (int shift = 0; shift < 28; shift += 7) {
+            uint8_t byte = 0;
+            if (!readAll(fd, &byte, 1)) return;
+            len |= static_cast<size_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) break;
+        }
+        std::string body(len, '\0');
+        if (len > 0 && !readAll(fd, reinterpret_cast<uint8_t*>(&body[0]), len)) return;
+        switch (header >> 4) {
+        case 1: {   // CONNECT
+            const uint8_t connack[4] = {0x20, 0x02, 0x00, 0x00};
+            send(fd, connack, sizeof(connack), MSG_NOSIGNAL);
+            std::fprintf(stderr, "client connected\n");
+            break;
+        }
+        case 3: {   // PUBLISH (QoS 0: topic, then payload)
+            if (body.size() < 2) return;
+            size_t topic_len = (static_cast<uint8_t>(body[0]) << 8) | static_cast<uint8_t>(body[1]);
+            if (body.size() < 2 + topic_len) return;
+            delivered(body.substr(2 + topic_len));
+            break;
+        }
+        case 12: {  // PINGREQ
+            const uint8_t pingresp[2] = {0xd0, 0x00};
+            send(fd, pingresp, sizeof(pingresp), MSG_NOSIGNAL);
+            break;
+        }
+        case 14:    // DISCONNECT
+            return;
+        default:
+            std::fprintf(stderr, "unexpected packet type %d\n", header >> 4);
+            return;
+        }
+    }
+}
+
+void serveLines(int fd) {
+    std::string pending;
+    char buf[4096];
+    while (remaining != 0) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) return;
+        pending.append(buf, static_cast<size_t>(n));
+        size_t nl;
+        while (remaining != 0 && (nl = pending.find('\n')) != std::string::npos) {
+            delivered(pending.substr(0, nl));
+            pending.erase(0, nl + 1);
+        }
+    }
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    int port = 0;
+    std::string path;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "--mqtt") port = std::atoi(argv[i + 1]);
+        else if (arg == "--unix") path = argv[i + 1];
+        else if (arg == "--delay-ms") delay_ms = std::atoi(argv[i + 1]);
+        else if (arg == "--count") remaining = std::atol(argv[i + 1]);
+    }
+    if ((port <= 0) == path.empty()) {
+        std::fprintf(stderr, "usage: %s --mqtt PORT | --unix PATH [--delay-ms N] [--count N]\n", argv[0]);
+        return 2;
+    }
+
+    int listener = -1;
+    if (port > 0) {
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        if (bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            std::perror("bind");
+            return 1;
+        }
+    } else {
+        listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        unlink(path.c_str());
+        if (bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            std::perror("bind");
+            return 1;
+        }
+    }
+    listen(listener, 1);
+    std::fprintf(stderr, "listening on %s\n", port > 0 ? ("127.0.0.1:" + std::to_string(port)).c_str() : path.c_str());
+
+    // One client at a time; the publisher reconnects after a drop.
+    while (remaining != 0) {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) continue;
+        if (port > 0) serveMqtt(fd);
+        else serveLines(fd);
+        close(fd);
+        std::fprintf(stderr, "client gone\n");
+    }
+    close(listener);
+    if (!path.empty()) unlink(path.c_str());
+    return 0;
+}
@@ -0,0 +1,755 @@
+// On-device INT8 calibration and FP32-vs-INT8 A/B evaluation.
+//
+//   int8_calib sample --source <uri|file|camera> --out calib [--count 300]
+//                     [--every-ms 1000] [--size 320x320] [--holdout 20]
+//   int8_calib table  --images calib/calib --out models/site.table
+//                     [--param models/nanodet_m.param] [--bin models/nanodet_m.bin]
+//                     [--input 320x320]
+//   int8_calib ab     --images calib/holdout [--labels dir] [--fp32 param,bin]
+//                     [--int8 param,bin] [--warmup 5] [--report ab.md]
+//
+// sample stores frames as the AI appsink delivers them (RGB at the AI
+// branch size) as PPM, splitting off a held-out replay set. table feeds
+// them through NCNNDetector::prepareInput and writes an ncnn2table-format
+// table: per-output-channel weight scales and KL-divergence activation
+// scales, ready for ncnn2int8. ab replays the held-out set through two
+// NCNNDetector instances in turn and reports mAP@0.5, latency and
+// throughput side by side. Without --labels the FP32 detections are the
+// reference, so the INT8 mAP measures agreement with FP32.
+
+#include <algorithm>
+#include <cerrno>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <gst/gst.h>
+#include <gst/app/gstappsink.h>
+#include <gst/video/video.h>
+#include <layer.h>
+#include <net.h>
+
+#include "ncnn_detector.hpp"
+#include "runtime_config.hpp"
+
+namespace {
+
+constexpr int kHistogramBins = 2048;
+constexpr int kTargetBins = 128;
+constexpr float kMatchIou = 0.5f;
+
+struct Image {
+    std::string name;   // file name without extension
+    int width = 0;
+    int height = 0;
+    std::shared_ptr<std::vector<unsigned char>> rgb;
+};
+
+bool parseSize(const std::string& s, int& w, int& h) {
+    return std::sscanf(s.c_str(), "%dx%d", &w, &h) == 2 && w > 0 && h > 0;
+}
+
+bool splitPair(const std::string& s, std::string& a, std::string& b) {
+    size_t comma = s.find(',');
+    if (comma == std::string::npos) return false;
+    a = s.substr(0, comma);
+    b = s.substr(comma + 1);
+    return !a.empty() && !b.empty();
+}
+
+bool makeDir(const std::string& path) {
+    return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+double percentile(std::vector<double> v, double q) {
+    if (v.empty()) return 0.0;
+    std::sort(v.begin(), v.end());
+    size_t idx = static_cast<size_t>(q * (v.size() - 1) + 0.5);
+    return v[std::min(idx, v.size() - 1)];
+}
+
+// ---------------------------------------------------------------------------
+// PPM frames
+// ---------------------------------------------------------------------------
+
+bool writePpm(const std::string& path, const unsigned char* data, int width, int height, int stride) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) return false;
+    out << "P6\n" << width << " " << height << "\n255\n";
+    for (int y = 0; y < height; ++y) {
+        out.write(reinterpret_cast<const char*>(data + static_cast<size_t>(y) * stride), width * 3);
+    }
+    return out.good();
+}
+
+bool readPpm(const std::string& path, Image& img) {
+    std::ifstream in(path, std::ios::binary);
+    std::string magic;
+    int maxval = 0;
+    if (!(in >> magic >> img.width >> img.height >> maxval) || magic != "P6" || maxval != 255 ||
+        img.width <= 0 || img.height <= 0) {
+        return false;
+    }
+    in.get();   // single whitespace before the raster
+    img.rgb = std::make_shared<std::vector<unsigned char>>(static_cast<size_t>(img.width) * img.height * 3);
+    in.read(reinterpret_cast<char*>(img.rgb->data()), static_cast<std::streamsize>(img.rgb->size()));
+    return in.gcount() == static_cast<std::streamsize>(img.rgb->size());
+}
+
+std::vector<std::string> listImages(const std::string& dir) {
+    std::vector<std::string> names;
+    if (DIR* d = opendir(dir.c_str())) {
+        while (dirent* e = readdir(d)) {
+            std::string n = e->d_name;
+            if (n.size() > 4 && n.compare(n.size() - 4, 4, ".ppm") == 0) names.push_back(n.substr(0, n.size() - 4));
+        }
+        closedir(d);
+    }
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+VideoFrameRef frameRef(const Image& img, uint64_t pts) {
+    VideoFrameRef ref;
+    ref.data = img.rgb->data();
+    ref.width = img.width;
+    ref.height = img.height;
+    ref.stride = img.width * 3;
+    ref.pts = pts;
+    ref.owner = img.rgb;
+    return ref;
+}
+
+// ---------------------------------------------------------------------------
+// sample: AI-branch frames from a live or replayed source
+// ---------------------------------------------------------------------------
+
+int runSample(const std::string& source, const std::string& out_dir, int count, int every_ms,
+              int width, int height, int holdout_pct) {
+    std::string src;
+    if (source == "camera") {
+        src = "libcamerasrc ! video/x-raw,width=640,height=480";
+    } else if (gst_uri_is_valid(source.c_str())) {
+        src = "uridecodebin uri=\"" + source + "\"";
+    } else {
+        gchar* uri = gst_filename_to_uri(source.c_str(), nullptr);
+        if (!uri) {
+            std::cerr << "[Calib] Cannot resolve " << source << std::endl;
+            return 1;
+        }
+        src = std::string("uridecodebin uri=\"") + uri + "\"";
+        g_free(uri);
+    }
+    // Same conversion as the AI branch, so samples match what the detector receives.
+    const std::string desc = src + " ! videoconvert ! videoscale ! video/x-raw,format=RGB,width=" +
+                             std::to_string(width) + ",height=" + std::to_string(height) +
+                             " ! appsink name=sink sync=false max-buffers=4 drop=false";
+    GError* error = nullptr;
+    GstElement* pipeline = gst_parse_launch(desc.c_str(), &error);
+    if (error) {
+        std::cerr << "[Calib] " << error->message << std::endl;
+        g_error_free(error);
+        return 1;
+    }
+    const std::string calib_dir = out_dir + "/calib";
+    const std::string holdout_dir = out_dir + "/holdout";
+    if (!makeDir(out_dir) || !makeDir(calib_dir) || (holdout_pct > 0 && !makeDir(holdout_dir))) {
+        std::cerr << "[Calib] Cannot create " << out_dir << std::endl;
+        gst_object_unref(pipeline);
+        return 1;
+    }
+    // Every period-th sample is held out, spreading both sets over the whole source.
+    const int period = holdout_pct > 0 ? std::max(2, static_cast<int>(std::lround(100.0 / holdout_pct))) : 0;
+
+    GstElement* sink = gst_bin_get_by_name(GST_BIN(pipeline), "sink");
+    GstBus* bus = gst_element_get_bus(pipeline);
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+
+    int saved = 0, calib = 0, held = 0;
+    gint64 last_us = -1;
+    while (saved < count) {
+        GstMessage* msg = gst_bus_pop_filtered(bus, static_cast<GstMessageType>(GST_MESSAGE_ERROR | GST_MESSAGE_EOS));
+        if (msg) {
+            if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR) {
+                GError* err = nullptr;
+                gst_message_parse_error(msg, &err, nullptr);
+                std::cerr << "[Calib] " << (err ? err->message : "pipeline error") << std::endl;
+                if (err) g_error_free(err);
+            }
+            gst_message_unref(msg);
+            break;
+        }
+        GstSample* sample = gst_app_sink_try_pull_sample(GST_APP_SINK(sink), 200 * GST_MSECOND);
+        if (!sample) continue;
+
+        // Replays decode faster than real time, so pace by PTS when there is one.
+        GstBuffer* buffer = gst_sample_get_buffer(sample);
+        const gint64 now_us = (buffer && GST_BUFFER_PTS_IS_VALID(buffer))
+            ? static_cast<gint64>(GST_BUFFER_PTS(buffer) / GST_USECOND) : g_get_monotonic_time();
+        GstVideoInfo info;
+        GstVideoFrame frame;
+        if (buffer && (last_us < 0 || now_us - last_us >= static_cast<gint64>(every_ms) * 1000) &&
+            gst_video_info_from_caps(&info, gst_sample_get_caps(sample)) &&
+            gst_video_frame_map(&frame, &info, buffer, GST_MAP_READ)) {
+            const bool is_holdout = period > 0 && saved % period == period - 1;
+            char name[32];
+            std::snprintf(name, sizeof(name), "/frame_%05d.ppm", is_holdout ? held : calib);
+            const std::string path = (is_holdout ? holdout_dir : calib_dir) + name;
+            if (writePpm(path, static_cast<const unsigned char*>(GST_VIDEO_FRAME_PLANE_DATA(&frame, 0)),
+                         GST_VIDEO_FRAME_WIDTH(&frame), GST_VIDEO_FRAME_HEIGHT(&frame),
+                         GST_VIDEO_FRAME_PLANE_STRIDE(&frame, 0))) {
+                (is_holdout ? held : calib)++;
+                saved++;
+                last_us = now_us;
+                std::cout << "\r[Calib] Sampled " << saved << "/" << count << std::flush;
+            }
+            gst_video_frame_unmap(&frame);
+        }
+        gst_sample_unref(sample);
+    }
+
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(bus);
+    gst_object_unref(sink);
+    gst_object_unref(pipeline);
+    std::cout << "\n[Calib] " << calib << " calibration frames in " << calib_dir;
+    if (period > 0) std::cout << ", " << held << " held out in " << holdout_dir;
+    std::cout << std::endl;
+    return saved > 0 ? 0 : 1;
+}
+
+// ---------------------------------------------------------------------------
+// table: ncnn2table-compatible calibration table
+// ---------------------------------------------------------------------------
+
+struct WeightScales {
+    std::string layer;
+    std::vector<float> scales;
+};
+
+// Stands in for the quantizable layers in a load-only net: it consumes
+// exactly their share of the .bin and records per-output (or per-group)
+// weight scales, so no private ncnn layer headers are needed.
+class WeightProbe : public ncnn::Layer {
+public:
+    explicit WeightProbe(std::vector<WeightScales>* out) : out(out) {}
+
+    int load_param(const ncnn::ParamDict& pd) override {
+        const bool inner_product = type == "InnerProduct";
+        num_output = pd.get(0, 0);
+        bias_term = pd.get(inner_product ? 1 : 5, 0);
+        weight_data_size = pd.get(inner_product ? 2 : 6, 0);
+        group = type == "ConvolutionDepthWise" ? pd.get(7, 1) : num_output;
+        int8_scale_term = pd.get(8, 0);
+        dynamic_weight = inner_product ? 0 : pd.get(19, 0);
+        return 0;
+    }
+
+    int load_model(const ncnn::ModelBin& mb) override {
+        if (dynamic_weight) return 0;
+        if (int8_scale_term) {
+            std::cerr << "[Calib] " << name << " is already quantized; calibrate the FP32 model" << std::endl;
+            return -1;
+        }
+        ncnn::Mat weights = mb.load(weight_data_size, 0);
+        if (weights.empty() || weights.elemsize != 4 || group <= 0) return -1;
+        if (bias_term) mb.load(num_output, 1);
+
+        WeightScales ws;
+        ws.layer = name;
+        const int per_group = weight_data_size / group;
+        const float* w = weights;
+        for (int g = 0; g < group; ++g) {
+            float absmax = 0.0f;
+            for (int k = 0; k < per_group; ++k) absmax = std::max(absmax, std::fabs(w[g * per_group + k]));
+            ws.scales.push_back(absmax == 0.0f ? 1.0f : 127.0f / absmax);
+        }
+        out->push_back(std::move(ws));
+        return 0;
+    }
+
+private:
+    std::vector<WeightScales>* out;
+    int num_output = 0;
+    int bias_term = 0;
+    int weight_data_size = 0;
+    int group = 1;
+    int int8_scale_term = 0;
+    int dynamic_weight = 0;
+};
+
+ncnn::Layer* createWeightProbe(void* userdata) {
+    return new WeightProbe(static_cast<std::vector<WeightScales>*>(userdata));
+}
+
+struct BlobStats {
+    float absmax = 0.0f;
+    std::vector<float> histogram;
+};
+
+template <typename Fn>
+void forEachValue(const ncnn::Mat& m, Fn fn) {
+    const int plane = m.w * m.h * m.d;
+    for (int q = 0; q < m.c; ++q) {
+        const float* p = m.channel(q);
+        for (int i = 0; i < plane; ++i) fn(p[i]);
+    }
+}
+
+// KL divergence of P from Q over bins where P has mass; empty Q bins get
+// a small floor instead of an infinite penalty.
+float klDivergence(const std::vector<float>& p, const std::vector<float>& q) {
+    float p_sum = 0.0f, q_sum = 0.0f;
+    for (float v : p) p_sum += v;
+    for (float v : q) q_sum += v;
+    if (p_sum <= 0.0f || q_sum <= 0.0f) return FLT_MAX;
+    float kl = 0.0f;
+    for (size_t i = 0; i < p.size(); ++i) {
+        if (p[i] <= 0.0f) continue;
+        const float pi = p[i] / p_sum;
+        const float qi = std::max(q[i] / q_sum, 1e-10f);
+        kl += pi * std::log(pi / qi);
+    }
+    return kl;
+}
+
+// The clipping bin whose 128-level requantization loses the least
+// information, as in ncnn2table's KL method.
+int klThresholdBin(const std::vector<float>& hist) {
+    const int length = static_cast<int>(hist.size());
+    int best_bin = length;
+    float best_kl = FLT_MAX;
+    float tail = 0.0f;
+    for (int i = kTargetBins; i < length; ++i) tail += hist[i];
+
+    for (int threshold = kTargetBins; threshold < length; ++threshold) {
+        std::vector<float> clipped(hist.begin(), hist.begin() + threshold);
+        clipped[threshold - 1] += tail;
+        tail -= hist[threshold];
+
+        // Merge into kTargetBins levels, then spread each level back evenly
+        // over the source bins that were non-empty.
+        const float per_bin = static_cast<float>(threshold) / kTargetBins;
+        std::vector<float> expanded(threshold, 0.0f);
+        for (int i = 0; i < kTargetBins; ++i) {
+            const int begin = static_cast<int>(std::floor(i * per_bin));
+            const int end = std::min(threshold, static_cast<int>(std::floor((i + 1) * per_bin)));
+            float sum = 0.0f;
+            int nonzero = 0;
+            for (int j = begin; j < end; ++j) {
+                sum += clipped[j];
+                if (clipped[j] != 0.0f) nonzero++;
+            }
+            if (nonzero == 0) continue;
+            for (int j = begin; j < end; ++j) {
+                if (clipped[j] != 0.0f) expanded[j] = sum / nonzero;
+            }
+        }
+        const float kl = klDivergence(clipped, expanded);
+        if (kl < best_kl) {
+            best_kl = kl;
+            best_bin = threshold;
+        }
+    }
+    return best_bin;
+}
+
+int runTable(const std::string& param, const std::string& bin, const std::string& images_dir,
+             const std::string& out_path, int input_w, int input_h) {
+    std::vector<WeightScales> weights;
+    {
+        ncnn::Net probe;
+        for (const char* type : {"Convolution", "ConvolutionDepthWise", "InnerProduct"}) {
+            probe.register_custom_layer(type, createWeightProbe, nullptr, &weights);
+        }
+        if (probe.load_param(param.c_str()) != 0 || probe.load_model(bin.c_str()) != 0) {
+            std::cerr << "[Calib] Cannot read weights from " << param << " / " << bin << std::endl;
+            return 1;
+        }
+    }
+
+    ncnn::Net net;
+    net.opt.num_threads = 4;
+    if (net.load_param(param.c_str()) != 0 || net.load_model(bin.c_str()) != 0) {
+        std::cerr << "[Calib] Cannot load " << param << std::endl;
+        return 1;
+    }
+    std::map<std::string, int> input_blob;   // quantized layer -> its bottom blob
+    for (const ncnn::Layer* layer : net.layers()) {
+        if (!layer->bottoms.empty()) input_blob[layer->name] = layer->bottoms[0];
+    }
+    std::map<int, BlobStats> blobs;
+    for (const auto& ws : weights) {
+        auto it = input_blob.find(ws.layer);
+        if (it != input_blob.end()) blobs[it->second];
+    }
+
+    const std::vector<std::string> names = listImages(images_dir);
+    if (names.empty() || blobs.empty()) {
+        std::cerr << "[Calib] No frames in " << images_dir << " or nothing to quantize" << std::endl;
+        return 1;
+    }
+
+    // Pass 1 finds each blob's range, pass 2 fills its histogram over it.
+    for (int pass = 0; pass < 2; ++pass) {
+        for (size_t i = 0; i < names.size(); ++i) {
+            Image img;
+            ncnn::Mat in;
+            if (!readPpm(images_dir + "/" + names[i] + ".ppm", img) ||
+                !NCNNDetector::prepareInput(frameRef(img, i), input_w, input_h, in)) {
+                continue;
+            }
+            ncnn::Extractor ex = net.create_extractor();
+            ex.set_light_mode(false);
+            ex.input(NCNNDetector::kInputBlob, in);
+            for (auto& entry : blobs) {
+                ncnn::Mat out;
+                if (ex.extract(entry.first, out) != 0) continue;
+                BlobStats& st = entry.second;
+                if (pass == 0) {
+                    forEachValue(out, [&st](float v) { st.absmax = std::max(st.absmax, std::fabs(v)); });
+                } else if (st.absmax > 0.0f) {
+                    const float bin_width = st.absmax / kHistogramBins;
+                    forEachValue(out, [&st, bin_width](float v) {
+                        if (v == 0.0f) return;
+                        st.histogram[std::min(static_cast<int>(std::fabs(v) / bin_width), kHistogramBins - 1)] += 1.0f;
+                    });
+                }
+            }
+            std::cout << "\r[Calib] Pass " << (pass + 1) << "/2: " << (i + 1) << "/" << names.size() << std::flush;
+        }
+        if (pass == 0) {
+            for (auto& entry : blobs) entry.second.histogram.assign(kHistogramBins, 0.0f);
+        }
+    }
+    std::cout << std::endl;
+
+    std::ofstream out(out_path);
+    if (!out) {
+        std::cerr << "[Calib] Cannot write " << out_path << std::endl;
+        return 1;
+    }
+    char num[32];
+    for (const auto& ws : weights) {
+        out << ws.layer << "_param_0 ";
+        for (float s : ws.scales) {
+            std::snprintf(num, sizeof(num), "%f ", s);
+            out << num;
+        }
+        out << "\n";
+    }
+    for (const auto& ws : weights) {
+        auto it = input_blob.find(ws.layer);
+        if (it == input_blob.end()) continue;
+        const BlobStats& st = blobs[it->second];
+        float scale = 1.0f;
+        if (st.absmax > 0.0f) {
+            const float threshold = (klThresholdBin(st.histogram) + 0.5f) * st.absmax / kHistogramBins;
+            scale = 127.0f / threshold;
+        }
+        std::snprintf(num, sizeof(num), "%f", scale);
+        out << ws.layer << " " << num << "\n";
+    }
+    std::cout << "[Calib] " << weights.size() << " layers from " << names.size() << " frames at "
+              << input_w << "x" << input_h << " -> " << out_path << "\n"
+              << "[Calib] Next: ncnn2int8 " << param << " " << bin
+              << " models/nanodet_m-int8.param models/nanodet_m-int8.bin " << out_path << std::endl;
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// ab: FP32 vs INT8 over the held-out replay set
+// ---------------------------------------------------------------------------
+
+struct ModelRun {
+    std::string label;
+    std::vector<std::vector<Detection>> detections;   // per image
+    std::vector<double> latencyMs;
+    double wallS = 0.0;
+};
+
+int64_t steadyUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// One frame in flight at a time: latency is push to result on the
+// detector's own worker, exactly as the pipeline sees it.
+bool runModel(const std::string& label, const std::string& param, const std::string& bin,
+              const std::vector<Image>& images, int warmup, ModelRun& run) {
+    NCNNDetector detector;
+    if (!detector.loadModel(param, bin)) {
+        std::cerr << "[Calib] Cannot load " << label << " model " << param << std::endl;
+        return false;
+    }
+    std::mutex mutex;
+    std::condition_variable cv;
+    DetectionFrame result;
+    bool have_result = false;
+    detector.addResultListener([&](const DetectionFrame& frame) {
+        std::lock_guard<std::mutex> lock(mutex);
+        result = frame;
+        have_result = true;
+        cv.notify_one();
+    });
+
+    auto infer = [&](const Image& img, uint64_t pts, int64_t& done_us) {
+        std::unique_lock<std::mutex> lock(mutex);
+        have_result = false;
+        // pushFrame drops frames while the worker holds the slot; re-offer
+        // until this frame's result comes back.
+        for (int attempt = 0; attempt < 6; ++attempt) {
+            lock.unlock();
+            detector.pushFrame(frameRef(img, pts));
+            lock.lock();
+            if (cv.wait_for(lock, std::chrono::seconds(5), [&] { return have_result && result.pts == pts; })) {
+                done_us = result.timestampUs;
+                return true;
+            }
+        }
+        return false;
+    };
+
+    run.label = label;
+    int64_t done_us = 0;
+    for (int i = 0; i < warmup; ++i) {
+        if (!infer(images[i % images.size()], DetectionFrame::kNoPts - 1 - i, done_us)) return false;
+    }
+    const int64_t start_us = steadyUs();
+    for (size_t i = 0; i < images.size(); ++i) {
+        const int64_t push_us = steadyUs();
+        if (!infer(images[i], i, done_us)) {
+            std::cerr << "[Calib] " << label << " produced no result for " << images[i].name << std::endl;
+            return false;
+        }
+        run.latencyMs.push_back((done_us - push_us) / 1000.0);
+        std::lock_guard<std::mutex> lock(mutex);
+        run.detections.push_back(result.detections);
+    }
+    run.wallS = (steadyUs() - start_us) / 1e6;
+    std::cout << std::endl;
+    return true;
+}
+
+float boxIou(const Detection& a, const Detection& b) {
+    const int x1 = std::max(a.x, b.x), y1 = std::max(a.y, b.y);
+    const int x2 = std::min(a.x + a.w, b.x + b.w), y2 = std::min(a.y + a.h, b.y + b.h);
+    const float inter = static_cast<float>(std::max(0, x2 - x1)) * std::max(0, y2 - y1);
+    const float uni = static_cast<float>(a.w) * a.h + static_cast<float>(b.w) * b.h - inter;
+    return uni > 0.0f ? inter / uni : 0.0f;
+}
+
+// VOC-style all-point AP at IoU 0.5, averaged over classes present in the
+// reference. Returns -1 when the reference has no boxes.
+double meanAveragePrecision(const std::vector<std::vector<Detection>>& reference,
+                            const std::vector<std::vector<Detection>>& predicted) {
+    std::map<int, int> class_total;
+    for (const auto& frame : reference) {
+        for (const auto& d : frame) class_total[d.class_id]++;
+    }
+    if (class_total.empty()) return -1.0;
+
+    double ap_sum = 0.0;
+    for (const auto& cls : class_total) {
+        struct Pred { float score; size_t frame; const Detection* det; };
+        std::vector<Pred> preds;
+        for (size_t f = 0; f < predicted.size(); ++f) {
+            for (const auto& d : predicted[f]) {
+                if (d.class_id == cls.first) preds.push_back({d.score, f, &d});
+            }
+        }
+        std::sort(preds.begin(), preds.end(), [](const Pred& a, const Pred& b) { return a.score > b.score; });
+
+        std::vector<std::vector<bool>> used(reference.size());
+        for (size_t f = 0; f < reference.size(); ++f) used[f].assign(reference[f].size(), false);
+        std::vector<double> precision, recall;
+        int tp = 0;
+        for (size_t i = 0; i < preds.size(); ++i) {
+            const auto& ref = reference[preds[i].frame];
+            int best = -1;
+            float best_iou = kMatchIou;
+            for (size_t r = 0; r < ref.size(); ++r) {
+                if (ref[r].class_id != cls.first || used[preds[i].frame][r]) continue;
+                const float iou = boxIou(*preds[i].det, ref[r]);
+                if (iou >= best_iou) { best_iou = iou; best = static_cast<int>(r); }
+            }
+            if (best >= 0) {
+                used[preds[i].frame][best] = true;
+                tp++;
+            }
+            precision.push_back(static_cast<double>(tp) / (i + 1));
+            recall.push_back(static_cast<double>(tp) / cls.second);
+        }
+        // Area under the precision envelope.
+        for (int i = static_cast<int>(precision.size()) - 2; i >= 0; --i) {
+            precision[i] = std::max(precision[i], precision[i + 1]);
+        }
+        double ap = 0.0, prev_recall = 0.0;
+        for (size_t i = 0; i < precision.size(); ++i) {
+            ap += (recall[i] - prev_recall) * precision[i];
+            prev_recall = recall[i];
+        }
+        ap_sum += ap;
+    }
+    return ap_sum / class_total.size();
+}
+
+// One "class_id x y w h" line per object, in detector frame coordinates.
+std::vector<Detection> readLabels(const std::string& path) {
+    std::vector<Detection> boxes;
+    std::ifstream in(path);
+    Detection d;
+    while (in >> d.class_id >> d.x >> d.y >> d.w >> d.h) {
+        d.score = 1.0f;
+        boxes.push_back(d);
+    }
+    return boxes;
+}
+
+int runAb(const std::string& images_dir, const std::string& labels_dir,
+          const std::string& fp32_param, const std::string& fp32_bin,
+          const std::string& int8_param, const std::string& int8_bin,
+          int warmup, const std::string& report_path) {
+    std::vector<Image> images;
+    for (const auto& n : listImages(images_dir)) {
+        Image img;
+        img.name = n;
+        if (readPpm(images_dir + "/" + n + ".ppm", img)) images.push_back(std::move(img));
+    }
+    if (images.empty()) {
+        std::cerr << "[Calib] No frames in " << images_dir << std::endl;
+        return 1;
+    }
+
+    ModelRun fp32, int8;
+    if (!runModel("FP32", fp32_param, fp32_bin, images, warmup, fp32)) return 1;
+    if (!runModel("INT8", int8_param, int8_bin, images, warmup, int8)) return 1;
+
+    std::vector<std::vector<Detection>> reference;
+    if (!labels_dir.empty()) {
+        for (const auto& img : images) reference.push_back(readLabels(labels_dir + "/" + img.name + ".txt"));
+    } else {
+        reference = fp32.detections;
+    }
+
+    std::ostringstream report;
+    report << "| model | frames | mAP@0.5 | lat mean ms | lat p50 ms | lat p95 ms | throughput fps | dets/frame |\n"
+           << "|---|---|---|---|---|---|---|---|\n";
+    double map[2] = {0.0, 0.0};
+    const ModelRun* runs[2] = {&fp32, &int8};
+    for (int m = 0; m < 2; ++m) {
+        const ModelRun& r = *runs[m];
+        map[m] = meanAveragePrecision(reference, r.detections);
+        double mean = 0.0;
+        size_t dets = 0;
+        for (double l : r.latencyMs) mean += l;
+        for (const auto& f : r.detections) dets += f.size();
+        mean /= r.latencyMs.size();
+        char map_text[16] = "n/a";
+        if (map[m] >= 0.0) std::snprintf(map_text, sizeof(map_text), "%.3f", map[m]);
+        char row[256];
+        std::snprintf(row, sizeof(row), "| %s | %zu | %s | %.1f | %.1f | %.1f | %.2f | %.2f |\n",
+                      r.label.c_str(), r.latencyMs.size(), map_text,
+                      mean, percentile(r.latencyMs, 0.5), percentile(r.latencyMs, 0.95),
+                      r.latencyMs.size() / std::max(1e-6, r.wallS),
+                      static_cast<double>(dets) / r.detections.size());
+        report << row;
+    }
+    report << "\nReference: "
+           << (labels_dir.empty() ? "FP32 detections (INT8 mAP is agreement with FP32)" : "labels in " + labels_dir)
+           << "\n";
+    if (map[0] >= 0.0 && map[1] >= 0.0) {
+        char line[160];
+        std::snprintf(line, sizeof(line), "mAP delta (INT8 - FP32): %+.3f, p50 speedup: x%.2f\n", map[1] - map[0],
+                      percentile(fp32.latencyMs, 0.5) / std::max(1e-6, percentile(int8.latencyMs, 0.5)));
+        report << line;
+    }
+
+    std::cout << "\n" << report.str();
+    if (!report_path.empty()) {
+        std::ofstream out(report_path);
+        out << "# INT8 A/B\n\n" << images.size() << " held-out frames from " << images_dir
+            << ", one frame in flight, " << warmup << " warm-up frames per model.\n"
+            << "FP32: " << fp32_param << "; INT8: " << int8_param << ".\n\n" << report.str();
+        std::cout << "[Calib] Report written to " << report_path << std::endl;
+    }
+    return 0;
+}
+
+void usage() {
+    std::cerr << "usage: int8_calib sample --source <uri|file|camera> --out DIR [--count 300] [--every-ms 1000]\n"
+                 "                         [--size 320x320] [--holdout 20]\n"
+                 "       int8_calib table --images DIR --out FILE [--param P] [--bin B] [--input 320x320]\n"
+                 "       int8_calib ab --images DIR [--labels DIR] [--fp32 P,B] [--int8 P,B] [--warmup 5]\n"
+                 "                     [--report out.md]" << std::endl;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) { usage(); return 1; }
+    const std::string mode = argv[1];
+    // A/B scores frames independently; box smoothing assumes consecutive frames.
+    if (mode == "ab") setenv("NANOSTREAM_DET_EMA", "1", 1);
+    const RuntimeConfig& runtime = getRuntimeConfig();
+
+    std::map<std::string, std::string> args;
+    for (int i = 2; i < argc; i += 2) {
+        if (i + 1 >= argc || std::strncmp(argv[i], "--", 2) != 0) { usage(); return 1; }
+        args[argv[i] + 2] = argv[i + 1];
+    }
+    auto arg = [&args](const std::string& key, const std::string& fallback) {
+        auto it = args.find(key);
+        return it == args.end() ? fallback : it->second;
+    };
+
+    int w = 320, h = 320;
+    if (mode == "sample") {
+        if (!args.count("source") || !args.count("out") || !parseSize(arg("size", "320x320"), w, h)) {
+            usage();
+            return 1;
+        }
+        gst_init(&argc, &argv);
+        return runSample(arg("source", ""), arg("out", ""), std::max(1, std::atoi(arg("count", "300").c_str())),
+                         std::max(0, std::atoi(arg("every-ms", "1000").c_str())), w, h,
+                         std::min(50, std::max(0, std::atoi(arg("holdout", "20").c_str()))));
+    }
+    if (mode == "table") {
+        if (runtime.detInputWidth > 0) w = runtime.detInputWidth;
+        if (runtime.detInputHeight > 0) h = runtime.detInputHeight;
+        if (!args.count("images") || !args.count("out") ||
+            (args.count("input") && !parseSize(arg("input", ""), w, h))) {
+            usage();
+            return 1;
+        }
+        return runTable(arg("param", "models/nanodet_m.param"), arg("bin", "models/nanodet_m.bin"),
+                        arg("images", ""), arg("out", ""), w, h);
+    }
+    if (mode == "ab") {
+        std::string fp32_param = "models/nanodet_m.param", fp32_bin = "models/nanodet_m.bin";
+        std::string int8_param = runtime.int8Param, int8_bin = runtime.int8Bin;
+        if (!args.count("images") ||
+            (args.count("fp32") && !splitPair(arg("fp32", ""), fp32_param, fp32_bin)) ||
+            (args.count("int8") && !splitPair(arg("int8", ""), int8_param, int8_bin))) {
+            usage();
+            return 1;
+        }
+        return runAb(arg("images", ""), arg("labels", ""), fp32_param, fp32_bin, int8_param, int8_bin,
+                     std::max(0, std::atoi(arg("warmup", "5").c_str())), arg("report", ""));
+    }
+    usage();
+    return 1;
+}
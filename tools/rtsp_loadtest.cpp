@@ -0,0 +1,457 @@
+// RTSP fan-out load test.
+//
+// Serves a videotestsrc capture pipeline through the same RTSPServer the
+// app uses, then re-executes itself as N client processes per step, over
+// UDP and TCP-interleaved transports. Each client reports arrival jitter,
+// stalls and end-to-end latency; the server side reports its own CPU use
+// and frames dropped in the capture branch and at the RTSP appsrc.
+//
+//   rtsp_loadtest [--clients 1,2,4,8,16] [--transport udp|tcp|both]
+//                 [--duration 20] [--port 8654] [--report out.md]
+//
+// Latency is matched per access unit: the server records a hash of each
+// unit's tail with its push time in a shared-memory ring, and clients look
+// up the units they receive. Both sides use CLOCK_MONOTONIC.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <gst/gst.h>
+#include <gst/app/gstappsink.h>
+
+#include "rtsp_service.hpp"
+
+namespace {
+
+constexpr size_t kRingSize = 1024;
+
+struct PushRecord {
+    std::atomic<uint64_t> hash;
+    std::atomic<int64_t> push_us;
+};
+
+struct PushRing {
+    std::atomic<uint64_t> next;
+    PushRecord records[kRingSize];
+};
+
+// FNV-1a over the last bytes of an access unit. The payloader may prepend
+// SPS/PPS to IDR units, so the head is not stable between sender and client.
+uint64_t tailHash(const uint8_t* data, size_t size) {
+    const size_t n = std::min<size_t>(size, 64);
+    uint64_t h = 1469598103934665603ull;
+    for (size_t i = size - n; i < size; ++i) {
+        h ^= data[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+PushRing* mapRing(const std::string& path, bool create) {
+    int fd = open(path.c_str(), create ? (O_RDWR | O_CREAT | O_TRUNC) : O_RDWR, 0600);
+    if (fd < 0) return nullptr;
+    if (create && ftruncate(fd, sizeof(PushRing)) != 0) {
+        close(fd);
+        return nullptr;
+    }
+    void* p = mmap(nullptr, sizeof(PushRing), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    return p == MAP_FAILED ? nullptr : static_cast<PushRing*>(p);
+}
+
+double percentile(std::vector<double> v, double q) {
+    if (v.empty()) return 0.0;
+    std::sort(v.begin(), v.end());
+    size_t idx = static_cast<size_t>(q * (v.size() - 1) + 0.5);
+    return v[std::min(idx, v.size() - 1)];
+}
+
+// ---------------------------------------------------------------------------
+// Client mode: one RTSP session, results as a single key=value line
+// ---------------------------------------------------------------------------
+
+struct ClientResult {
+    bool connected = false;
+    int frames = 0;
+    double fps = 0.0;
+    double jitterMs = 0.0;      // stddev of inter-arrival time
+    double maxGapMs = 0.0;
+    int stalls = 0;             // gaps > 3x the median interval
+    double latP50Ms = 0.0;
+    double latP95Ms = 0.0;
+};
+
+int runClient(const std::string& url, const std::string& transport, int duration_s, const std::string& ring_path) {
+    PushRing* ring = mapRing(ring_path, false);
+    const std::string desc =
+        "rtspsrc location=" + url + " protocols=" + transport + " latency=0 ! "
+        "rtph264depay ! h264parse ! video/x-h264,stream-format=byte-stream,alignment=au ! "
+        "appsink name=sink sync=false max-buffers=30 drop=true";
+    GError* error = nullptr;
+    GstElement* pipeline = gst_parse_launch(desc.c_str(), &error);
+    if (error) {
+        std::cerr << "[Client] " << error->message << std::endl;
+        g_error_free(error);
+        return 1;
+    }
+    GstElement* sink = gst_bin_get_by_name(GST_BIN(pipeline), "sink");
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+
+    ClientResult r;
+    std::vector<int64_t> arrivals;
+    std::vector<double> latencies;
+    const int64_t start_us = g_get_monotonic_time();
+    int64_t deadline_us = start_us + 10 * G_USEC_PER_SEC;   // connect timeout
+    while (g_get_monotonic_time() < deadline_us) {
+        GstSample* sample = gst_app_sink_try_pull_sample(GST_APP_SINK(sink), 200 * GST_MSECOND);
+        if (!sample) continue;
+        const int64_t now_us = g_get_monotonic_time();
+        if (!r.connected) {
+            r.connected = true;
+            deadline_us = now_us + static_cast<int64_t>(duration_s) * G_USEC_PER_SEC;
+        }
+        arrivals.push_back(now_us);
+
+        GstBuffer* buffer = gst_sample_get_buffer(sample);
+        GstMapInfo map;
+        if (ring && buffer && gst_buffer_map(buffer, &map, GST_MAP_READ)) {
+            uint64_t h = tailHash(map.data, map.size);
+            for (size_t i = 0; i < kRingSize; ++i) {
+                if (ring->records[i].hash.load(std::memory_order_acquire) == h) {
+                    latencies.push_back((now_us - ring->records[i].push_us.load()) / 1000.0);
+                    break;
+                }
+            }
+            gst_buffer_unmap(buffer, &map);
+        }
+        gst_sample_unref(sample);
+    }
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(sink);
+    gst_object_unref(pipeline);
+
+    r.frames = static_cast<int>(arrivals.size());
+    if (arrivals.size() > 2) {
+        std::vector<double> gaps;
+        for (size_t i = 1; i < arrivals.size(); ++i) gaps.push_back((arrivals[i] - arrivals[i - 1]) / 1000.0);
+        double mean = 0.0;
+        for (double g : gaps) mean += g;
+        mean /= gaps.size();
+        double var = 0.0;
+        for (double g : gaps) var += (g - mean) * (g - mean);
+        r.jitterMs = std::sqrt(var / gaps.size());
+        r.maxGapMs = *std::max_element(gaps.begin(), gaps.end());
+        const double median = percentile(gaps, 0.5);
+        for (double g : gaps) if (g > 3.0 * median) r.stalls++;
+        r.fps = 1000.0 * gaps.size() / std::max(1.0, (arrivals.back() - arrivals.front()) / 1000.0);
+    }
+    r.latP50Ms = percentile(latencies, 0.5);
+    r.latP95Ms = percentile(latencies, 0.95);
+
+    std::printf("connected=%d frames=%d fps=%.2f jitter=%.2f maxgap=%.1f stalls=%d lat50=%.1f lat95=%.1f\n",
+                r.connected ? 1 : 0, r.frames, r.fps, r.jitterMs, r.maxGapMs, r.stalls, r.latP50Ms, r.latP95Ms);
+    return 0;
+}
+
+ClientResult parseClientLine(const std::string& line) {
+    ClientResult r;
+    int connected = 0;
+    if (std::sscanf(line.c_str(), "connected=%d frames=%d fps=%lf jitter=%lf maxgap=%lf stalls=%d lat50=%lf lat95=%lf",
+                    &connected, &r.frames, &r.fps, &r.jitterMs, &r.maxGapMs, &r.stalls,
+                    &r.latP50Ms, &r.latP95Ms) == 8) {
+        r.connected = connected != 0;
+    }
+    return r;
+}
+
+// ---------------------------------------------------------------------------
+// Server mode: test-source capture pipeline + RTSPServer + client fan-out
+// ---------------------------------------------------------------------------
+
+struct ServerStats {
+    std::atomic<uint64_t> captured{0};
+    std::atomic<uint64_t> encoded{0};
+    std::atomic<uint64_t> overruns{0};
+};
+
+struct ServerContext {
+    RTSPServer* rtsp = nullptr;
+    int mount = -1;
+    PushRing* ring = nullptr;
+    ServerStats stats;
+};
+
+GstPadProbeReturn on_capture_probe(GstPad*, GstPadProbeInfo*, gpointer user_data) {
+    static_cast<ServerContext*>(user_data)->stats.captured++;
+    return GST_PAD_PROBE_OK;
+}
+
+void on_queue_overrun(GstElement*, gpointer user_data) {
+    static_cast<ServerContext*>(user_data)->stats.overruns++;
+}
+
+GstFlowReturn on_encoded_sample(GstElement* sink, gpointer user_data) {
+    auto* ctx = static_cast<ServerContext*>(user_data);
+    GstSample* sample = nullptr;
+    g_signal_emit_by_name(sink, "pull-sample", &sample);
+    if (!sample) return GST_FLOW_ERROR;
+    GstBuffer* buffer = gst_sample_get_buffer(sample);
+    GstMapInfo map;
+    if (buffer && gst_buffer_map(buffer, &map, GST_MAP_READ)) {
+        PushRecord& rec = ctx->ring->records[ctx->ring->next.fetch_add(1) % kRingSize];
+        rec.push_us.store(g_get_monotonic_time());
+        rec.hash.store(tailHash(map.data, map.size), std::memory_order_release);
+        gst_buffer_unmap(buffer, &map);
+    }
+    ctx->stats.encoded++;
+    if (buffer) ctx->rtsp->pushBuffer(ctx->mount, buffer);
+    gst_sample_unref(sample);
+    return GST_FLOW_OK;
+}
+
+double processCpuSeconds() {
+    std::ifstream stat("/proc/self/stat");
+    std::string content((std::istreambuf_iterator<char>(stat)), std::istreambuf_iterator<char>());
+    // Fields after the parenthesised command name; utime and stime are 14 and 15.
+    size_t pos = content.rfind(')');
+    if (pos == std::string::npos) return 0.0;
+    std::istringstream rest(content.substr(pos + 2));
+    std::string field;
+    unsigned long long utime = 0, stime = 0;
+    for (int i = 3; i <= 15 && rest >> field; ++i) {
+        if (i == 14) utime = std::strtoull(field.c_str(), nullptr, 10);
+        if (i == 15) stime = std::strtoull(field.c_str(), nullptr, 10);
+    }
+    return static_cast<double>(utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+struct Child {
+    pid_t pid = -1;
+    int out_fd = -1;
+};
+
+Child spawnClient(const std::string& self, const std::string& url, const std::string& transport,
+                  int duration_s, const std::string& ring_path) {
+    int fds[2];
+    Child c;
+    if (pipe(fds) != 0) return c;
+    // Only async-signal-safe calls between fork and exec.
+    const std::string dur = std::to_string(duration_s);
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        execl(self.c_str(), self.c_str(), "--client", url.c_str(), transport.c_str(), dur.c_str(),
+              ring_path.c_str(), static_cast<char*>(nullptr));
+        _exit(127);
+    }
+    close(fds[1]);
+    c.pid = pid;
+    c.out_fd = fds[0];
+    return c;
+}
+
+std::string readAll(int fd) {
+    std::string out;
+    char buf[256];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0) out.append(buf, static_cast<size_t>(n));
+    close(fd);
+    return out;
+}
+
+std::vector<int> parseList(const std::string& s) {
+    std::vector<int> out;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        int v = std::atoi(item.c_str());
+        if (v > 0) out.push_back(v);
+    }
+    return out;
+}
+
+void usage() {
+    std::cerr << "usage: rtsp_loadtest [--clients 1,2,4,8,16] [--transport udp|tcp|both] "
+                 "[--duration 20] [--port 8654] [--report out.md]" << std::endl;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    if (argc == 6 && std::string(argv[1]) == "--client") {
+        gst_init(nullptr, nullptr);
+        return runClient(argv[2], argv[3], std::atoi(argv[4]), argv[5]);
+    }
+
+    std::vector<int> client_steps = {1, 2, 4, 8, 16};
+    std::vector<std::string> transports = {"udp", "tcp"};
+    int duration_s = 20;
+    int port = 8654;
+    std::string report_path;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) { usage(); return 1; }
+        std::string val = argv[++i];
+        if (arg == "--clients") client_steps = parseList(val);
+        else if (arg == "--transport") transports = (val == "both") ? std::vector<std::string>{"udp", "tcp"}
+                                                                    : std::vector<std::string>{val};
+        else if (arg == "--duration") duration_s = std::max(1, std::atoi(val.c_str()));
+        else if (arg == "--port") port = std::atoi(val.c_str());
+        else if (arg == "--report") report_path = val;
+        else { usage(); return 1; }
+    }
+    if (client_steps.empty()) { usage(); return 1; }
+
+    gst_init(&argc, &argv);
+    signal(SIGPIPE, SIG_IGN);
+
+    char ring_template[] = "/tmp/rtsp_loadtest_XXXXXX";
+    int tmp_fd = mkstemp(ring_template);
+    if (tmp_fd < 0) return 1;
+    close(tmp_fd);
+    const std::string ring_path = ring_template;
+    ServerContext ctx;
+    ctx.ring = mapRing(ring_path, true);
+    if (!ctx.ring) {
+        std::cerr << "[LoadTest] Cannot map " << ring_path << std::endl;
+        return 1;
+    }
+
+    RTSPServer rtsp;
+    ctx.rtsp = &rtsp;
+    ctx.mount = rtsp.addMount("/live");
+    rtsp.start(port, "127.0.0.1");
+
+    // Same shape as the software capture branch: leaky stream queue,
+    // x264 zerolatency, access units handed to the server in-process.
+    const std::string desc =
+        "videotestsrc is-live=true pattern=ball ! video/x-raw,width=640,height=480,framerate=15/1 ! "
+        "identity name=capture ! tee name=t "
+        "t. ! queue name=stream_q max-size-buffers=10 leaky=downstream ! videoconvert ! video/x-raw,format=I420 ! "
+        "x264enc speed-preset=ultrafast tune=zerolatency bitrate=1000 threads=4 ! h264parse config-interval=1 ! "
+        "video/x-h264,stream-format=byte-stream,alignment=au ! "
+        "appsink name=stream_sink sync=false async=false emit-signals=true max-buffers=8 drop=false";
+    GError* error = nullptr;
+    GstElement* pipeline = gst_parse_launch(desc.c_str(), &error);
+    if (error) {
+        std::cerr << "[LoadTest] " << error->message << std::endl;
+        g_error_free(error);
+        return 1;
+    }
+    GstElement* capture = gst_bin_get_by_name(GST_BIN(pipeline), "capture");
+    GstPad* capture_pad = gst_element_get_static_pad(capture, "src");
+    gst_pad_add_probe(capture_pad, GST_PAD_PROBE_TYPE_BUFFER, on_capture_probe, &ctx, nullptr);
+    gst_object_unref(capture_pad);
+    gst_object_unref(capture);
+    GstElement* queue = gst_bin_get_by_name(GST_BIN(pipeline), "stream_q");
+    g_signal_connect(queue, "overrun", G_CALLBACK(on_queue_overrun), &ctx);
+    gst_object_unref(queue);
+    GstElement* sink = gst_bin_get_by_name(GST_BIN(pipeline), "stream_sink");
+    g_signal_connect(sink, "new-sample", G_CALLBACK(on_encoded_sample), &ctx);
+    gst_object_unref(sink);
+
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    std::thread loop_thread([loop]() { g_main_loop_run(loop); });
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+    std::this_thread::sleep_for(std::chrono::seconds(2));
+
+    const std::string self = "/proc/self/exe";
+    const std::string url = "rtsp://127.0.0.1:" + std::to_string(port) + "/live";
+    std::ostringstream report;
+    report << "| transport | clients | connected | fps | jitter ms | max gap ms | stalls | lat p50 ms | lat p95 ms"
+              " | server cpu % | capture drops | rtsp drops |\n"
+           << "|---|---|---|---|---|---|---|---|---|---|---|---|\n";
+
+    for (const auto& transport : transports) {
+        for (int n : client_steps) {
+            std::cout << "[LoadTest] " << transport << " x" << n << " for " << duration_s << "s..." << std::endl;
+            const uint64_t cap0 = ctx.stats.captured, enc0 = ctx.stats.encoded, ovr0 = ctx.stats.overruns;
+            const guint64 rtsp0 = rtsp.droppedUnits(ctx.mount);
+            const double cpu0 = processCpuSeconds();
+            const int64_t t0 = g_get_monotonic_time();
+
+            std::vector<Child> children;
+            for (int i = 0; i < n; ++i) children.push_back(spawnClient(self, url, transport, duration_s, ring_path));
+
+            std::vector<ClientResult> results;
+            for (auto& c : children) {
+                if (c.pid < 0) { results.push_back(ClientResult()); continue; }
+                results.push_back(parseClientLine(readAll(c.out_fd)));
+                waitpid(c.pid, nullptr, 0);
+            }
+
+            const double wall_s = (g_get_monotonic_time() - t0) / 1e6;
+            const double cpu_pct = 100.0 * (processCpuSeconds() - cpu0) / std::max(0.001, wall_s);
+            const uint64_t captured = ctx.stats.captured - cap0;
+            const uint64_t encoded = ctx.stats.encoded - enc0;
+            // Frames still in flight at the window edges are within the queue depth.
+            const uint64_t capture_drops = std::max<uint64_t>(ctx.stats.overruns - ovr0,
+                                                              captured > encoded + 10 ? captured - encoded - 10 : 0);
+            const guint64 rtsp_drops = rtsp.droppedUnits(ctx.mount) - rtsp0;
+
+            int connected = 0, stalls = 0;
+            double fps = 0, jitter = 0, max_gap = 0;
+            std::vector<double> lat50, lat95;
+            for (const auto& r : results) {
+                if (!r.connected) continue;
+                connected++;
+                fps += r.fps;
+                jitter += r.jitterMs;
+                stalls += r.stalls;
+                max_gap = std::max(max_gap, r.maxGapMs);
+                lat50.push_back(r.latP50Ms);
+                lat95.push_back(r.latP95Ms);
+            }
+            if (connected > 0) {
+                fps /= connected;
+                jitter /= connected;
+            }
+            char row[320];
+            std::snprintf(row, sizeof(row),
+                          "| %s | %d | %d | %.1f | %.2f | %.1f | %d | %.1f | %.1f | %.1f | %llu | %llu |\n",
+                          transport.c_str(), n, connected, fps, jitter, max_gap, stalls,
+                          percentile(lat50, 0.5), percentile(lat95, 1.0), cpu_pct,
+                          static_cast<unsigned long long>(capture_drops),
+                          static_cast<unsigned long long>(rtsp_drops));
+            std::cout << row << std::flush;
+            report << row;
+
+            // Let the shared media tear down before the next step.
+            std::this_thread::sleep_for(std::chrono::seconds(2));
+        }
+    }
+
+    std::cout << "\n" << report.str();
+    if (!report_path.empty()) {
+        std::ofstream out(report_path);
+        out << "# RTSP fan-out load test\n\n" << duration_s << "s per step, 640x480@15 test source, "
+            << "x264 1000 kbps. Latency is push-to-receive (no decode).\n\n" << report.str();
+        std::cout << "[LoadTest] Report written to " << report_path << std::endl;
+    }
+
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(pipeline);
+    g_main_loop_quit(loop);
+    loop_thread.join();
+    g_main_loop_unref(loop);
+    munmap(ctx.ring, sizeof(PushRing));
+    unlink(ring_path.c_str());
+    return 0;
+}
@@ -0,0 +1,65 @@
+// Minimal sidecar for the shared frame ring: prints per-channel frame
+// rates and the latest detections, touching frames in place.
+//
+//   ./build/share_probe [/tmp/nanostream-share.sock]
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+#include "frame_share_reader.hpp"
+
+int main(int argc, char* argv[]) {
+    const std::string path = argc > 1 ? argv[1] : "/tmp/nanostream-share.sock";
+    FrameShareReader reader;
+    if (!reader.connect(path)) {
+        std::fprintf(stderr, "cannot connect to %s (is NANOSTREAM_SHARE=1 set?)\n", path.c_str());
+        return 1;
+    }
+    // Paced by the first enabled channel; the others are polled alongside.
+    frame_share::Channel pace = frame_share::kDetections;
+    for (int c = static_cast<int>(frame_share::kChannelCount) - 1; c >= 0; --c) {
+        uint32_t w = 0, h = 0;
+        bool on = reader.channelSize(static_cast<frame_share::Channel>(c), w, h);
+        if (on) pace = static_cast<frame_share::Channel>(c);
+        std::printf("channel %d: %s %ux%u\n", c, on ? "on" : "off", w, h);
+    }
+
+    uint64_t last[frame_share::kChannelCount] = {};
+    int frames[frame_share::kChannelCount] = {};
+    int torn = 0;
+    auto window = std::chrono::steady_clock::now();
+    while (reader.wait(pace, last[pace], 2000)) {
+        for (int c = 0; c < static_cast<int>(frame_share::kChannelCount); ++c) {
+            FrameShareReader::View view;
+            auto channel = static_cast<frame_share::Channel>(c);
+            if (!reader.latest(channel, view) || view.seq == last[c]) continue;
+            // Mean luma/red as a stand-in for real analytics.
+            unsigned long sum = 0;
+            for (uint32_t i = 0; i < view.size && c != frame_share::kDetections; i += 64) sum += view.data[i];
+            if (!reader.stillValid(view)) {
+                torn++;
+                continue;
+            }
+            (void)sum;
+            last[c] = view.seq;
+            frames[c]++;
+            if (c == frame_share::kDetections && view.count > 0) {
+                const auto& d = view.detections->detections[0];
+                std::printf("  det seq=%llu n=%u first=%s %.2f [%d,%d %dx%d]\n",
+                            static_cast<unsigned long long>(view.detections->seq), view.count, d.label,
+                            d.score, d.x, d.y, d.w, d.h);
+            }
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (now - window >= std::chrono::seconds(1)) {
+            std::printf("camera %d fps, ai %d fps, detections %d/s, lapped %d\n",
+                        frames[0], frames[1], frames[2], torn);
+            frames[0] = frames[1] = frames[2] = 0;
+            torn = 0;
+            window = now;
+        }
+    }
+    std::fprintf(stderr, "no frames for 2s, exiting\n");
+    return 0;
+}